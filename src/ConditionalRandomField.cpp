@@ -16,6 +16,7 @@
 
 #include "ConditionalRandomField.h"
 #include "DataManager.h"
+#include "IntegralHistogramCache.h"
 
 using namespace std;
 
@@ -24,13 +25,24 @@ using namespace std;
 
 // constructor
 ConditionalRandomField::ConditionalRandomField(DataManager *dataman) : 
-  dataManager(dataman) { }
+  dataManager(dataman), histogramCache(NULL), settingsVersion(0) { }
 
 
 
+// copy of the CRF
+ConditionalRandomField *ConditionalRandomField::clone() const {
+  return new ConditionalRandomField(*this);
+}
+
+int ConditionalRandomField::getSettingsVersion() {
+  return settingsVersion;
+}
+
 // setters and getters
 void ConditionalRandomField::setDataManager(DataManager *dataman) {
   dataManager = dataman;
+  integralImageStore.clear();
+  settingsVersion++;
 }
 
 DataManager *ConditionalRandomField::getDataManager() {
@@ -52,6 +64,7 @@ int ConditionalRandomField::getWeightDim() {
 
 void ConditionalRandomField::setStepSize(int stepSz) {
   stepSize = stepSz;
+  settingsVersion++;
 }
 
 
@@ -71,6 +84,25 @@ IntegralHistogram *ConditionalRandomField::getIntegralHistogram() {
   return &integralHistogram;
 }
 
+void ConditionalRandomField::setHistogramLayout(HistogramLayout layout, int blockSize) {
+  integralHistogram.setLayout(layout, blockSize);
+  settingsVersion++;
+}
+
+void ConditionalRandomField::setIntegralHistogramCache(IntegralHistogramCache *cache) {
+  histogramCache = cache;
+  settingsVersion++;
+}
+
+void ConditionalRandomField::setIncrementalIntegralImages(bool incremental) {
+  integralImageStore.setEnabled(incremental);
+  settingsVersion++;
+}
+
+IntegralImageStore *ConditionalRandomField::getIntegralImageStore() {
+  return &integralImageStore;
+}
+
 int ConditionalRandomField::getIntegralImageWidth() {
   return iiWidth;
 }
@@ -226,6 +258,12 @@ void ConditionalRandomField::computeIntegralImage(int imageNumber, const Weights
   // (we add one for boundary conditions)
   this->iiWidth = img.width/stepSize + 1;
   this->iiHeight = img.height/stepSize + 1;
+
+  // update the previous integral image of the image if possible
+  if (integralImageStore.isEnabled()) {
+    integralImageStore.compute(integralImage, img, imageNumber, stepSize, argweight, iiWidth, iiHeight);
+    return;
+  }
   
   // setup integral image
   integralImage.clear();
@@ -243,16 +281,16 @@ void ConditionalRandomField::computeIntegralImage(int imageNumber, const Weights
     }
   }
   
-  // calculate integral image vertically
-  for (short j=1; j < iiHeight; j++) {
-    for (short i=1; i < iiWidth; i++) {
-      integralImage[iiOffset(i,j)] += integralImage[iiOffset(i,j-1)];
-    }
-  }
-  // calculate integral image horizontally
-  for (short j=1; j < iiHeight; j++) {
-    for (short i=1; i < iiWidth; i++) {
-      integralImage[iiOffset(i,j)] += integralImage[iiOffset(i-1,j)];
+  // calculate integral image vertically and horizontally
+  integrateCells(integralImage, iiWidth, iiHeight);
+}
+
+// integral image of scale*v
+void ConditionalRandomField::computeIntegralImage(int imageNumber, const Weights &v, double scale) {
+  computeIntegralImage(imageNumber, v);
+  if (scale != 1.0) {
+    for (size_t i=0; i<integralImage.size(); i++) {
+      integralImage[i] *= scale;
     }
   }
 }
@@ -267,7 +305,7 @@ void ConditionalRandomField::computeIntegralHistogram(int imageNumber) {
   int argnumpoints = img.numFeatures;
   short *argxpos = img.x;
   short *argypos = img.y;
-  short *argclst = img.c;
+  short *argclst = img.localC;
   
   // ensure step size is not too large
   if (img.width < stepSize || img.height < stepSize) {
@@ -279,9 +317,16 @@ void ConditionalRandomField::computeIntegralHistogram(int imageNumber) {
   this->iiWidth = img.width/stepSize + 1;
   this->iiHeight = img.height/stepSize + 1;
 
-  // set up integral histogram
-  integralHistogram.clear();
-  integralHistogram.resize(iiWidth*iiHeight, Ivector(weightDim, 0));
+  // use the precomputed integral histogram if possible
+  if (histogramCache != NULL &&
+      histogramCache->matches(dataManager, stepSize, integralHistogram.getLayout(), integralHistogram.getBlockSize()) &&
+      histogramCache->getIntegralHistogram(integralHistogram, imageNumber)) {
+    return;
+  }
+
+  // set up integral histogram over the visual words present in the image
+  // (no cell can count more than the number of features)
+  integralHistogram.reset(iiWidth*iiHeight, img.numClusters, argnumpoints);
   
   short x,y,c;
   for (int k=0; k<argnumpoints; k++) {
@@ -289,24 +334,62 @@ void ConditionalRandomField::computeIntegralHistogram(int imageNumber) {
     y = argypos[k]/stepSize +1;
     c = argclst[k];
     if (x < iiWidth && y < iiHeight) {
-      integralHistogram[iiOffset(x,y)][c] += 1;
+      integralHistogram.increment(iiOffset(x,y), c);
     }
   }
   
   // calculate integral image vertically
   for (int j=1; j < iiHeight; j++) {
     for (int i=1; i < iiWidth; i++) {
-      for (int c=0; c < weightDim; c++) {
-        integralHistogram[iiOffset(i,j)][c] += integralHistogram[iiOffset(i,j-1)][c];
-      }
+      integralHistogram.add(iiOffset(i,j), iiOffset(i,j-1));
     }
   }
   // calculate integral image horizontally
   for (int j=1; j < iiHeight; j++) {
     for (int i=1; i < iiWidth; i++) {
-      for (int c=0; c < weightDim; c++) {
-        integralHistogram[iiOffset(i,j)][c] += integralHistogram[iiOffset(i-1,j)][c];
-      }
+      integralHistogram.add(iiOffset(i,j), iiOffset(i-1,j));
+    }
+  }
+}
+
+
+// compute feature map given any y directly from the features of the image
+// uses the same quantization as the integral histogram, i.e. a feature in
+// integral image cell (x,y) is inside the box if xl < x <= xh+1 and yl < y <= yh+1
+void ConditionalRandomField::computeFeatureMap(Ivector &featureMap, int imageNumber, short xl, short yl, short xh, short yh) {
+  if ( (xl > xh) || (yl > yh) ) throw WRONG_BBOX;
+
+  Image &img = dataManager->getImages()[imageNumber];
+
+  // clear feature map
+  for (int c=0; c<img.numClusters; c++) {
+    featureMap[c] = 0;
+  }
+
+  short x,y;
+  for (int k=0; k<img.numFeatures; k++) {
+    x = img.x[k]/stepSize +1;
+    y = img.y[k]/stepSize +1;
+    if (x < iiWidth && y < iiHeight && x > xl && x <= xh+1 && y > yl && y <= yh+1) {
+      featureMap[img.localC[k]] += 1;
+    }
+  }
+}
+
+
+// add the value of a field over the integral image grid to the visual word
+// of every feature in the image
+void ConditionalRandomField::accumulateFeatureField(Dvector &expectation, const Dvector &field, int imageNumber) {
+
+  Image &img = dataManager->getImages()[imageNumber];
+
+  // ignore extreme feature points as in the integral image
+  short x,y;
+  for (int k=0; k<img.numFeatures; k++) {
+    x = img.x[k]/stepSize +1;
+    y = img.y[k]/stepSize +1;
+    if (x < iiWidth && y < iiHeight) {
+      expectation[img.localC[k]] += field[iiOffset(x,y)];
     }
   }
 }
@@ -368,16 +451,11 @@ double ConditionalRandomField::slidingWindowLogSumExp(double* saveMaxScore)
 
 }
 
-// sliding window using log of sum of exponentials (for conditional probabilities)
-double ConditionalRandomField::slidingWindowLogSumExpCond(int var, const Bbox &bbox) {
+// scores of all positions of one bbox coordinate given the rest
+// scores[i-start] is the score with the coordinate set to i (start <= i <= stop)
+void ConditionalRandomField::slidingWindowScoresCond(Dvector &scores, short &start, int var, const Bbox &bbox) {
 
-  // outline for numerical stability:
-  // - compute max of all computeBboxScores, call it alpha
-  // - compute sum-of-exp as alpha + log(sum(exp(v-alpha)))
-  double sum = 0.0;
-  double score; 
-  double maxScore = -999999.;
-  short start, stop;
+  short stop;
 
   // store original value
   int val = bbox.ltrb[var];
@@ -406,29 +484,237 @@ double ConditionalRandomField::slidingWindowLogSumExpCond(int var, const Bbox &b
       break; 
   }
 
-
-  // compute max score
+  scores.resize(stop - start + 1);
   for (short i = start; i <= stop; i++) {
     bbox.ltrb[var] = i;
-    score = computeBboxScore(bbox.ltrb[LEFT], bbox.ltrb[TOP], bbox.ltrb[RIGHT], bbox.ltrb[BOTTOM]);
-    if (score > maxScore) {
-      maxScore = score;
-    }
-  }
-
-  // compute sum of exp
-  for (short i = start; i <= stop; i++) {
-    bbox.ltrb[var] = i;
-    score = computeBboxScore(bbox.ltrb[LEFT], bbox.ltrb[TOP], bbox.ltrb[RIGHT], bbox.ltrb[BOTTOM]);
-    sum += exp(score - maxScore);
+    scores[i-start] = computeBboxScore(bbox.ltrb[LEFT], bbox.ltrb[TOP], bbox.ltrb[RIGHT], bbox.ltrb[BOTTOM]);
   }
 
   // reinsert original value  
   bbox.ltrb[var] = val;
+}
+
+// log of sum of exponentials of a strip of scores
+static double logSumExp(const Dvector &scores) {
+
+  // outline for numerical stability:
+  // - compute max of all computeBboxScores, call it alpha
+  // - compute sum-of-exp as alpha + log(sum(exp(v-alpha)))
+  double sum = 0.0;
+  double maxScore = -999999.;
+
+  for (size_t i = 0; i < scores.size(); i++) {
+    if (scores[i] > maxScore) {
+      maxScore = scores[i];
+    }
+  }
+  for (size_t i = 0; i < scores.size(); i++) {
+    sum += exp(scores[i] - maxScore);
+  }
 
-  // compute final result
   return maxScore + log(sum);
+}
+
+
+// sliding window using log of sum of exponentials (for conditional probabilities)
+double ConditionalRandomField::slidingWindowLogSumExpCond(int var, const Bbox &bbox) {
+  Dvector scores;
+  short start;
+  slidingWindowScoresCond(scores, start, var, bbox);
+  return logSumExp(scores);
+}
+
+
+// pseudo-likelihood terms of a bbox (in quantized coordinates)
+// the scores of each coordinate given the rest are computed once and give both
+// the log normalization constant and the conditional probabilities. A feature
+// in cell (x,y) is inside the box when left < x and the other sides are fixed
+// around it, i.e. with probability P(left < x) = sum_{i<x} p(left = i), and so
+// on for the other sides. Returns the sum of the four log normalization
+// constants and adds the sum of the four expected feature maps to expectation
+// (indexed by the visual words present in the image)
+double ConditionalRandomField::slidingWindowPseudoLikelihood(Dvector &expectation, const Bbox &bbox, int imageNumber) {
+
+  short l = bbox.ltrb[LEFT];
+  short t = bbox.ltrb[TOP];
+  short r = bbox.ltrb[RIGHT];
+  short b = bbox.ltrb[BOTTOM];
+
+  // probability that a feature in column x (row y) is inside the box
+  // when the left, right (top, bottom) side varies
+  Dvector left(iiWidth, 0.0), right(iiWidth, 0.0);
+  Dvector top(iiHeight, 0.0), bottom(iiHeight, 0.0);
+
+  Dvector scores;
+  short start;
+  double logZ, cum;
+  double logZs = 0.0;
+
+  // left goes from 0 to r, inside when left < x <= r+1
+  slidingWindowScoresCond(scores, start, LEFT, bbox);
+  logZ = logSumExp(scores);
+  logZs += logZ;
+  cum = 0.0;
+  for (short x = 1; x <= r+1; x++) {
+    cum += exp(scores[x-1-start] - logZ);
+    left[x] = cum;
+  }
+
+  // top goes from 0 to b, inside when top < y <= b+1
+  slidingWindowScoresCond(scores, start, TOP, bbox);
+  logZ = logSumExp(scores);
+  logZs += logZ;
+  cum = 0.0;
+  for (short y = 1; y <= b+1; y++) {
+    cum += exp(scores[y-1-start] - logZ);
+    top[y] = cum;
+  }
+
+  // right goes from l to iiWidth-2, inside when l < x <= right+1
+  slidingWindowScoresCond(scores, start, RIGHT, bbox);
+  logZ = logSumExp(scores);
+  logZs += logZ;
+  cum = 0.0;
+  for (short x = iiWidth-1; x > l; x--) {
+    cum += exp(scores[x-1-start] - logZ);
+    right[x] = cum;
+  }
+
+  // bottom goes from t to iiHeight-2, inside when t < y <= bottom+1
+  slidingWindowScoresCond(scores, start, BOTTOM, bbox);
+  logZ = logSumExp(scores);
+  logZs += logZ;
+  cum = 0.0;
+  for (short y = iiHeight-1; y > t; y--) {
+    cum += exp(scores[y-1-start] - logZ);
+    bottom[y] = cum;
+  }
+
+  // add probabilities to the visual words of the features
+  // ignore extreme feature points as in the integral image
+  Image &img = dataManager->getImages()[imageNumber];
+  short x,y;
+  double p;
+  for (int k=0; k<img.numFeatures; k++) {
+    x = img.x[k]/stepSize +1;
+    y = img.y[k]/stepSize +1;
+    if (x < iiWidth && y < iiHeight) {
+      p = 0.0;
+      if (y > t && y <= b+1) {
+        p += left[x] + right[x];
+      }
+      if (x > l && x <= r+1) {
+        p += top[y] + bottom[y];
+      }
+      expectation[img.localC[k]] += p;
+    }
+  }
+
+  return logZs;
+}
+
+
+// probability that a bounding box covers each cell of the integral image
+// coverage(x,y) = sum_{l < x <= r+1, t < y <= b+1} p(l,t,r,b)
+// each box adds p to a rectangle of cells, which is done in O(1) by adding
+// it to the corners of a difference image and integrating afterwards
+void ConditionalRandomField::slidingWindowCoverage(Dvector &coverage, double logZ) {
+
+  double p;
+
+  // clear and reset coverage
+  coverage.clear();
+  coverage.resize(iiWidth*iiHeight, 0.0);
+
+  // difference image in box coordinates (cell (x,y) is box coordinate (x-1,y-1))
+  // In the following, remember that width and height are actually +1
+  //for all bounding heights
+  for (short bbox_h = 0; bbox_h < iiHeight - 1; bbox_h++) {
+    //for all bounding widths
+    for (short bbox_w = 0; bbox_w < iiWidth - 1; bbox_w++) {
+      //for all Top-Left y-coordinates
+      for (short y = 0; y < iiHeight - bbox_h - 1; y++) {
+        //all Top-Left x-coordinates
+        for (short x = 0; x < iiWidth - bbox_w - 1; x++) {
+          p = exp(computeBboxScore(x, y, x+bbox_w, y+bbox_h) - logZ);
+          coverage[iiOffset(x,y)]                     += p;
+          coverage[iiOffset(x+bbox_w+1,y)]            -= p;
+          coverage[iiOffset(x,y+bbox_h+1)]            -= p;
+          coverage[iiOffset(x+bbox_w+1,y+bbox_h+1)]   += p;
+        }
+      }
+    }
+  }
 
+  integrateCoverage(coverage);
+}
+
+// coverage and coverage weighted by the box scores of other weights
+void ConditionalRandomField::slidingWindowCoverage(Dvector &coverage, Dvector &weightedCoverage, double logZ,
+                                                   const IntegralImage &directionImage) {
+
+  double p, s;
+  short xl, yl, xh, yh;
+
+  coverage.assign(iiWidth*iiHeight, 0.0);
+  weightedCoverage.assign(iiWidth*iiHeight, 0.0);
+
+  // difference images in box coordinates (as above)
+  for (short bbox_h = 0; bbox_h < iiHeight - 1; bbox_h++) {
+    for (short bbox_w = 0; bbox_w < iiWidth - 1; bbox_w++) {
+      for (yl = 0; yl < iiHeight - bbox_h - 1; yl++) {
+        for (xl = 0; xl < iiWidth - bbox_w - 1; xl++) {
+          xh = xl + bbox_w;
+          yh = yl + bbox_h;
+          p = exp(computeBboxScore(xl, yl, xh, yh) - logZ);
+          s = p*(directionImage[iiOffset(xh+1,yh+1)] - directionImage[iiOffset(xh+1,yl)]
+                 - directionImage[iiOffset(xl,yh+1)] + directionImage[iiOffset(xl,yl)]);
+          coverage[iiOffset(xl,yl)]             += p;
+          coverage[iiOffset(xh+1,yl)]           -= p;
+          coverage[iiOffset(xl,yh+1)]           -= p;
+          coverage[iiOffset(xh+1,yh+1)]         += p;
+          weightedCoverage[iiOffset(xl,yl)]     += s;
+          weightedCoverage[iiOffset(xh+1,yl)]   -= s;
+          weightedCoverage[iiOffset(xl,yh+1)]   -= s;
+          weightedCoverage[iiOffset(xh+1,yh+1)] += s;
+        }
+      }
+    }
+  }
+
+  integrateCoverage(coverage);
+  integrateCoverage(weightedCoverage);
+}
+
+// turn a difference image in box coordinates into values per integral image cell
+void ConditionalRandomField::integrateCoverage(Dvector &coverage) {
+
+  // integrate difference image vertically
+  for (short j=1; j < iiHeight; j++) {
+    for (short i=0; i < iiWidth; i++) {
+      coverage[iiOffset(i,j)] += coverage[iiOffset(i,j-1)];
+    }
+  }
+  // integrate difference image horizontally
+  for (short j=0; j < iiHeight; j++) {
+    for (short i=1; i < iiWidth; i++) {
+      coverage[iiOffset(i,j)] += coverage[iiOffset(i-1,j)];
+    }
+  }
+
+  // shift from box coordinates to integral image cells
+  // (the last row and column of box coordinates are always zero)
+  for (short j=iiHeight-1; j > 0; j--) {
+    for (short i=iiWidth-1; i > 0; i--) {
+      coverage[iiOffset(i,j)] = coverage[iiOffset(i-1,j-1)];
+    }
+  }
+  for (short i=0; i < iiWidth; i++) {
+    coverage[iiOffset(i,0)] = 0.0;
+  }
+  for (short j=0; j < iiHeight; j++) {
+    coverage[iiOffset(0,j)] = 0.0;
+  }
 }
 
 
@@ -16,6 +16,10 @@
 #define _CONDITIONAL_RANDOM_FIELD_H_
 
 #include "DataManager.h"
+#include "IntegralHistogram.h"
+#include "IntegralImageStore.h"
+
+class IntegralHistogramCache;
 
 // Conditional Random Field class
 // for computing probabilities of bounding boxes
@@ -39,11 +43,29 @@ class ConditionalRandomField {
     int iiWidth, iiHeight;
     int stepSize;
 
+    // precomputed integral histograms (optional, not owned)
+    IntegralHistogramCache *histogramCache;
+
+    // integral images of previous calls for incremental updates (optional)
+    IntegralImageStore integralImageStore;
+
+    // incremented by every setter of a setting which clone copies
+    int settingsVersion;
+
 
   public:
     
-    // constructor
+    // constructor and destructor
     ConditionalRandomField(DataManager *dataman=NULL);
+    virtual ~ConditionalRandomField() {}
+
+    // copy of the CRF (used as workspace when evaluating images in parallel)
+    virtual ConditionalRandomField *clone() const;
+
+    // version of the settings (data manager, step size, histogram layout and
+    // cache, incremental integral images): a clone with another version than
+    // the CRF it was made from has stale settings and must be made again
+    int getSettingsVersion();
 
     // setters and getters
     void setDataManager(DataManager *dataman);
@@ -61,6 +83,13 @@ class ConditionalRandomField {
 
     IntegralImage *getIntegralImage();
     IntegralHistogram *getIntegralHistogram();
+    void setHistogramLayout(HistogramLayout layout, int blockSize = 64);
+    void setIntegralHistogramCache(IntegralHistogramCache *cache);
+
+    // keep the integral image of every image and update it when only a few
+    // weights change between calls for the image (costs one grid of cells per image)
+    void setIncrementalIntegralImages(bool incremental);
+    IntegralImageStore *getIntegralImageStore();
     int getIntegralImageWidth();
     int getIntegralImageHeight();
 
@@ -91,9 +120,19 @@ class ConditionalRandomField {
      */ 
     double computeBboxScore(short xl, short yl, short xh, short yh);
 
+    // feature maps and expectations below are indexed by the local visual words
+    // of the image, i.e. entry i belongs to visual word img.clusters[i]
+
     // compute feature map given any y
     void computeFeatureMap(Ivector &featureMap, short xl, short yl, short xh, short yh);
 
+    // add p times the feature map of y to result
+    void addFeatureMap(Dvector &result, double p, short xl, short yl, short xh, short yh);
+
+    // compute feature map given any y directly from the features of the image
+    // (does not need the integral histogram)
+    void computeFeatureMap(Ivector &featureMap, int imageNumber, short xl, short yl, short xh, short yh);
+
     // convert (x,y) into 1d index
     int iiOffset(int x, int y);
 
@@ -106,9 +145,19 @@ class ConditionalRandomField {
      */ 
     void computeIntegralImage(int imageNumber, const Weights &argweight);
 
+    // integral image of scale*v (for weights represented as a scale and a vector,
+    // incremental updates then only depend on the changes of v)
+    void computeIntegralImage(int imageNumber, const Weights &v, double scale);
+
     // compute integral histogram
+    // (viewed from the cache instead if it holds the image for this step size and layout)
     void computeIntegralHistogram(int imageNumber);
 
+    // add the value of a field over the integral image grid to the visual word
+    // of every feature in the image: expectation[localC] += field(x,y)
+    // (the field is indexed like the integral image)
+    void accumulateFeatureField(Dvector &expectation, const Dvector &field, int imageNumber);
+
     
     // generic sliding window  functions (for inference)
     void slidingWindow(Bbox& result, void (*slidingFunc)(Bbox&, double, short, short, short, short), bool rescale=true);
@@ -121,6 +170,30 @@ class ConditionalRandomField {
     double slidingWindowLogSumExp(double *saveMaxScore=0); // computes log Z
     double slidingWindowLogSumExpCond(int var, const Bbox &bbox);
 
+    // scores of all positions of one bbox coordinate given the rest
+    void slidingWindowScoresCond(Dvector &scores, short &start, int var, const Bbox &bbox);
+
+    // sum of the four conditional log normalization constants of a bbox
+    // the sum of the four conditional expected feature maps is added to expectation
+    // (computed directly from the features, no integral histogram needed)
+    double slidingWindowPseudoLikelihood(Dvector &expectation, const Bbox &bbox, int imageNumber);
+
+    // probability that a bounding box covers each cell of the integral image
+    // the expected feature map is then sum_features coverage(x,y)*e_c
+    void slidingWindowCoverage(Dvector &coverage, double logZ);
+
+    // coverage as above together with the coverage weighted by the score of each
+    // box under other weights v, given by their integral image:
+    // weightedCoverage(x,y) = sum_{boxes covering (x,y)} p(box)*<v,phi(box)>
+    // (used for Hessian-vector products)
+    void slidingWindowCoverage(Dvector &coverage, Dvector &weightedCoverage, double logZ,
+                               const IntegralImage &directionImage);
+
+  protected:
+
+    // turn a difference image in box coordinates into values per integral image cell
+    void integrateCoverage(Dvector &coverage);
+
 };  
 
 
@@ -142,10 +215,13 @@ inline double ConditionalRandomField::computeBboxScore(short xl, short yl, short
 // compute feature map given any y
 inline void ConditionalRandomField::computeFeatureMap(Ivector &featureMap, short xl, short yl, short xh, short yh) {
   if ( (xl > xh) || (yl > yh) ) throw WRONG_BBOX;
-  for (size_t c=0; c<featureMap.size(); c++) {
-    featureMap[c] = integralHistogram[iiOffset(xh+1,yh+1)][c] - integralHistogram[iiOffset(xh+1,yl)][c]
-                  - integralHistogram[iiOffset(xl,yh+1)][c] + integralHistogram[iiOffset(xl,yl)][c];
-  }
+  integralHistogram.combine(featureMap, iiOffset(xh+1,yh+1), iiOffset(xh+1,yl), iiOffset(xl,yh+1), iiOffset(xl,yl));
+}
+
+// add p times the feature map of y to result
+inline void ConditionalRandomField::addFeatureMap(Dvector &result, double p, short xl, short yl, short xh, short yh) {
+  if ( (xl > xh) || (yl > yh) ) throw WRONG_BBOX;
+  integralHistogram.addCombination(result, p, iiOffset(xh+1,yh+1), iiOffset(xh+1,yl), iiOffset(xl,yh+1), iiOffset(xl,yl));
 }
 
 // convert (x,y) into 1d index
@@ -16,6 +16,7 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 #include "DataManager.h"
 
@@ -63,9 +64,12 @@ void DataManager::clearImages() {
     delete[] images[i].x;
     delete[] images[i].y;
     delete[] images[i].c;
+    delete[] images[i].clusters;
+    delete[] images[i].localC;
   }
   
   images.clear();  
+  groundTruthFeatures.clear();
 }
 
 void DataManager::clearBboxes() {
@@ -76,6 +80,7 @@ void DataManager::clearBboxes() {
   }
   
   bboxes.clear();
+  groundTruthFeatures.clear();
 }
 
 int DataManager::getNumFiles() {
@@ -86,6 +91,14 @@ vector<string> &DataManager::getFilenames() {
   return filenames;
 }
 
+string DataManager::getImagePath() {
+  return imagePath;
+}
+
+string DataManager::getSubsetPath() {
+  return subsetPath;
+}
+
 // get and set dataset
 Images &DataManager::getImages() {
   return images;
@@ -93,6 +106,7 @@ Images &DataManager::getImages() {
 
 void DataManager::setImages(Images &img) {
   images = img;
+  groundTruthFeatures.clear();
 }
 
 // get and set annotations
@@ -102,6 +116,7 @@ Bboxes &DataManager::getBboxes() {
 
 void DataManager::setBboxes(Bboxes &bb) {
   bboxes = bb;
+  groundTruthFeatures.clear();
 }
 
 // get and set weights
@@ -118,6 +133,26 @@ SearchIx DataManager::getNonEmpty() {
   return nonEmpty;
 }
 
+// get ground truth feature vectors (computed on first use)
+const vector<SparseFeatures> &DataManager::getGroundTruthFeatures(int imageNumber, int stepSize) {
+  if (groundTruthFeatures.find(stepSize) == groundTruthFeatures.end()) {
+    computeGroundTruthFeatures(stepSize);
+  }
+  return groundTruthFeatures[stepSize][imageNumber];
+}
+
+// sum of the ground truth feature vectors
+void DataManager::addEmpiricalFeatures(Dvector &empirical, const SearchIx &si, int stepSize) {
+  for (size_t j=0; j<si.size(); j++) {
+    const vector<SparseFeatures> &objects = getGroundTruthFeatures(si[j], stepSize);
+    for (size_t n=0; n<objects.size(); n++) {
+      for (size_t i=0; i<objects[n].words.size(); i++) {
+        empirical[objects[n].words[i]] += objects[n].counts[i];
+      }
+    }
+  }
+}
+
 // load dataset from directory (binary)
 void DataManager::loadImages(string path, string subset) {
 
@@ -134,6 +169,8 @@ void DataManager::loadImages(string path, string subset) {
   if (!fs.is_open()) {
     throw FILE_NOT_FOUND;
   } 
+  imagePath = path;
+  subsetPath = subset;
 
   filenames.clear();  
   while (fs.getline(line, LINE_MAX)) {
@@ -197,6 +234,8 @@ void DataManager::loadImages(string path, string subset) {
     fs.read((char *) imageRep.x, sizeof(short)*numFeatures);
     fs.read((char *) imageRep.y, sizeof(short)*numFeatures);
     fs.read((char *) imageRep.c, sizeof(short)*numFeatures);
+
+    computeActiveClusters(imageRep);
     
     // store in dataset
     images[i] = imageRep;    
@@ -222,6 +261,8 @@ void DataManager::loadImagesASCII(string path, string subset) {
   if (!fs.is_open()) {
     throw FILE_NOT_FOUND;
   } 
+  imagePath = path;
+  subsetPath = subset;
   
   filenames.clear();
   while (fs.getline(line, LINE_MAX)) {
@@ -281,6 +322,8 @@ void DataManager::loadImagesASCII(string path, string subset) {
       j++;
     }
 
+    computeActiveClusters(imageRep);
+
     // store in dataset
     images[i] = imageRep;    
 
@@ -290,6 +333,98 @@ void DataManager::loadImagesASCII(string path, string subset) {
 }
 
 
+// build local to global map of the visual words present in an image
+void DataManager::computeActiveClusters(Image &img) {
+
+  // find largest visual word
+  int maxC = 0;
+  for (int k=0; k<img.numFeatures; k++) {
+    if (img.c[k] > maxC) {
+      maxC = img.c[k];
+    }
+  }
+
+  // mark visual words present in the image
+  vector<int> local(maxC+1, -1);
+  for (int k=0; k<img.numFeatures; k++) {
+    local[img.c[k]] = 0;
+  }
+
+  // number them in increasing order
+  img.numClusters = 0;
+  for (int c=0; c<=maxC; c++) {
+    if (local[c] == 0) {
+      local[c] = img.numClusters++;
+    }
+  }
+
+  img.clusters = new short[img.numClusters];
+  for (int c=0; c<=maxC; c++) {
+    if (local[c] >= 0) {
+      img.clusters[local[c]] = c;
+    }
+  }
+
+  img.localC = new short[img.numFeatures];
+  for (int k=0; k<img.numFeatures; k++) {
+    img.localC[k] = local[img.c[k]];
+  }
+}
+
+
+// compute ground truth feature vectors
+// uses the same quantization as the integral image: the box is fitted to the
+// integral image grid and a feature in cell (x,y) is inside if xl < x <= xh+1
+// and yl < y <= yh+1 (features outside the grid are ignored)
+void DataManager::computeGroundTruthFeatures(int stepSize) {
+
+  vector<vector<SparseFeatures> > &features = groundTruthFeatures[stepSize];
+  features.assign(images.size(), vector<SparseFeatures>());
+
+  Ivector featureMap;
+  int iiWidth, iiHeight;
+  short xl,yl,xh,yh,x,y;
+
+  for (size_t n=0; n<images.size() && n<bboxes.size(); n++) {
+    Image &img = images[n];
+    Bbox &bbox = bboxes[n];
+
+    iiWidth  = img.width/stepSize + 1;
+    iiHeight = img.height/stepSize + 1;
+
+    features[n].resize(bbox.numObject);
+    for (int numObj = 0; numObj < bbox.numObject; numObj++) {
+
+      // fit to quantized integral image space
+      xl = min(bbox.ltrb[4*numObj+0]/stepSize, iiWidth-2);
+      yl = min(bbox.ltrb[4*numObj+1]/stepSize, iiHeight-2);
+      xh = min(bbox.ltrb[4*numObj+2]/stepSize, iiWidth-2);
+      yh = min(bbox.ltrb[4*numObj+3]/stepSize, iiHeight-2);
+      if ( (xl > xh) || (yl > yh) ) throw WRONG_BBOX;
+
+      // count the local visual words inside the box
+      featureMap.assign(img.numClusters, 0);
+      for (int k=0; k<img.numFeatures; k++) {
+        x = img.x[k]/stepSize +1;
+        y = img.y[k]/stepSize +1;
+        if (x < iiWidth && y < iiHeight && x > xl && x <= xh+1 && y > yl && y <= yh+1) {
+          featureMap[img.localC[k]] += 1;
+        }
+      }
+
+      // keep the nonzero counts (sorted by visual word)
+      SparseFeatures &sparse = features[n][numObj];
+      for (int i=0; i<img.numClusters; i++) {
+        if (featureMap[i] > 0) {
+          sparse.words.push_back(img.clusters[i]);
+          sparse.counts.push_back(featureMap[i]);
+        }
+      }
+    }
+  }
+}
+
+
 // load annotations from a single file (ASCII)
 void DataManager::loadBboxes(string path) {
   
@@ -18,6 +18,7 @@
 #include <iostream>
 #include <vector>
 #include <string> 
+#include <map>
 
 #include "Types.h"
 
@@ -32,14 +33,28 @@ class DataManager {
     Weights weights;
     std::vector<std::string> filenames;
     int numFiles;
+
+    // where the images were loaded from
+    std::string imagePath;
+    std::string subsetPath;
     
     // search index for images with object
     SearchIx nonEmpty;
+
+    // sparse ground truth feature vectors for each step size
+    // groundTruthFeatures[stepSize][imageNumber][object]
+    std::map<int, std::vector<std::vector<SparseFeatures> > > groundTruthFeatures;
     
     // clear and deallocate images and bboxes
     void clearImages();
     void clearBboxes();
 
+    // build local to global map of the visual words present in an image
+    void computeActiveClusters(Image &img);
+
+    // compute the ground truth feature vectors of all images for a step size
+    void computeGroundTruthFeatures(int stepSize);
+
   public:
 
     // constructors and desctructor
@@ -53,6 +68,8 @@ class DataManager {
     // getters/setters
     int getNumFiles();
     std::vector<std::string> &getFilenames();
+    std::string getImagePath();
+    std::string getSubsetPath();
 
     Images &getImages();
     void setImages(Images&);
@@ -64,6 +81,14 @@ class DataManager {
     void setWeights(Weights&);
     
     SearchIx getNonEmpty();
+
+    // feature vectors of the ground truth boxes of an image, quantized as in the
+    // integral image. They do not depend on the weights, so they are computed
+    // once per step size (for all images on first use, which is not thread safe)
+    const std::vector<SparseFeatures> &getGroundTruthFeatures(int imageNumber, int stepSize);
+
+    // add the ground truth feature vectors of the images in the search index
+    void addEmpiricalFeatures(Dvector &empirical, const SearchIx &si, int stepSize);
     
     // load images from a directory (binary)
     void loadImages(std::string path, std::string subset);
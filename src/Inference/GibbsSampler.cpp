@@ -16,6 +16,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
 
 #include "GibbsSampler.h"
 
@@ -23,7 +24,9 @@ using namespace std;
 
 // constructors 
 GibbsSampler::GibbsSampler(ConditionalRandomField *crf_) :  
-  crf(crf_)
+  crf(crf_),
+  chains(NULL),
+  ownsChains(false)
 {
   srand(time(NULL)); rand();
   initialize();
@@ -31,7 +34,9 @@ GibbsSampler::GibbsSampler(ConditionalRandomField *crf_) :
 
 GibbsSampler::GibbsSampler(ConditionalRandomField *crf_, Bboxes initial) :  
   crf(crf_),
-  current(initial)
+  current(initial),
+  chains(NULL),
+  ownsChains(false)
 { 
   srand(time(NULL)); rand();
   initialize();
@@ -50,6 +55,10 @@ GibbsSampler::~GibbsSampler() {
       delete[] current[i].ltrb;
     }
   }
+
+  if (ownsChains) {
+    delete chains;
+  }
 }
 
 // initialize Gibbs chain with random bboxes
@@ -211,6 +220,14 @@ void GibbsSampler::sampleOne(int var, Weights &w, int imageNumber) {
   // choose desired sample
   sample = i+histogramOffset;
 
+  // mixing statistics
+  if (chains != NULL) {
+    chains->updates[imageNumber]++;
+    if (sample != current[imageNumber].ltrb[var]) {
+      chains->moves[imageNumber]++;
+    }
+  }
+
   // update current sample
   current[imageNumber].ltrb[var] = sample;
 
@@ -237,3 +254,149 @@ void GibbsSampler::sample(int k, Weights &w, int imageNumber, bool computeII) {
   }
 }
 
+
+
+
+// PERSISTENT CHAINS
+
+// area overlap of two boxes (including their edges)
+static double boxOverlap(const short *a, const short *b) {
+  int left   = max(a[LEFT], b[LEFT]);
+  int top    = max(a[TOP], b[TOP]);
+  int right  = min(a[RIGHT], b[RIGHT]);
+  int bottom = min(a[BOTTOM], b[BOTTOM]);
+  if ((left > right) || (top > bottom)) return 0.;
+
+  int intersection = (right - left + 1)*(bottom - top + 1);
+  int areaA = (a[RIGHT] - a[LEFT] + 1)*(a[BOTTOM] - a[TOP] + 1);
+  int areaB = (b[RIGHT] - b[LEFT] + 1)*(b[BOTTOM] - b[TOP] + 1);
+  return (double) intersection/(areaA + areaB - intersection);
+}
+
+// keep numChains chains for every image
+void GibbsSampler::setPersistentChains(int numChains) {
+
+  if (ownsChains) {
+    delete chains;
+  }
+  chains = NULL;
+  ownsChains = false;
+  if (numChains <= 0) {
+    return;
+  }
+
+  int numImages = crf->getNumImages();
+  chains = new PersistentChains;
+  chains->numChains = numChains;
+  chains->ltrb.assign(4*numImages*numChains, 0);
+  chains->stepSizes.assign(numImages, 0);
+  ownsChains = true;
+  resetMixingStatistics();
+}
+
+int GibbsSampler::getNumChains() {
+  return chains != NULL ? chains->numChains : 0;
+}
+
+void GibbsSampler::sharePersistentChains(GibbsSampler *other) {
+  if (ownsChains) {
+    delete chains;
+  }
+  chains = other->chains;
+  ownsChains = false;
+}
+
+PersistentChains *GibbsSampler::getPersistentChains() {
+  return chains;
+}
+
+// make chain c the current state of the image
+void GibbsSampler::loadChain(int imageNumber, int chain, Bbox &bbox) {
+
+  short *box = &chains->ltrb[4*(imageNumber*chains->numChains + chain)];
+
+  // chains start at the given box
+  int stepSize = crf->getStepSize();
+  int chainStepSize = chains->stepSizes[imageNumber];
+  if (chainStepSize == 0) {
+    for (int c=0; c<chains->numChains; c++) {
+      for (int var=0; var<4; var++) {
+        chains->ltrb[4*(imageNumber*chains->numChains + c) + var] = bbox.ltrb[var];
+      }
+    }
+    chains->stepSizes[imageNumber] = stepSize;
+  }
+
+  // or are scaled to the current grid (last row and column of the integral
+  // image are not valid box coordinates)
+  else if (chainStepSize != stepSize) {
+    Image &img = crf->getDataManager()->getImages()[imageNumber];
+    int maxX = img.width/stepSize - 1;
+    int maxY = img.height/stepSize - 1;
+    short *chainBox;
+    for (int c=0; c<chains->numChains; c++) {
+      chainBox = &chains->ltrb[4*(imageNumber*chains->numChains + c)];
+      for (int var=0; var<4; var++) {
+        int coord = chainBox[var]*chainStepSize/stepSize;
+        int maxCoord = (var == LEFT || var == RIGHT) ? maxX : maxY;
+        chainBox[var] = max(0, min(coord, maxCoord));
+      }
+    }
+    chains->stepSizes[imageNumber] = stepSize;
+  }
+
+  for (int var=0; var<4; var++) {
+    current[imageNumber].ltrb[var] = box[var];
+    chainStart[var] = box[var];
+  }
+  step[imageNumber] = 0;
+}
+
+// store the current state of the image in chain c
+void GibbsSampler::storeChain(int imageNumber, int chain) {
+
+  short *box = &chains->ltrb[4*(imageNumber*chains->numChains + chain)];
+  for (int var=0; var<4; var++) {
+    box[var] = current[imageNumber].ltrb[var];
+  }
+
+  chains->overlap[imageNumber] += boxOverlap(chainStart, box);
+  chains->advances[imageNumber]++;
+}
+
+// mixing statistics
+double GibbsSampler::getMoveRate() {
+  if (chains == NULL) {
+    return 0.0;
+  }
+  long long updates = 0, moves = 0;
+  for (size_t i=0; i<chains->updates.size(); i++) {
+    updates += chains->updates[i];
+    moves += chains->moves[i];
+  }
+  return updates > 0 ? (double) moves/updates : 0.0;
+}
+
+double GibbsSampler::getChainOverlap() {
+  if (chains == NULL) {
+    return 0.0;
+  }
+  double overlap = 0.0;
+  long long advances = 0;
+  for (size_t i=0; i<chains->overlap.size(); i++) {
+    overlap += chains->overlap[i];
+    advances += chains->advances[i];
+  }
+  return advances > 0 ? overlap/advances : 0.0;
+}
+
+void GibbsSampler::resetMixingStatistics() {
+  if (chains == NULL) {
+    return;
+  }
+  int numImages = chains->stepSizes.size();
+  chains->updates.assign(numImages, 0);
+  chains->moves.assign(numImages, 0);
+  chains->overlap.assign(numImages, 0.0);
+  chains->advances.assign(numImages, 0);
+}
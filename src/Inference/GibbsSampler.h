@@ -15,9 +15,28 @@
 #ifndef _GIBBS_SAMPLER_H_
 #define _GIBBS_SAMPLER_H_
 
+#include <vector>
+
 #include "ConditionalRandomField.h"
 #include "Types.h"
 
+// persistent Gibbs chains (persistent contrastive divergence): numChains boxes
+// for every image which are kept between gradient evaluations, stored as four
+// shorts per chain, together with mixing statistics per image. The chains of
+// an image are only touched while that image is sampled, so the samplers of
+// several threads can share them as long as they work on different images
+struct PersistentChains {
+  int numChains;
+  std::vector<short> ltrb;          // box of chain c of image i at 4*(i*numChains + c)
+  std::vector<int> stepSizes;       // step size of the grid of the boxes of the image (0 before they are started)
+
+  // mixing statistics of each image
+  std::vector<long long> updates;   // variables sampled
+  std::vector<long long> moves;     // variables which changed value
+  std::vector<double> overlap;      // area overlap of a chain before and after it is advanced
+  std::vector<int> advances;        // number of times a chain was advanced
+};
+
 // Gibbs sampler for sampling bounding boxes given a specific distribution
 class GibbsSampler {
 
@@ -36,6 +55,15 @@ class GibbsSampler {
 
     // sample one variable
     void sampleOne(int var, Weights &w, int imageNumber);
+
+    // persistent chains (shared by copies of the sampler on other threads)
+    PersistentChains *chains;
+    bool ownsChains;
+    short chainStart[4];    // box of the loaded chain when it was loaded
+
+    // not copyable (owns the boxes and the chains)
+    GibbsSampler(const GibbsSampler &);
+    GibbsSampler &operator=(const GibbsSampler &);
   
   public:
 
@@ -64,6 +92,33 @@ class GibbsSampler {
     // take k steps of the Gibbs chain to obtain one sample
     void sample(int k, Weights &w, int imageNumber, bool computeII = true);
 
+    // keep numChains persistent chains for every image (0 removes them)
+    void setPersistentChains(int numChains);
+    int getNumChains();
+
+    // use the persistent chains of another sampler (e.g. of the same
+    // gradient on another thread)
+    void sharePersistentChains(GibbsSampler *other);
+
+    // make chain c of an image the current state of the image (the chain
+    // starts at bbox when the image is seen for the first time, and is moved
+    // to the grid of the CRF when its step size has changed, e.g. between the
+    // stages of a coarse-to-fine schedule) and store the current state back
+    // into the chain after it has been advanced
+    void loadChain(int imageNumber, int chain, Bbox &bbox);
+    void storeChain(int imageNumber, int chain);
+
+    // the persistent chains (NULL without them), e.g. to store them in a
+    // checkpoint of the learner
+    PersistentChains *getPersistentChains();
+
+    // mixing statistics of the persistent chains since the last reset:
+    // fraction of the sampled variables which changed value, and mean area
+    // overlap of a chain before and after it was advanced (lower mixes faster)
+    double getMoveRate();
+    double getChainOverlap();
+    void resetMixingStatistics();
+
 };
 
 #endif // _GIBBS_SAMPLER_H_
@@ -0,0 +1,308 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#include "IntegralHistogram.h"
+
+using namespace std;
+
+// largest count which fits in 16 bits
+const int MAX_SHORT_COUNT = 65535;
+
+// tiles must hold a multiple of 64 bytes of 16-bit counts to stay aligned
+static int roundBlockSize(int blockSize) {
+  return ((max(blockSize, 1) + 31)/32)*32;
+}
+
+
+// KERNELS
+// the four corner combination and the integration are done one tile at a time
+// with SSE2 when available. 16-bit counts are combined modulo 2^16 which is
+// exact as long as the result fits in 16 bits, i.e. it is at most the number of
+// features in the image
+
+// result[i] = a[i] - b[i] - c[i] + d[i]
+static void combineTile(int *result, const unsigned short *a, const unsigned short *b,
+                        const unsigned short *c, const unsigned short *d, int n) {
+  int i = 0;
+#ifdef __SSE2__
+  __m128i zero = _mm_setzero_si128();
+  for (; i+8 <= n; i += 8) {
+    __m128i v = _mm_sub_epi16(_mm_load_si128((const __m128i *) (a+i)), _mm_load_si128((const __m128i *) (b+i)));
+    v = _mm_sub_epi16(v, _mm_load_si128((const __m128i *) (c+i)));
+    v = _mm_add_epi16(v, _mm_load_si128((const __m128i *) (d+i)));
+    _mm_storeu_si128((__m128i *) (result+i),   _mm_unpacklo_epi16(v, zero));
+    _mm_storeu_si128((__m128i *) (result+i+4), _mm_unpackhi_epi16(v, zero));
+  }
+#endif
+  for (; i < n; i++) {
+    result[i] = (unsigned short) (a[i] - b[i] - c[i] + d[i]);
+  }
+}
+
+static void combineTile(int *result, const int *a, const int *b, const int *c, const int *d, int n) {
+  int i = 0;
+#ifdef __SSE2__
+  for (; i+4 <= n; i += 4) {
+    __m128i v = _mm_sub_epi32(_mm_load_si128((const __m128i *) (a+i)), _mm_load_si128((const __m128i *) (b+i)));
+    v = _mm_sub_epi32(v, _mm_load_si128((const __m128i *) (c+i)));
+    v = _mm_add_epi32(v, _mm_load_si128((const __m128i *) (d+i)));
+    _mm_storeu_si128((__m128i *) (result+i), v);
+  }
+#endif
+  for (; i < n; i++) {
+    result[i] = a[i] - b[i] - c[i] + d[i];
+  }
+}
+
+// result[i] += p*(a[i] - b[i] - c[i] + d[i])
+// the combination is done in integers and converted afterwards
+static void addCombinationTile(double *result, double p, const int *combined, int n) {
+  int i = 0;
+#ifdef __SSE2__
+  __m128d pp = _mm_set1_pd(p);
+  for (; i+4 <= n; i += 4) {
+    __m128i v  = _mm_loadu_si128((const __m128i *) (combined+i));
+    __m128d lo = _mm_cvtepi32_pd(v);
+    __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));
+    _mm_storeu_pd(result+i,   _mm_add_pd(_mm_loadu_pd(result+i),   _mm_mul_pd(pp, lo)));
+    _mm_storeu_pd(result+i+2, _mm_add_pd(_mm_loadu_pd(result+i+2), _mm_mul_pd(pp, hi)));
+  }
+#endif
+  for (; i < n; i++) {
+    result[i] += p*combined[i];
+  }
+}
+
+// to[i] += from[i]
+static void addTile(unsigned short *to, const unsigned short *from, int n) {
+  int i = 0;
+#ifdef __SSE2__
+  for (; i+8 <= n; i += 8) {
+    __m128i v = _mm_add_epi16(_mm_load_si128((const __m128i *) (to+i)), _mm_load_si128((const __m128i *) (from+i)));
+    _mm_store_si128((__m128i *) (to+i), v);
+  }
+#endif
+  for (; i < n; i++) {
+    to[i] += from[i];
+  }
+}
+
+static void addTile(int *to, const int *from, int n) {
+  int i = 0;
+#ifdef __SSE2__
+  for (; i+4 <= n; i += 4) {
+    __m128i v = _mm_add_epi32(_mm_load_si128((const __m128i *) (to+i)), _mm_load_si128((const __m128i *) (from+i)));
+    _mm_store_si128((__m128i *) (to+i), v);
+  }
+#endif
+  for (; i < n; i++) {
+    to[i] += from[i];
+  }
+}
+
+
+// implementation of the integral histogram
+
+// constructors and destructor
+IntegralHistogram::IntegralHistogram(HistogramLayout layout_, int blockSize_) :
+  data(NULL),
+  capacity(0),
+  ownsData(true),
+  shortCounts(true),
+  numCells(0),
+  dim(0),
+  paddedDim(0),
+  blockSize(roundBlockSize(blockSize_)),
+  layout(layout_) { }
+
+IntegralHistogram::IntegralHistogram(const IntegralHistogram &other) :
+  data(NULL),
+  capacity(0),
+  ownsData(true)
+{
+  *this = other;
+}
+
+IntegralHistogram &IntegralHistogram::operator=(const IntegralHistogram &other) {
+  if (this != &other) {
+    shortCounts = other.shortCounts;
+    numCells    = other.numCells;
+    dim         = other.dim;
+    paddedDim   = other.paddedDim;
+    blockSize   = other.blockSize;
+    layout      = other.layout;
+    scratch     = other.scratch;
+    reserve(other.getBytes());
+    if (other.getBytes() > 0) {
+      memcpy(data, other.data, other.getBytes());
+    }
+  }
+  return *this;
+}
+
+IntegralHistogram::~IntegralHistogram() {
+  if (ownsData) {
+    free(data);
+  }
+}
+
+// getters/setters
+// changing the layout clears the histogram
+void IntegralHistogram::setLayout(HistogramLayout layout_, int blockSize_) {
+  layout = layout_;
+  blockSize = roundBlockSize(blockSize_);
+  numCells = 0;
+  dim = 0;
+  paddedDim = 0;
+}
+
+HistogramLayout IntegralHistogram::getLayout() const {
+  return layout;
+}
+
+int IntegralHistogram::getBlockSize() const {
+  return blockSize;
+}
+
+int IntegralHistogram::getDim() const {
+  return dim;
+}
+
+int IntegralHistogram::getNumCells() const {
+  return numCells;
+}
+
+bool IntegralHistogram::hasShortCounts() const {
+  return shortCounts;
+}
+
+size_t IntegralHistogram::getBytes() const {
+  return (size_t) numCells*paddedDim*(shortCounts ? sizeof(unsigned short) : sizeof(int));
+}
+
+const void *IntegralHistogram::getData() const {
+  return data;
+}
+
+// allocate (at least) the given number of bytes
+// memory is reused between images and only grows (viewed memory is never reused)
+void IntegralHistogram::reserve(size_t bytes) {
+  if (ownsData && bytes <= capacity) {
+    return;
+  }
+  if (ownsData) {
+    free(data);
+  }
+  ownsData = true;
+  data = NULL;
+  capacity = 0;
+  if (posix_memalign(&data, 64, bytes) != 0) {
+    data = NULL;
+    throw std::bad_alloc();
+  }
+  capacity = bytes;
+}
+
+// set up an all zero histogram
+void IntegralHistogram::reset(int numCells_, int dim_, int maxCount) {
+
+  numCells = numCells_;
+  dim = dim_;
+
+  // round up to a whole number of tiles
+  paddedDim = ((dim + blockSize - 1)/blockSize)*blockSize;
+
+  shortCounts = (maxCount <= MAX_SHORT_COUNT);
+
+  reserve(getBytes());
+  memset(data, 0, getBytes());
+}
+
+// view counts stored elsewhere
+void IntegralHistogram::view(const void *data_, int numCells_, int dim_, bool shortCounts_) {
+  if (ownsData) {
+    free(data);
+  }
+  data = const_cast<void *>(data_);
+  capacity = 0;
+  ownsData = false;
+
+  numCells = numCells_;
+  dim = dim_;
+  paddedDim = ((dim + blockSize - 1)/blockSize)*blockSize;
+  shortCounts = shortCounts_;
+}
+
+// add all counts of cell from to cell to
+void IntegralHistogram::add(int to, int from) {
+  int numBlocks = paddedDim/blockSize;
+  for (int b=0; b<numBlocks; b++) {
+    if (shortCounts) {
+      unsigned short *counts = (unsigned short *) data;
+      addTile(counts + tileOffset(to, b), counts + tileOffset(from, b), blockSize);
+    } else {
+      int *counts = (int *) data;
+      addTile(counts + tileOffset(to, b), counts + tileOffset(from, b), blockSize);
+    }
+  }
+}
+
+// four corner combination of the integral histogram
+void IntegralHistogram::combine(Ivector &featureMap, int xhyh, int xhyl, int xlyh, int xlyl) const {
+  int numBlocks = paddedDim/blockSize;
+  int n;
+  for (int b=0; b<numBlocks; b++) {
+    // last tile may be partially used
+    n = min(blockSize, dim - b*blockSize);
+    if (shortCounts) {
+      const unsigned short *counts = (const unsigned short *) data;
+      combineTile(&featureMap[b*blockSize], counts + tileOffset(xhyh, b), counts + tileOffset(xhyl, b),
+                  counts + tileOffset(xlyh, b), counts + tileOffset(xlyl, b), n);
+    } else {
+      const int *counts = (const int *) data;
+      combineTile(&featureMap[b*blockSize], counts + tileOffset(xhyh, b), counts + tileOffset(xhyl, b),
+                  counts + tileOffset(xlyh, b), counts + tileOffset(xlyl, b), n);
+    }
+  }
+}
+
+// weighted four corner combination added to a dense vector
+void IntegralHistogram::addCombination(Dvector &result, double p, int xhyh, int xhyl, int xlyh, int xlyl) const {
+  int numBlocks = paddedDim/blockSize;
+  int n;
+  scratch.resize(blockSize);
+  int *combined = &scratch[0];
+  for (int b=0; b<numBlocks; b++) {
+    n = min(blockSize, dim - b*blockSize);
+    if (shortCounts) {
+      const unsigned short *counts = (const unsigned short *) data;
+      combineTile(combined, counts + tileOffset(xhyh, b), counts + tileOffset(xhyl, b),
+                  counts + tileOffset(xlyh, b), counts + tileOffset(xlyl, b), n);
+    } else {
+      const int *counts = (const int *) data;
+      combineTile(combined, counts + tileOffset(xhyh, b), counts + tileOffset(xhyl, b),
+                  counts + tileOffset(xlyh, b), counts + tileOffset(xlyl, b), n);
+    }
+    addCombinationTile(&result[b*blockSize], p, combined, n);
+  }
+}
@@ -0,0 +1,129 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _INTEGRAL_HISTOGRAM_H_
+#define _INTEGRAL_HISTOGRAM_H_
+
+#include <cstddef>
+
+#include "Types.h"
+
+// memory layout of the integral histogram
+// CELL_MAJOR:      all clusters of one cell are stored contiguously
+// CLUSTER_BLOCKED: clusters are split into tiles of blockSize clusters and
+//                  each tile is stored contiguously for all cells
+enum HistogramLayout { CELL_MAJOR, CLUSTER_BLOCKED };
+
+// integral histogram stored in one flat 64-byte aligned array
+// counts are stored as 16-bit integers when the number of features allows it
+class IntegralHistogram {
+
+  private:
+
+    // counts are either unsigned short or int
+    void *data;
+    size_t capacity;    // allocated bytes
+    bool ownsData;      // false when viewing memory owned by someone else
+    bool shortCounts;
+
+    int numCells;
+    int dim;            // number of clusters
+    int paddedDim;      // number of clusters rounded up to a whole number of tiles
+    int blockSize;      // number of clusters in a tile
+    HistogramLayout layout;
+
+    // combined counts of one tile (used by addCombination)
+    mutable Ivector scratch;
+
+    // offset of a tile of a cell in elements
+    size_t tileOffset(int cell, int block) const;
+
+    // allocate (at least) the given number of bytes
+    void reserve(size_t bytes);
+
+  public:
+
+    // constructors and destructor
+    IntegralHistogram(HistogramLayout layout = CELL_MAJOR, int blockSize = 64);
+    IntegralHistogram(const IntegralHistogram &other);
+    IntegralHistogram &operator=(const IntegralHistogram &other);
+    ~IntegralHistogram();
+
+    // getters/setters
+    void setLayout(HistogramLayout layout, int blockSize = 64);
+    HistogramLayout getLayout() const;
+    int getBlockSize() const;
+    int getDim() const;
+    int getNumCells() const;
+    bool hasShortCounts() const;
+    size_t getBytes() const;
+    const void *getData() const;
+
+    // use counts stored elsewhere (e.g. a memory mapped cache) without copying
+    // them. The memory must be 64-byte aligned, use the current layout and stay
+    // valid while viewed. The view is read-only, reset detaches from it
+    void view(const void *data, int numCells, int dim, bool shortCounts);
+
+    // set up an all zero histogram with numCells cells and dim clusters
+    // maxCount is the largest count that must be represented
+    void reset(int numCells, int dim, int maxCount);
+
+    // add one to cluster c of the given cell
+    void increment(int cell, int c);
+
+    // add all counts of cell from to cell to (used for integrating the histogram)
+    void add(int to, int from);
+
+    // read single count
+    int get(int cell, int c) const;
+
+    // four corner combination of the integral histogram (done one tile at a time with SSE2)
+    // featureMap[c] = H[xhyh][c] - H[xhyl][c] - H[xlyh][c] + H[xlyl][c]
+    void combine(Ivector &featureMap, int xhyh, int xhyl, int xlyh, int xlyl) const;
+
+    // weighted four corner combination added to a dense vector
+    // result[c] += p*(H[xhyh][c] - H[xhyl][c] - H[xlyh][c] + H[xlyl][c])
+    void addCombination(Dvector &result, double p, int xhyh, int xhyl, int xlyh, int xlyl) const;
+
+};
+
+
+// offset of a tile of a cell in elements
+inline size_t IntegralHistogram::tileOffset(int cell, int block) const {
+  if (layout == CELL_MAJOR) {
+    return (size_t) cell*paddedDim + (size_t) block*blockSize;
+  }
+  return (size_t) block*numCells*blockSize + (size_t) cell*blockSize;
+}
+
+// add one to cluster c of the given cell
+inline void IntegralHistogram::increment(int cell, int c) {
+  size_t ix = tileOffset(cell, c/blockSize) + c%blockSize;
+  if (shortCounts) {
+    ((unsigned short *) data)[ix] += 1;
+  } else {
+    ((int *) data)[ix] += 1;
+  }
+}
+
+// read single count
+inline int IntegralHistogram::get(int cell, int c) const {
+  size_t ix = tileOffset(cell, c/blockSize) + c%blockSize;
+  if (shortCounts) {
+    return ((unsigned short *) data)[ix];
+  }
+  return ((int *) data)[ix];
+}
+
+#endif // _INTEGRAL_HISTOGRAM_H_
@@ -0,0 +1,332 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "IntegralHistogramCache.h"
+#include "ConditionalRandomField.h"
+
+using namespace std;
+
+// identifies the file format (change when the layout of the file changes)
+static const char CACHE_MAGIC[8] = "CRFIHC1";
+
+// header of the cache file
+struct HistogramCacheHeader {
+  char magic[8];
+  int stepSize;
+  int layout;
+  int blockSize;
+  int numImages;
+  long long subsetSize;     // size and modification time of the subset file
+  long long subsetTime;
+};
+
+// table entry of an image
+struct HistogramCacheEntry {
+  long long offset;         // of the counts in the file (0 if not cached)
+  long long featureSize;    // size and modification time of the feature file
+  long long featureTime;
+  int numCells;
+  int dim;
+  int shortCounts;
+  int padding;
+};
+
+// size and modification time of a file (-1 if it does not exist)
+static void fileStatus(const string &filename, long long &size, long long &time) {
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) {
+    size = -1;
+    time = -1;
+    return;
+  }
+  size = (long long) st.st_size;
+  time = (long long) st.st_mtime;
+}
+
+// last component of a path (ignoring trailing slashes)
+static string baseName(string filename) {
+  while (filename.size() > 1 && filename[filename.size()-1] == '/') {
+    filename.erase(filename.size()-1);
+  }
+  size_t slash = filename.rfind('/');
+  if (slash != string::npos) {
+    filename = filename.substr(slash+1);
+  }
+  return filename;
+}
+
+
+// constructor and destructor
+IntegralHistogramCache::IntegralHistogramCache() :
+  dataManager(NULL),
+  stepSize(0),
+  layout(CELL_MAJOR),
+  blockSize(64),
+  numImages(0),
+  mapping(NULL),
+  mappingSize(0),
+  entries(NULL),
+  rebuilt(false),
+  openTime(0.0) { }
+
+IntegralHistogramCache::~IntegralHistogramCache() {
+  unmap();
+}
+
+// getters
+bool IntegralHistogramCache::isOpen() {
+  return mapping != NULL;
+}
+
+int IntegralHistogramCache::getStepSize() {
+  return stepSize;
+}
+
+string IntegralHistogramCache::getPath() {
+  return path;
+}
+
+size_t IntegralHistogramCache::getBytes() {
+  return mappingSize;
+}
+
+bool IntegralHistogramCache::wasRebuilt() {
+  return rebuilt;
+}
+
+double IntegralHistogramCache::getOpenTime() {
+  return openTime;
+}
+
+bool IntegralHistogramCache::matches(DataManager *dm, int stepSize_, HistogramLayout layout_, int blockSize_) {
+  return isOpen() && dataManager == dm && stepSize == stepSize_ && layout == layout_ && blockSize == blockSize_;
+}
+
+// default file name: <subset>_<feature directory>_<step size>.ihc
+string IntegralHistogramCache::getFileName(const string &dir, DataManager *dm, int stepSize) {
+  string subset = baseName(dm->getSubsetPath());
+  size_t dot = subset.rfind('.');
+  if (dot != string::npos && dot > 0) {
+    subset = subset.substr(0, dot);
+  }
+
+  ostringstream os;
+  os << dir << "/" << subset << "_" << baseName(dm->getImagePath()) << "_" << stepSize << ".ihc";
+  return os.str();
+}
+
+
+// map the cache file (rebuild first if needed)
+void IntegralHistogramCache::open(const string &path_, DataManager *dm, int stepSize_,
+                                  HistogramLayout layout_, int blockSize_) {
+
+  double start = getwalltime();
+
+  unmap();
+  path = path_;
+  dataManager = dm;
+  stepSize = stepSize_;
+  layout = layout_;
+  blockSize = blockSize_;
+  numImages = dm->getNumFiles();
+
+  // histograms are padded to whole tiles, so use the same block size as them
+  IntegralHistogram histogram(layout, blockSize);
+  blockSize = histogram.getBlockSize();
+
+  rebuilt = false;
+  if (!map(dm)) {
+    unmap();
+    build(dm);
+    rebuilt = true;
+    if (!map(dm)) {
+      unmap();
+      throw CACHE_WRITE_ERROR;
+    }
+  }
+
+  openTime = getwalltime() - start;
+}
+
+void IntegralHistogramCache::close() {
+  unmap();
+}
+
+
+// map the file and check that it is up to date
+bool IntegralHistogramCache::map(DataManager *dm) {
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(HistogramCacheHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  mappingSize = (size_t) st.st_size;
+  mapping = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = NULL;
+    mappingSize = 0;
+    return false;
+  }
+
+  // check header
+  const HistogramCacheHeader *header = (const HistogramCacheHeader *) mapping;
+  long long size, time;
+  fileStatus(dm->getSubsetPath(), size, time);
+  if (memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header->stepSize != stepSize || header->layout != (int) layout || header->blockSize != blockSize ||
+      header->numImages != numImages || header->subsetSize != size || header->subsetTime != time) {
+    return false;
+  }
+
+  size_t tableEnd = sizeof(HistogramCacheHeader) + numImages*sizeof(HistogramCacheEntry);
+  if (mappingSize < tableEnd) {
+    return false;
+  }
+  entries = (const HistogramCacheEntry *) ((const char *) mapping + sizeof(HistogramCacheHeader));
+
+  // check that the feature files have not changed and the counts are in the file
+  vector<string> &filenames = dm->getFilenames();
+  size_t bytes;
+  for (int i=0; i<numImages; i++) {
+    fileStatus(dm->getImagePath() + "/" + filenames[i], size, time);
+    if (entries[i].featureSize != size || entries[i].featureTime != time) {
+      return false;
+    }
+    if (entries[i].offset > 0) {
+      bytes = (size_t) entries[i].numCells*((entries[i].dim + blockSize - 1)/blockSize)*blockSize
+              *(entries[i].shortCounts ? sizeof(unsigned short) : sizeof(int));
+      if (entries[i].offset % 64 != 0 || (size_t) entries[i].offset + bytes > mappingSize) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void IntegralHistogramCache::unmap() {
+  if (mapping != NULL) {
+    munmap(mapping, mappingSize);
+  }
+  mapping = NULL;
+  mappingSize = 0;
+  entries = NULL;
+}
+
+
+// compute the integral histograms and write them to the file
+// (written to a temporary file first, so an interrupted build leaves no broken cache)
+void IntegralHistogramCache::build(DataManager *dm) {
+
+  ConditionalRandomField crf(dm);
+  crf.setStepSize(stepSize);
+  crf.setHistogramLayout(layout, blockSize);
+  IntegralHistogram *histogram = crf.getIntegralHistogram();
+
+  string tempPath = path + ".tmp";
+  ofstream fs(tempPath.c_str(), ios::binary | ios::trunc);
+  if (!fs.is_open()) {
+    throw CACHE_WRITE_ERROR;
+  }
+
+  // header
+  HistogramCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.stepSize  = stepSize;
+  header.layout    = (int) layout;
+  header.blockSize = blockSize;
+  header.numImages = numImages;
+  fileStatus(dm->getSubsetPath(), header.subsetSize, header.subsetTime);
+  fs.write((const char *) &header, sizeof(header));
+
+  // table is filled in after the counts have been written
+  vector<HistogramCacheEntry> table(numImages + 1);
+  memset(&table[0], 0, table.size()*sizeof(HistogramCacheEntry));
+  fs.write((const char *) &table[0], numImages*sizeof(HistogramCacheEntry));
+
+  vector<string> &filenames = dm->getFilenames();
+  long long offset = sizeof(header) + numImages*sizeof(HistogramCacheEntry);
+  char zeros[64];
+  memset(zeros, 0, sizeof(zeros));
+
+  for (int i=0; i<numImages; i++) {
+    fileStatus(dm->getImagePath() + "/" + filenames[i], table[i].featureSize, table[i].featureTime);
+
+    // images which are too small are not cached
+    try {
+      crf.computeIntegralHistogram(i);
+    }
+    catch (int e) {
+      if (e != STEP_SIZE_TOO_LARGE) {
+        throw;
+      }
+      continue;
+    }
+
+    // align counts to 64 bytes
+    if (offset % 64 != 0) {
+      fs.write(zeros, 64 - offset % 64);
+      offset += 64 - offset % 64;
+    }
+
+    table[i].offset      = offset;
+    table[i].numCells    = histogram->getNumCells();
+    table[i].dim         = histogram->getDim();
+    table[i].shortCounts = histogram->hasShortCounts() ? 1 : 0;
+
+    fs.write((const char *) histogram->getData(), histogram->getBytes());
+    offset += histogram->getBytes();
+  }
+
+  fs.seekp(sizeof(header));
+  fs.write((const char *) &table[0], numImages*sizeof(HistogramCacheEntry));
+  fs.close();
+
+  if (fs.fail() || rename(tempPath.c_str(), path.c_str()) != 0) {
+    remove(tempPath.c_str());
+    throw CACHE_WRITE_ERROR;
+  }
+}
+
+
+// view the cached integral histogram of an image
+bool IntegralHistogramCache::getIntegralHistogram(IntegralHistogram &histogram, int imageNumber) {
+  if (!isOpen() || imageNumber < 0 || imageNumber >= numImages || entries[imageNumber].offset == 0) {
+    return false;
+  }
+
+  const HistogramCacheEntry &entry = entries[imageNumber];
+  histogram.view((const char *) mapping + entry.offset, entry.numCells, entry.dim, entry.shortCounts != 0);
+  return true;
+}
@@ -0,0 +1,100 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _INTEGRAL_HISTOGRAM_CACHE_H_
+#define _INTEGRAL_HISTOGRAM_CACHE_H_
+
+#include <cstddef>
+#include <string>
+
+#include "DataManager.h"
+#include "IntegralHistogram.h"
+
+// table entry of an image in the cache file
+struct HistogramCacheEntry;
+
+// integral histograms of all images of a dataset for one step size, stored in
+// a file which is memory mapped, so they are computed once instead of in every
+// run and every iteration (they do not depend on the weights)
+//
+// file layout: header, one table entry per image, and the counts of each image
+// exactly as in IntegralHistogram (64-byte aligned). The cache is rebuilt when
+// the step size, the histogram layout, the subset file or any feature file
+// (size or modification time) differs from when it was built
+class IntegralHistogramCache {
+
+  private:
+
+    std::string path;
+    DataManager *dataManager;
+    int stepSize;
+    HistogramLayout layout;
+    int blockSize;
+    int numImages;
+
+    // memory mapped file
+    void *mapping;
+    size_t mappingSize;
+    const HistogramCacheEntry *entries;
+
+    // statistics of the last call to open
+    bool rebuilt;
+    double openTime;
+
+    // map the file and check that it is up to date (false if not)
+    bool map(DataManager *dm);
+    void unmap();
+
+    // compute the integral histograms of all images and write the file
+    void build(DataManager *dm);
+
+    // not copyable (owns the mapping)
+    IntegralHistogramCache(const IntegralHistogramCache &);
+    IntegralHistogramCache &operator=(const IntegralHistogramCache &);
+
+  public:
+
+    // constructor and destructor
+    IntegralHistogramCache();
+    ~IntegralHistogramCache();
+
+    // map the cache file for the images of the data manager,
+    // (re)building it first when it is missing or stale
+    void open(const std::string &path, DataManager *dm, int stepSize,
+              HistogramLayout layout = CELL_MAJOR, int blockSize = 64);
+    void close();
+
+    // default file name for a dataset (subset file, feature directory) and step size
+    static std::string getFileName(const std::string &dir, DataManager *dm, int stepSize);
+
+    // getters
+    bool isOpen();
+    int getStepSize();
+    std::string getPath();
+    size_t getBytes();
+
+    // true if the last call to open had to build the file, and the time it took
+    bool wasRebuilt();
+    double getOpenTime();
+
+    // true if the cache holds histograms of the dataset for the step size and layout
+    bool matches(DataManager *dm, int stepSize, HistogramLayout layout, int blockSize);
+
+    // let histogram view the cached integral histogram of an image
+    // (false if the image is not in the cache)
+    bool getIntegralHistogram(IntegralHistogram &histogram, int imageNumber);
+
+};
+
+#endif // _INTEGRAL_HISTOGRAM_CACHE_H_
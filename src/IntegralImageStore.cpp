@@ -0,0 +1,192 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include "IntegralImageStore.h"
+
+using namespace std;
+
+// integrate the weight sums of the cells
+void integrateCells(IntegralImage &integralImage, int iiWidth, int iiHeight) {
+
+  // calculate integral image vertically
+  for (int j=1; j < iiHeight; j++) {
+    for (int i=1; i < iiWidth; i++) {
+      integralImage[j*iiWidth+i] += integralImage[(j-1)*iiWidth+i];
+    }
+  }
+  // calculate integral image horizontally
+  for (int j=1; j < iiHeight; j++) {
+    for (int i=1; i < iiWidth; i++) {
+      integralImage[j*iiWidth+i] += integralImage[j*iiWidth+i-1];
+    }
+  }
+}
+
+
+// constructors
+IntegralImageStore::IntegralImageStore() :
+  enabled(false),
+  maxChangedFraction(0.25),
+  maxUpdates(100),
+  numIncremental(0),
+  numFull(0) { }
+
+IntegralImageStore::IntegralImageStore(const IntegralImageStore &other) :
+  enabled(other.enabled),
+  maxChangedFraction(other.maxChangedFraction),
+  maxUpdates(other.maxUpdates),
+  numIncremental(0),
+  numFull(0) { }
+
+IntegralImageStore &IntegralImageStore::operator=(const IntegralImageStore &other) {
+  if (this != &other) {
+    clear();
+    enabled = other.enabled;
+    maxChangedFraction = other.maxChangedFraction;
+    maxUpdates = other.maxUpdates;
+  }
+  return *this;
+}
+
+// getters/setters
+bool IntegralImageStore::isEnabled() {
+  return enabled;
+}
+
+void IntegralImageStore::setEnabled(bool e) {
+  enabled = e;
+  if (!enabled) {
+    clear();
+  }
+}
+
+double IntegralImageStore::getMaxChangedFraction() {
+  return maxChangedFraction;
+}
+
+void IntegralImageStore::setMaxChangedFraction(double fraction) {
+  maxChangedFraction = fraction;
+}
+
+int IntegralImageStore::getNumIncremental() {
+  return numIncremental;
+}
+
+int IntegralImageStore::getNumFull() {
+  return numFull;
+}
+
+void IntegralImageStore::clear() {
+  entries.clear();
+  numIncremental = 0;
+  numFull = 0;
+}
+
+
+// rebuild the cells from all features
+// (features are added in the same order as in computeIntegralImage)
+void IntegralImageStore::rebuild(Entry &entry, const Image &img, int stepSize, const Weights &w, int iiWidth, int iiHeight) {
+
+  short x,y;
+
+  // sort the cells of the features by local visual word
+  if (entry.stepSize != stepSize) {
+    entry.wordStart.assign(img.numClusters+1, 0);
+    for (int k=0; k<img.numFeatures; k++) {
+      entry.wordStart[img.localC[k]+1]++;
+    }
+    for (int i=0; i<img.numClusters; i++) {
+      entry.wordStart[i+1] += entry.wordStart[i];
+    }
+
+    Ivector next(entry.wordStart.begin(), entry.wordStart.end()-1);
+    entry.wordCells.resize(img.numFeatures);
+    for (int k=0; k<img.numFeatures; k++) {
+      x = img.x[k]/stepSize +1;
+      y = img.y[k]/stepSize +1;
+      entry.wordCells[next[img.localC[k]]++] = (x < iiWidth && y < iiHeight) ? y*iiWidth+x : -1;
+    }
+    entry.stepSize = stepSize;
+  }
+
+  entry.cells.assign(iiWidth*iiHeight, 0.);
+  for (int k=0; k<img.numFeatures; k++) {
+    x = img.x[k]/stepSize +1;
+    y = img.y[k]/stepSize +1;
+    if (x < iiWidth && y < iiHeight) {
+      entry.cells[y*iiWidth+x] += w[img.c[k]];
+    }
+  }
+
+  entry.weights.resize(img.numClusters);
+  for (int i=0; i<img.numClusters; i++) {
+    entry.weights[i] = w[img.clusters[i]];
+  }
+  entry.numUpdates = 0;
+  numFull++;
+}
+
+
+// compute integral image (incrementally if possible)
+void IntegralImageStore::compute(IntegralImage &integralImage, const Image &img, int imageNumber, int stepSize,
+                                 const Weights &w, int iiWidth, int iiHeight) {
+
+  if ((int) entries.size() <= imageNumber) {
+    Entry empty;
+    empty.stepSize = 0;
+    empty.numUpdates = 0;
+    entries.resize(imageNumber+1, empty);
+  }
+  Entry &entry = entries[imageNumber];
+
+  // number of features of the visual words whose weight changed
+  int affected = 0;
+  bool valid = (entry.stepSize == stepSize && entry.numUpdates < maxUpdates);
+  if (valid) {
+    for (int i=0; i<img.numClusters; i++) {
+      if (w[img.clusters[i]] != entry.weights[i]) {
+        affected += entry.wordStart[i+1] - entry.wordStart[i];
+      }
+    }
+  }
+
+  if (!valid || affected > maxChangedFraction*img.numFeatures) {
+    rebuild(entry, img, stepSize, w, iiWidth, iiHeight);
+  } else if (affected > 0) {
+
+    // add the weight changes of the affected features
+    double delta;
+    int cell;
+    for (int i=0; i<img.numClusters; i++) {
+      delta = w[img.clusters[i]] - entry.weights[i];
+      if (delta != 0.0) {
+        for (int f=entry.wordStart[i]; f<entry.wordStart[i+1]; f++) {
+          cell = entry.wordCells[f];
+          if (cell >= 0) {
+            entry.cells[cell] += delta;
+          }
+        }
+        entry.weights[i] = w[img.clusters[i]];
+      }
+    }
+    entry.numUpdates++;
+    numIncremental++;
+  } else {
+    numIncremental++;
+  }
+
+  // integrate
+  integralImage.assign(entry.cells.begin(), entry.cells.end());
+  integrateCells(integralImage, iiWidth, iiHeight);
+}
@@ -0,0 +1,92 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _INTEGRAL_IMAGE_STORE_H_
+#define _INTEGRAL_IMAGE_STORE_H_
+
+#include <vector>
+
+#include "Types.h"
+
+// integrate the weight sums of the cells of an integral image in place
+// (first vertically, then horizontally)
+void integrateCells(IntegralImage &integralImage, int iiWidth, int iiHeight);
+
+
+// keeps the weight sums of the cells of every image between calls, together
+// with the weights they were computed from, so that the integral image can be
+// updated when only a few of the image's visual words changed weight (e.g.
+// sparse stochastic gradient steps). Only the features of the changed words
+// are added to the cells before they are integrated again. When too many
+// features are affected the cells are rebuilt from all features, which gives
+// exactly the same integral image as ConditionalRandomField::computeIntegralImage
+class IntegralImageStore {
+
+  private:
+
+    // state of an image
+    struct Entry {
+      int stepSize;         // step size of the cells (0 if not computed)
+      Dvector weights;      // weights of the local visual words when last computed
+      Dvector cells;        // weight sums of the cells (before integration)
+      int numUpdates;       // incremental updates since the cells were rebuilt
+
+      // cells of the features sorted by local visual word: the cells of word i
+      // are wordCells[wordStart[i]], ..., wordCells[wordStart[i+1]-1]
+      // (-1 for features outside the integral image)
+      Ivector wordStart;
+      Ivector wordCells;
+    };
+
+    std::vector<Entry> entries;
+
+    bool enabled;
+    double maxChangedFraction;  // rebuild when more of the features are affected
+    int maxUpdates;             // rebuild after this many updates (bounds round-off)
+
+    // statistics
+    int numIncremental;
+    int numFull;
+
+    // rebuild the cells of an image from all its features
+    void rebuild(Entry &entry, const Image &img, int stepSize, const Weights &w, int iiWidth, int iiHeight);
+
+  public:
+
+    // constructors (copies start out empty, the store is only a cache)
+    IntegralImageStore();
+    IntegralImageStore(const IntegralImageStore &other);
+    IntegralImageStore &operator=(const IntegralImageStore &other);
+
+    // getters/setters
+    bool isEnabled();
+    void setEnabled(bool enabled);
+
+    double getMaxChangedFraction();
+    void setMaxChangedFraction(double fraction);
+
+    int getNumIncremental();
+    int getNumFull();
+
+    // forget all images
+    void clear();
+
+    // compute the integral image of an image for the weights w,
+    // incrementally if possible
+    void compute(IntegralImage &integralImage, const Image &img, int imageNumber, int stepSize,
+                 const Weights &w, int iiWidth, int iiHeight);
+
+};
+
+#endif // _INTEGRAL_IMAGE_STORE_H_
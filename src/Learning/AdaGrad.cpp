@@ -0,0 +1,73 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cmath>
+
+#include "AdaGrad.h"
+
+using namespace std;
+
+// constructor
+AdaGrad::AdaGrad(ObjectiveFunction *obj, StochasticGradient *grad, double eta0_) :
+  StochasticGradientDescent(obj, grad),
+  eta0(eta0_) { }
+
+// getters/setters
+double AdaGrad::getEta0() {
+  return eta0;
+}
+
+void AdaGrad::setEta0(double eta0_) {
+  eta0 = eta0_;
+}
+
+// constant base learning rate (the adaptation is per visual word)
+double AdaGrad::learningRate(int iteration) {
+  return eta0;
+}
+
+// g_c/sqrt(G_c) where G_c is the sum of squared gradients of visual word c
+void AdaGrad::direction(SparseVector &grad) {
+  int c;
+  for (size_t k=0; k<grad.index.size(); k++) {
+    c = grad.index[k];
+    sumSquares[c] += grad.value[k]*grad.value[k];
+    if (sumSquares[c] > 0.0) {
+      grad.value[k] /= sqrt(sumSquares[c]);
+    }
+  }
+}
+
+// the direction is normalized, so a mini-batch takes one step of eta0
+double AdaGrad::batchScale(int n) {
+  return 1.0;
+}
+
+void AdaGrad::initializeState(int weightDim) {
+  sumSquares.assign(weightDim, 0.0);
+}
+
+// the state per visual word in checkpoints
+void AdaGrad::saveState(Checkpoint &checkpoint) {
+  checkpoint.putVector(sumSquares);
+}
+
+void AdaGrad::loadState(Checkpoint &checkpoint) {
+  checkpoint.getVector(sumSquares);
+}
+
+// the state per visual word is updated in every step (no Hogwild)
+bool AdaGrad::lockFreeSteps() {
+  return false;
+}
@@ -0,0 +1,55 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _ADAGRAD_H_
+#define _ADAGRAD_H_
+
+#include "StochasticGradientDescent.h"
+
+// AdaGrad (Duchi, Hazan and Singer, 2011)
+// each visual word gets its own learning rate eta/sqrt(sum of its squared
+// gradients), so rare visual words take larger steps than frequent ones.
+// Only the visual words of the image are touched in a step. The regularizer
+// is applied as a decay of all weights with the base learning rate, as in SGD
+// (w = scale*v), instead of being part of the accumulated gradients
+class AdaGrad : public StochasticGradientDescent {
+
+  protected:
+
+    // base learning rate
+    double eta0;
+
+    // sum of squared gradients of each visual word
+    Dvector sumSquares;
+
+    virtual double learningRate(int iteration);
+    virtual void direction(SparseVector &grad);
+    virtual double batchScale(int n);
+    virtual void initializeState(int weightDim);
+    virtual void saveState(Checkpoint &checkpoint);
+    virtual void loadState(Checkpoint &checkpoint);
+    virtual bool lockFreeSteps();
+
+  public:
+
+    // constructor
+    AdaGrad(ObjectiveFunction *obj, StochasticGradient *grad, double eta0_ = 0.1);
+
+    // getters/setters
+    double getEta0();
+    void setEta0(double eta0_);
+
+};
+
+#endif // _ADAGRAD_H_
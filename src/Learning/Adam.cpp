@@ -0,0 +1,95 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cmath>
+
+#include "Adam.h"
+
+using namespace std;
+
+// constructor
+Adam::Adam(ObjectiveFunction *obj, StochasticGradient *grad, double eta0_) :
+  StochasticGradientDescent(obj, grad),
+  eta0(eta0_),
+  beta1(0.9),
+  beta2(0.999),
+  epsilon(1e-8),
+  steps(0) { }
+
+// getters/setters
+double Adam::getEta0() {
+  return eta0;
+}
+
+void Adam::setEta0(double eta0_) {
+  eta0 = eta0_;
+}
+
+void Adam::setBeta1(double beta) {
+  beta1 = beta;
+}
+
+void Adam::setBeta2(double beta) {
+  beta2 = beta;
+}
+
+// constant base learning rate (the adaptation is per visual word)
+double Adam::learningRate(int iteration) {
+  return eta0;
+}
+
+// m_c/(sqrt(v_c)+epsilon) with bias corrected averages
+void Adam::direction(SparseVector &grad) {
+  steps++;
+  double correction1 = 1.0 - pow(beta1, steps);
+  double correction2 = 1.0 - pow(beta2, steps);
+  double g;
+  int c;
+  for (size_t k=0; k<grad.index.size(); k++) {
+    c = grad.index[k];
+    g = grad.value[k];
+    firstMoment[c]  = beta1*firstMoment[c] + (1.0-beta1)*g;
+    secondMoment[c] = beta2*secondMoment[c] + (1.0-beta2)*g*g;
+    grad.value[k] = (firstMoment[c]/correction1) / (sqrt(secondMoment[c]/correction2) + epsilon);
+  }
+}
+
+// the direction is normalized, so a mini-batch takes one step of eta0
+double Adam::batchScale(int n) {
+  return 1.0;
+}
+
+void Adam::initializeState(int weightDim) {
+  firstMoment.assign(weightDim, 0.0);
+  secondMoment.assign(weightDim, 0.0);
+  steps = 0;
+}
+
+// the state per visual word in checkpoints
+void Adam::saveState(Checkpoint &checkpoint) {
+  checkpoint.put(steps);
+  checkpoint.putVector(firstMoment);
+  checkpoint.putVector(secondMoment);
+}
+
+void Adam::loadState(Checkpoint &checkpoint) {
+  checkpoint.get(steps);
+  checkpoint.getVector(firstMoment);
+  checkpoint.getVector(secondMoment);
+}
+
+// the state per visual word is updated in every step (no Hogwild)
+bool Adam::lockFreeSteps() {
+  return false;
+}
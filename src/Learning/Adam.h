@@ -0,0 +1,65 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _ADAM_H_
+#define _ADAM_H_
+
+#include "StochasticGradientDescent.h"
+
+// Adam (Kingma and Ba, 2015)
+// keeps running averages of the gradient and the squared gradient of each
+// visual word and steps along m/(sqrt(v)+epsilon) (with bias correction).
+// The averages are only updated for the visual words of the image ("lazy"
+// Adam), and the regularizer is applied as a decay of all weights
+// (decoupled weight decay, w = scale*v as in SGD)
+class Adam : public StochasticGradientDescent {
+
+  protected:
+
+    // base learning rate and decay rates of the averages
+    double eta0;
+    double beta1;
+    double beta2;
+    double epsilon;
+
+    // steps taken since initializeState (for the bias correction)
+    int steps;
+
+    // running averages of the gradient and the squared gradient
+    Dvector firstMoment;
+    Dvector secondMoment;
+
+    virtual double learningRate(int iteration);
+    virtual void direction(SparseVector &grad);
+    virtual double batchScale(int n);
+    virtual void initializeState(int weightDim);
+    virtual void saveState(Checkpoint &checkpoint);
+    virtual void loadState(Checkpoint &checkpoint);
+    virtual bool lockFreeSteps();
+
+  public:
+
+    // constructor
+    Adam(ObjectiveFunction *obj, StochasticGradient *grad, double eta0_ = 1e-3);
+
+    // getters/setters
+    double getEta0();
+    void setEta0(double eta0_);
+
+    void setBeta1(double beta);
+    void setBeta2(double beta);
+
+};
+
+#endif // _ADAM_H_
@@ -0,0 +1,187 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "Checkpoint.h"
+
+using namespace std;
+
+// identifies the file format (change when the layout of the file changes)
+static const char CHECKPOINT_MAGIC[8] = "CRFCKP1";
+
+
+// constructor
+Checkpoint::Checkpoint(const string &learner_) : learner(learner_), position(0) { }
+
+string Checkpoint::getLearner() {
+  return learner;
+}
+
+// write checkpoint to file
+void Checkpoint::write(const string &path) const {
+
+  string tempPath = path + ".tmp";
+  ofstream fs(tempPath.c_str(), ios::binary | ios::trunc);
+  if (!fs.is_open()) {
+    throw CHECKPOINT_ERROR;
+  }
+
+  long long learnerSize = learner.size();
+  long long dataSize = data.size();
+  fs.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  fs.write((const char *) &learnerSize, sizeof(learnerSize));
+  fs.write(learner.data(), learnerSize);
+  fs.write((const char *) &dataSize, sizeof(dataSize));
+  fs.write(data.data(), dataSize);
+  fs.close();
+
+  if (fs.fail() || rename(tempPath.c_str(), path.c_str()) != 0) {
+    remove(tempPath.c_str());
+    throw CHECKPOINT_ERROR;
+  }
+}
+
+// read checkpoint from file
+void Checkpoint::read(const string &path) {
+
+  ifstream fs(path.c_str(), ios::binary);
+  if (!fs.is_open()) {
+    throw FILE_NOT_FOUND;
+  }
+
+  char magic[8];
+  long long learnerSize, dataSize;
+  fs.read(magic, sizeof(magic));
+  fs.read((char *) &learnerSize, sizeof(learnerSize));
+  if (fs.fail() || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 || learnerSize < 0) {
+    throw CHECKPOINT_ERROR;
+  }
+  learner.resize(learnerSize);
+  fs.read(&learner[0], learnerSize);
+  fs.read((char *) &dataSize, sizeof(dataSize));
+  if (fs.fail() || dataSize < 0) {
+    throw CHECKPOINT_ERROR;
+  }
+  data.resize(dataSize);
+  fs.read(&data[0], dataSize);
+  if (fs.fail()) {
+    throw CHECKPOINT_ERROR;
+  }
+  position = 0;
+}
+
+
+// constructor (starts the thread)
+CheckpointWriter::CheckpointWriter(const string &path_) :
+  path(path_),
+  hasPending(false),
+  busy(false),
+  stop(false),
+  error(0)
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&pendingCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  pthread_create(&thread, NULL, worker, this);
+}
+
+// destructor (writes the pending checkpoint and joins the thread)
+CheckpointWriter::~CheckpointWriter() {
+  pthread_mutex_lock(&mutex);
+  stop = true;
+  pthread_cond_signal(&pendingCond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, NULL);
+
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&pendingCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+string CheckpointWriter::getPath() {
+  return path;
+}
+
+// replace the pending checkpoint
+void CheckpointWriter::submit(const Checkpoint &checkpoint) {
+  pthread_mutex_lock(&mutex);
+  pending = checkpoint;
+  hasPending = true;
+  pthread_cond_signal(&pendingCond);
+  pthread_mutex_unlock(&mutex);
+}
+
+// wait until the thread is idle
+void CheckpointWriter::finish() {
+  pthread_mutex_lock(&mutex);
+  while (hasPending || busy) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  int e = error;
+  error = 0;
+  pthread_mutex_unlock(&mutex);
+
+  if (e != 0) {
+    throw e;
+  }
+}
+
+
+// main loop of the thread
+void *CheckpointWriter::worker(void *arg) {
+  ((CheckpointWriter *) arg)->work();
+  return NULL;
+}
+
+void CheckpointWriter::work() {
+
+  Checkpoint checkpoint;
+
+  pthread_mutex_lock(&mutex);
+  while (true) {
+
+    // wait for a checkpoint (the pending one is written before stopping)
+    while (!stop && !hasPending) {
+      pthread_cond_wait(&pendingCond, &mutex);
+    }
+    if (!hasPending) {
+      break;
+    }
+    checkpoint = pending;
+    hasPending = false;
+    busy = true;
+    pthread_mutex_unlock(&mutex);
+
+    int e = 0;
+    try {
+      checkpoint.write(path);
+    }
+    catch (int code) {
+      e = code;
+    }
+
+    pthread_mutex_lock(&mutex);
+    busy = false;
+    if (e != 0 && error == 0) {
+      error = e;
+    }
+    if (!hasPending) {
+      pthread_cond_broadcast(&doneCond);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,149 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include "Types.h"
+
+// state of a learner, so that a run can be resumed where it was stopped
+// the learner puts its values and gets them back in the same order
+//
+// file layout: magic, the name of the learner, the size of the data and the
+// data (the raw bytes of the values, so only for the same machine)
+class Checkpoint {
+
+  private:
+
+    std::string learner;
+    std::string data;
+    size_t position;
+
+  public:
+
+    // constructor (name of the learner which the state belongs to)
+    Checkpoint(const std::string &learner = "");
+
+    std::string getLearner();
+
+    // append a value or a vector of values (plain types only)
+    template <class T>
+    void put(const T &value);
+    template <class T>
+    void putVector(const std::vector<T> &values);
+
+    // read the next value or vector (throws CHECKPOINT_ERROR past the end)
+    template <class T>
+    void get(T &value);
+    template <class T>
+    void getVector(std::vector<T> &values);
+
+    // write to a temporary file which is renamed to path, so an interrupted
+    // write leaves the last checkpoint (throws CHECKPOINT_ERROR)
+    void write(const std::string &path) const;
+
+    // read a checkpoint written by write
+    // (throws FILE_NOT_FOUND or CHECKPOINT_ERROR if the file is broken)
+    void read(const std::string &path);
+
+};
+
+
+// writes checkpoints on a thread, so the learner does not wait for the disk
+// only the newest checkpoint submitted while one is written is kept
+class CheckpointWriter {
+
+  private:
+
+    std::string path;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t pendingCond;   // signalled when a checkpoint is submitted or the thread stops
+    pthread_cond_t doneCond;      // signalled when the thread is idle
+    Checkpoint pending;
+    bool hasPending;
+    bool busy;
+    bool stop;
+    int error;                    // first error of a write
+
+    // main loop of the thread
+    static void *worker(void *arg);
+    void work();
+
+    // not copyable (owns the thread)
+    CheckpointWriter(const CheckpointWriter &);
+    CheckpointWriter &operator=(const CheckpointWriter &);
+
+  public:
+
+    // constructor and destructor (the destructor writes the pending checkpoint)
+    CheckpointWriter(const std::string &path);
+    ~CheckpointWriter();
+
+    std::string getPath();
+
+    // write a copy of the checkpoint in the background
+    void submit(const Checkpoint &checkpoint);
+
+    // wait until the last checkpoint is written
+    // (rethrows the error of a failed write)
+    void finish();
+
+};
+
+
+// inline functions
+template <class T>
+inline void Checkpoint::put(const T &value) {
+  data.append((const char *) &value, sizeof(T));
+}
+
+template <class T>
+inline void Checkpoint::putVector(const std::vector<T> &values) {
+  put((long long) values.size());
+  if (!values.empty()) {
+    data.append((const char *) &values[0], values.size()*sizeof(T));
+  }
+}
+
+template <class T>
+inline void Checkpoint::get(T &value) {
+  if (position + sizeof(T) > data.size()) {
+    throw CHECKPOINT_ERROR;
+  }
+  memcpy(&value, data.data() + position, sizeof(T));
+  position += sizeof(T);
+}
+
+template <class T>
+inline void Checkpoint::getVector(std::vector<T> &values) {
+  long long size;
+  get(size);
+  if (size < 0 || position + size*sizeof(T) > data.size()) {
+    throw CHECKPOINT_ERROR;
+  }
+  values.resize(size);
+  if (size > 0) {
+    memcpy(&values[0], data.data() + position, size*sizeof(T));
+  }
+  position += size*sizeof(T);
+}
+
+#endif // _CHECKPOINT_H_
@@ -0,0 +1,130 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <iostream>
+
+#include "CoarseToFine.h"
+
+using namespace std;
+
+
+// constructors
+CoarseToFine::CoarseToFine(ConditionalRandomField *crf_, LBFGS *lbfgs_) :
+  crf(crf_),
+  lbfgs(lbfgs_),
+  sgd(NULL) { }
+
+CoarseToFine::CoarseToFine(ConditionalRandomField *crf_, StochasticGradientDescent *sgd_) :
+  crf(crf_),
+  lbfgs(NULL),
+  sgd(sgd_) { }
+
+// add a stage
+void CoarseToFine::addStage(int stepSize, double tolerance) {
+  stepSizes.push_back(stepSize);
+  tolerances.push_back(tolerance);
+}
+
+// getters
+int CoarseToFine::getNumStages() {
+  return stepSizes.size();
+}
+
+int CoarseToFine::getStepSize(int stage) {
+  return stepSizes[stage];
+}
+
+double CoarseToFine::getTolerance(int stage) {
+  return tolerances[stage];
+}
+
+const Dvector &CoarseToFine::getStageTimes() {
+  return stageTimes;
+}
+
+const vector<Weights> &CoarseToFine::getStageWeights() {
+  return stageWeights;
+}
+
+const Ivector &CoarseToFine::getStageWork() {
+  return stageWork;
+}
+
+int CoarseToFine::getTotalWork() {
+  int work = 0;
+  for (size_t k=0; k<stageWork.size(); k++) {
+    work += stageWork[k];
+  }
+  return work;
+}
+
+
+// run the stages
+Weights CoarseToFine::learnWeights(const Weights &w) {
+
+  stageTimes.clear();
+  stageWork.clear();
+  stageWeights.clear();
+
+  // tolerance of the learner (restored after the last stage)
+  double epsilon = 0.0;
+  int maxEpochs = 0;
+  if (lbfgs != NULL) {
+    epsilon = lbfgs->getEpsilon();
+  } else {
+    maxEpochs = sgd->getMaxEpochs();
+  }
+
+  Weights wStage(w);
+  double start;
+  int error = 0;
+  for (size_t k=0; k<stepSizes.size() && error == 0; k++) {
+
+    // the learner has finished the previous stage (including its progress
+    // evaluations), so nothing uses the CRF at the old step size any more
+    crf->setStepSize(stepSizes[k]);
+
+    cout << "Coarse-to-fine stage " << k+1 << " of " << stepSizes.size();
+    cout << ": step size " << stepSizes[k] << ", tolerance " << tolerances[k] << endl;
+
+    try {
+      start = getwalltime();
+      if (lbfgs != NULL) {
+        lbfgs->setEpsilon(tolerances[k]);
+        wStage = lbfgs->learnWeights(wStage);
+      } else {
+        sgd->setMaxEpochs((int) tolerances[k]);
+        wStage = sgd->learnWeights(wStage);
+      }
+      stageTimes.push_back(getwalltime() - start);
+      stageWork.push_back(lbfgs != NULL ? lbfgs->getFunctionEvaluations() : sgd->getEpochs());
+      stageWeights.push_back(wStage);
+    }
+    catch (int e) {
+      error = e;
+    }
+  }
+
+  // also when a stage failed
+  if (lbfgs != NULL) {
+    lbfgs->setEpsilon(epsilon);
+  } else {
+    sgd->setMaxEpochs(maxEpochs);
+  }
+  if (error != 0) {
+    throw error;
+  }
+
+  return wStage;
+}
@@ -0,0 +1,81 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _COARSE_TO_FINE_H_
+#define _COARSE_TO_FINE_H_
+
+#include <vector>
+
+#include "ConditionalRandomField.h"
+#include "LBFGS.h"
+#include "StochasticGradientDescent.h"
+#include "Types.h"
+
+// coarse-to-fine training schedule: trains with a learner at a list of step
+// sizes (e.g. 32, 16, 8), each stage starting at the weights learned by the
+// previous one. The weights do not depend on the step size, and a stage is
+// roughly (1/stepSize)^4 as expensive, so the coarse stages give the fine
+// stage a good starting point cheaply.
+// The tolerance of a stage is the stop criterion epsilon of L-BFGS, or the
+// number of epochs of SGD and CD
+class CoarseToFine {
+
+  private:
+
+    ConditionalRandomField *crf;
+
+    // the learner (one of them)
+    LBFGS *lbfgs;
+    StochasticGradientDescent *sgd;
+
+    // stages
+    Ivector stepSizes;
+    Dvector tolerances;
+
+    // learning time, work and weights after each stage of the last run
+    Dvector stageTimes;
+    Ivector stageWork;
+    std::vector<Weights> stageWeights;
+
+  public:
+
+    // constructors (the step size of the CRF is changed by each stage)
+    CoarseToFine(ConditionalRandomField *crf, LBFGS *lbfgs);
+    CoarseToFine(ConditionalRandomField *crf, StochasticGradientDescent *sgd);
+
+    // add a stage after the current ones
+    void addStage(int stepSize, double tolerance);
+
+    int getNumStages();
+    int getStepSize(int stage);
+    double getTolerance(int stage);
+
+    // learning time (wall clock, in seconds, as the evaluations use several
+    // threads) and weights after each stage of the last run
+    const Dvector &getStageTimes();
+    const std::vector<Weights> &getStageWeights();
+
+    // work of each stage of the last run: objective evaluations of L-BFGS or
+    // epochs of SGD and CD (getTotalWork sums them)
+    const Ivector &getStageWork();
+    int getTotalWork();
+
+    // run the stages starting at w and return the weights of the last one
+    // (the CRF is left at the step size of the last stage, and the learner
+    // at its own tolerance)
+    Weights learnWeights(const Weights &w);
+
+};
+
+#endif // _COARSE_TO_FINE_H_
@@ -16,6 +16,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <algorithm>
+#include <iostream>
 
 #include "Types.h"
 #include "ContrastiveDivergence.h"
@@ -46,3 +47,55 @@ ContrastiveDivergence::ContrastiveDivergence(ObjectiveFunction *obj, SampledGrad
   gradient->setSkip(chainSteps);
 }
 
+
+// print progress
+void ContrastiveDivergence::progress(Weights &w, int epoch, int t, double eta, bool averaged) {
+
+  StochasticGradientDescent::progress(w, epoch, t, eta, averaged);
+
+  GibbsSampler *sampler = gradient->getSampler();
+  if (sampler->getNumChains() > 0) {
+    cout << "Chains:     " << sampler->getNumChains() << " per image" << endl;
+    cout << "Move rate:  " << sampler->getMoveRate() << endl;
+    cout << "Overlap:    " << sampler->getChainOverlap() << endl;
+    cout << endl;
+    sampler->resetMixingStatistics();
+  }
+}
+
+// the persistent chains in checkpoints (the boxes and the step size of the
+// grid of each image, not the mixing statistics)
+void ContrastiveDivergence::saveState(Checkpoint &checkpoint) {
+  PersistentChains *chains = gradient->getSampler()->getPersistentChains();
+  checkpoint.put(gradient->getNumChains());
+  if (chains != NULL) {
+    checkpoint.putVector(chains->ltrb);
+    checkpoint.putVector(chains->stepSizes);
+  }
+}
+
+// (throws CHECKPOINT_ERROR if the number of chains or images differs)
+void ContrastiveDivergence::loadState(Checkpoint &checkpoint) {
+  PersistentChains *chains = gradient->getSampler()->getPersistentChains();
+  int numChains;
+  checkpoint.get(numChains);
+  if (numChains != gradient->getNumChains()) {
+    throw CHECKPOINT_ERROR;
+  }
+  if (chains == NULL) {
+    return;
+  }
+
+  size_t numBoxes = chains->ltrb.size();
+  size_t numImages = chains->stepSizes.size();
+  checkpoint.getVector(chains->ltrb);
+  checkpoint.getVector(chains->stepSizes);
+  if (chains->ltrb.size() != numBoxes || chains->stepSizes.size() != numImages) {
+    throw CHECKPOINT_ERROR;
+  }
+}
+
+// trials are independent without persistent chains
+bool ContrastiveDivergence::independentTrials() {
+  return gradient->getNumChains() == 0;
+}
@@ -29,6 +29,20 @@ class ContrastiveDivergence : public StochasticGradientDescent {
     int chainSteps;
     int numSamples;
 
+  protected:
+
+    // print progress and the mixing statistics of the persistent chains
+    // during the epoch
+    virtual void progress(Weights &w, int epoch, int t, double eta, bool averaged);
+
+    // the persistent chains in checkpoints
+    virtual void saveState(Checkpoint &checkpoint);
+    virtual void loadState(Checkpoint &checkpoint);
+
+    // the copies of the gradient share the persistent chains, which every
+    // trial advances, so the trials then run one at a time
+    virtual bool independentTrials();
+
   public:
 
     // constructors
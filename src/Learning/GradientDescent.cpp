@@ -12,13 +12,24 @@
  * Date: 27-08-2012
  */
 
+#include <iostream>
 #include <fstream>
+#include <algorithm>
 #include "GradientDescent.h"
+#include "Types.h"
 
 using namespace std;
 
 // constructors
-GradientDescent::GradientDescent(ObjectiveFunction *obj, Gradient *grad) : objective(obj), gradient(grad) { }
+GradientDescent::GradientDescent(ObjectiveFunction *obj, Gradient *grad) : 
+  objective(obj), gradient(grad), fusedEvaluation(true), traceStart(0.0), traceExcluded(0.0),
+  checkpointWriter(NULL), resumeState(NULL), validationHook(NULL) { }
+
+// destructor (waits for the last checkpoint)
+GradientDescent::~GradientDescent() {
+  delete checkpointWriter;
+  delete resumeState;
+}
 
 // getters/setters
 ObjectiveFunction *GradientDescent::getObjective() {
@@ -37,3 +48,146 @@ void GradientDescent::setGradient(Gradient *grad) {
   gradient = grad;
 }
 
+bool GradientDescent::getFusedEvaluation() {
+  return fusedEvaluation;
+}
+
+void GradientDescent::setFusedEvaluation(bool fused) {
+  fusedEvaluation = fused;
+}
+
+// objective function value and gradient at w
+double GradientDescent::evaluateWithGradient(Weights &w, Dvector &grad, bool normalized) {
+  if (fusedEvaluation) {
+    return objective->evaluateWithGradient(w, grad, normalized);
+  }
+  gradient->evaluate(grad, w, normalized);
+  return objective->evaluate(w, normalized);
+}
+
+double GradientDescent::evaluateWithGradient(Weights &w, double *grad, bool normalized) {
+  if (fusedEvaluation) {
+    return objective->evaluateWithGradient(w, grad, normalized);
+  }
+  gradientBuffer.resize(w.size());
+  double fval = evaluateWithGradient(w, gradientBuffer, normalized);
+  copy(gradientBuffer.begin(), gradientBuffer.end(), grad);
+  return fval;
+}
+
+// start recording the objective against learning time
+void GradientDescent::startTrace() {
+  traceStart = getwalltime();
+  traceExcluded = 0.0;
+  traceTimes.clear();
+  traceObjectives.clear();
+}
+
+// time spent learning since startTrace
+double GradientDescent::getLearningTime() {
+  return getwalltime() - traceStart - traceExcluded;
+}
+
+// record fval at the given learning time and exclude the time since then
+void GradientDescent::recordTrace(double time, double fval) {
+  traceTimes.push_back(time);
+  traceObjectives.push_back(fval);
+  traceExcluded += getLearningTime() - time;
+}
+
+const Dvector &GradientDescent::getTraceTimes() {
+  return traceTimes;
+}
+
+const Dvector &GradientDescent::getTraceObjectives() {
+  return traceObjectives;
+}
+
+
+// CHECKPOINTS
+
+string GradientDescent::getCheckpointPath() {
+  return checkpointPath;
+}
+
+void GradientDescent::setCheckpointPath(const string &path) {
+  delete checkpointWriter;
+  checkpointWriter = NULL;
+  checkpointPath = path;
+}
+
+void GradientDescent::resume(const string &path) {
+  Checkpoint *checkpoint = new Checkpoint();
+  try {
+    checkpoint->read(path);
+  }
+  catch (int e) {
+    delete checkpoint;
+    throw;
+  }
+  delete resumeState;
+  resumeState = checkpoint;
+}
+
+// submit a checkpoint to the writer
+void GradientDescent::writeCheckpoint(const Checkpoint &checkpoint) {
+  if (checkpointPath.empty()) {
+    return;
+  }
+  if (checkpointWriter == NULL) {
+    checkpointWriter = new CheckpointWriter(checkpointPath);
+  }
+  checkpointWriter->submit(checkpoint);
+}
+
+// wait for the writer at the end of learnWeights
+void GradientDescent::finishCheckpoints() {
+  if (checkpointWriter != NULL) {
+    checkpointWriter->finish();
+  }
+}
+
+Checkpoint *GradientDescent::takeResumeState(const string &learner) {
+  if (resumeState == NULL) {
+    return NULL;
+  }
+  Checkpoint *checkpoint = resumeState;
+  resumeState = NULL;
+  if (checkpoint->getLearner() != learner) {
+    delete checkpoint;
+    throw CHECKPOINT_ERROR;
+  }
+  return checkpoint;
+}
+
+
+// VALIDATION
+
+ValidationHook *GradientDescent::getValidationHook() {
+  return validationHook;
+}
+
+void GradientDescent::setValidationHook(ValidationHook *hook) {
+  validationHook = hook;
+}
+
+// at the start of learnWeights
+void GradientDescent::startValidation() {
+  if (validationHook != NULL) {
+    validationHook->start();
+  }
+}
+
+bool GradientDescent::validate(const Weights &w, int step) {
+  if (validationHook == NULL) {
+    return false;
+  }
+  return validationHook->validate(w, step);
+}
+
+// at the end of learnWeights
+void GradientDescent::finishValidation(Weights &w) {
+  if (validationHook != NULL && validationHook->finish(w)) {
+    cout << "Using the best validated weights" << endl;
+  }
+}
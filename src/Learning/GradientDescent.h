@@ -17,6 +17,8 @@
 
 #include "ObjectiveFunctions/ObjectiveFunction.h"
 #include "ObjectiveFunctions/Gradient.h"
+#include "Checkpoint.h"
+#include "ValidationHook.h"
 
 // gradient descent learning
 // abstract base class for all learning algorithms
@@ -30,10 +32,60 @@ class GradientDescent {
     // gradient
     Gradient *gradient;
 
+    // evaluate objective and gradient in one pass (see setFusedEvaluation)
+    bool fusedEvaluation;
+
+    // objective function value and gradient at w
+    double evaluateWithGradient(Weights &w, Dvector &grad, bool normalized = true);
+
+    // the same writing the gradient to an array of w.size() values
+    // (only copied from gradientBuffer when not fused)
+    double evaluateWithGradient(Weights &w, double *grad, bool normalized = true);
+    Dvector gradientBuffer;
+
+    // objective value against learning time (for comparing learners)
+    // the time spent between getLearningTime and recordTrace (e.g. evaluating
+    // the objective only for the progress report) is not counted
+    double traceStart;
+    double traceExcluded;
+    Dvector traceTimes;
+    Dvector traceObjectives;
+
+    void startTrace();
+    double getLearningTime();
+    void recordTrace(double time, double fval);
+
+    // checkpoints of the state of the learner (written in the background to
+    // checkpointPath when it is set) and the state to resume from (read by
+    // resume and used by the next call to learnWeights)
+    std::string checkpointPath;
+    CheckpointWriter *checkpointWriter;
+    Checkpoint *resumeState;
+
+    void writeCheckpoint(const Checkpoint &checkpoint);
+    void finishCheckpoints();
+
+    // the state to resume from if it belongs to the learner (NULL otherwise)
+    // the caller deletes it
+    Checkpoint *takeResumeState(const std::string &learner);
+
+    // validation of the weights during learning for early stopping (not
+    // owned, NULL for none)
+    ValidationHook *validationHook;
+
+    void startValidation();
+
+    // validate the weights after a step and return whether to stop
+    bool validate(const Weights &w, int step);
+
+    // replace w by the best weights validated (if any)
+    void finishValidation(Weights &w);
+
   public: 
 
     // constructor
     GradientDescent(ObjectiveFunction *obj, Gradient *grad);
+    virtual ~GradientDescent();
   
     // getters/setters
     ObjectiveFunction *getObjective();
@@ -42,6 +94,32 @@ class GradientDescent {
     Gradient *getGradient();
     void setGradient(Gradient *grad);
 
+    // compute the gradient together with the objective function (default)
+    // this gives the exact gradient of the objective, so disable it to use
+    // a different gradient (e.g. a sampled one) during learning
+    bool getFusedEvaluation();
+    void setFusedEvaluation(bool fused);
+
+    // objective values reported during the last call to learnWeights
+    // and the learning time (in seconds) at which they were reached
+    const Dvector &getTraceTimes();
+    const Dvector &getTraceObjectives();
+
+    // write a checkpoint of the complete state of the learner to path after
+    // every iteration (L-BFGS and Newton-CG) or epoch (SGD and CD), "" for none
+    std::string getCheckpointPath();
+    void setCheckpointPath(const std::string &path);
+
+    // read a checkpoint, so the next call to learnWeights continues from it
+    // instead of the given weights (throws FILE_NOT_FOUND or CHECKPOINT_ERROR)
+    void resume(const std::string &path);
+
+    // validate the weights after every iteration (L-BFGS and Newton-CG) or
+    // epoch (SGD and CD), stop when the hook says so and return the best
+    // weights validated instead of the last ones (NULL for none)
+    ValidationHook *getValidationHook();
+    void setValidationHook(ValidationHook *hook);
+
     // main function (takes a starting point as input)
     // is virtual so that the most derived version is used
     virtual Weights learnWeights(const Weights &w) = 0;
@@ -14,6 +14,7 @@
 
 #include <cstdio>
 #include <fstream>
+#include <algorithm>
 #include <lbfgs.h>
 
 #include "LBFGS.h"
@@ -23,7 +24,7 @@ using namespace std;
 
 // wrapper for using the libLBFGS C library
 // constructor
-LBFGS::LBFGS(ObjectiveFunction *obj, Gradient *grad) : GradientDescent(obj, grad), m_x(NULL) { 
+LBFGS::LBFGS(ObjectiveFunction *obj, Gradient *grad) : GradientDescent(obj, grad) { 
 
   // initialize L-BFGS parameters
   // use Wolfe conditions
@@ -38,29 +39,40 @@ LBFGS::LBFGS(ObjectiveFunction *obj, Gradient *grad) : GradientDescent(obj, grad
   gradient_evals = 0;
   
   iterations = 0;
+  previousIterations = 0;
+  recordStart = false;
 
   tempWeightsPath = "tempWeights.txt";
 
 }
 
 // deconstructor
-LBFGS::~LBFGS() { 
-  if (m_x != NULL) {
-    lbfgs_free(m_x);
-    m_x = NULL;
-  }
-}
+LBFGS::~LBFGS() { }
 
 // set path for storing temporary weights
 void LBFGS::setTempWeightsPath(string path) {
   tempWeightsPath = path;
 }
 
+// stop criterion on the gradient norm
+double LBFGS::getEpsilon() {
+  return params.epsilon;
+}
+
+void LBFGS::setEpsilon(double epsilon) {
+  params.epsilon = epsilon;
+}
+
 // get number of iterations 
 int LBFGS::getIterations() {
   return iterations;
 }
 
+// get number of objective evaluations
+int LBFGS::getFunctionEvaluations() {
+  return function_evals;
+}
+
 // learn weights using LBFGS optimization
 // uses libLBFGS
 Weights LBFGS::learnWeights(const Weights &w) {
@@ -69,37 +81,65 @@ Weights LBFGS::learnWeights(const Weights &w) {
   lbfgsfloatval_t fx;
   
   n = w.size();
-  m_x = lbfgs_malloc(n);
-  Weights w_new(n);
 
   // reset function and gradient evaluation counts
   function_evals = 0;
   gradient_evals = 0;
+  previousIterations = 0;
 
   // initialize variables to the weight values
-  for (int i=0; i<n; i++) {
-    m_x[i] = w[i];
+  m_w = w;
+  pastObjectives.assign(max(params.past, 0), 0.0);
+  recordStart = true;
+
+  // or continue from a checkpoint (libLBFGS can not be given the curvature
+  // pairs, so it builds them up again from the checkpointed weights)
+  Checkpoint *state = takeResumeState("LBFGS");
+  if (state != NULL) {
+    try {
+      state->get(previousIterations);
+      state->get(function_evals);
+      state->get(gradient_evals);
+      state->getVector(m_w);
+      state->getVector(pastObjectives);
+      if ((int) m_w.size() != n || (int) pastObjectives.size() != max(params.past, 0)) {
+        throw CHECKPOINT_ERROR;
+      }
+    }
+    catch (int e) {
+      delete state;
+      throw;
+    }
+    delete state;
+    recordStart = false;
+    printf("Resuming after iteration %d\n", previousIterations);
+    printf("Warning: L-BFGS starts again without its curvature pairs, so the next iterations differ from an uninterrupted run\n");
   }
   
   // call L-BFGS procedure
   printf("Running LBFGS procedure...\n");
   fflush(stdout);
-  ret = lbfgs(n, m_x, &fx, _evaluate, _progress, this, &params);
+  startTrace();
+  startValidation();
+  ret = lbfgs(n, &m_w[0], &fx, _evaluate, _progress, this, &params);
   
   printf("L-BFGS optimization terminated with status code = %d\n", ret);
-  
-  // convert result to Weights and return
-  for (int i=0; i<n; i++) {
-    w_new[i] = m_x[i];
+  finishCheckpoints();
+  finishValidation(m_w);
+
+  // libLBFGS built with SSE rejects the weights before the first iteration
+  if (ret == LBFGSERR_INVALID_X_SSE || ret == LBFGSERR_INVALID_N_SSE) {
+    fprintf(stderr, "libLBFGS must be built without SSE (the weights are not from lbfgs_malloc)\n");
+    throw LBFGS_SSE_ERROR;
   }
   
-  return w_new;
+  return m_w;
 }
 
 
 
 // evaluate objective function and gradient
-// converts weight vectors back and forth to arrays which is time consuming!
+// x is the storage of m_w and the gradient is written to g in place
 lbfgsfloatval_t LBFGS::evaluate(
         const lbfgsfloatval_t *x,
         lbfgsfloatval_t *g,
@@ -108,29 +148,24 @@ lbfgsfloatval_t LBFGS::evaluate(
         )
 {
   
-  Weights w(n);
-  for (int i=0; i<n; i++) {
-    w[i] = x[i];
+  // (only copied if libLBFGS evaluates somewhere else)
+  if (x != &m_w[0]) {
+    m_w.assign(x, x+n);
   }
   
-  Bboxes samples(10);
-  
-  // evaluate objective function
+  // evaluate objective function and gradient
   double fx;
-  fx = objective->evaluate(w);
-  
-  // compute gradient
-  Dvector grad(w.size());
-
-  gradient->evaluate(grad, w);
-  
-  for (int i=0; i<n; i++) {
-    g[i] = grad[i];
-  }
+  fx = evaluateWithGradient(m_w, g);
   
   function_evals++;
   gradient_evals++;
 
+  // the objective at the start (not of a resumed run, which has it)
+  if (recordStart && !pastObjectives.empty()) {
+    pastObjectives[0] = fx;
+  }
+  recordStart = false;
+
   return (lbfgsfloatval_t) fx;
 }
 
@@ -148,15 +183,20 @@ int LBFGS::progress(
         )
 {
 
+  // (counted from the start of a resumed run)
+  k += previousIterations;
+
   // TODO: maybe change to cout
   printf("Iteration %d:\n", k);
   printf("  obj = %f, w[0] = %f, w[1] = %f ...\n", fx, x[0], x[1]);
   printf("  wnorm = %f, gnorm = %f, step = %f\n", xnorm, gnorm, step);
   printf("  function evaluations: %d\n  gradient evaluations: %d\n", function_evals, gradient_evals);
+  printf("  images per second: %.1f\n", objective->getImagesPerSecond());
   printf("\n"); 
 
   // update iterations class variable
   iterations = k;
+  recordTrace(getLearningTime(), fx);
 
   // store weights
   ofstream tempWeightFile(tempWeightsPath.c_str());
@@ -170,9 +210,41 @@ int LBFGS::progress(
   }
   
   tempWeightFile.close();
+
+  // stop criterion: (f' - f) / f < delta, where f' is the objective value of
+  // params.past iterations ago (as tested by libLBFGS, which only does so
+  // once it has made past iterations itself, i.e. not right after a resume)
+  bool converged = false;
+  int past = params.past;
+  if (past > 0) {
+    converged = past <= k && (pastObjectives[k % past] - fx) / fx < params.delta;
+    pastObjectives[k % past] = fx;
+  }
+
+  // checkpoint
+  if (!checkpointPath.empty()) {
+    Checkpoint checkpoint("LBFGS");
+    checkpoint.put(k);
+    checkpoint.put(function_evals);
+    checkpoint.put(gradient_evals);
+    checkpoint.putVector(Weights(x, x+n));
+    checkpoint.putVector(pastObjectives);
+    writeCheckpoint(checkpoint);
+  }
   
   fflush(stdout);
 
+  // stop early (x is the storage of m_w)
+  if (validate(m_w, k)) {
+    printf("Stopping early: the validation AUC has stopped improving\n");
+    return 1;
+  }
+
+  // (the same status as libLBFGS's own test, LBFGS_STOP)
+  if (converged) {
+    return LBFGS_STOP;
+  }
+
   return 0;
 }
 
@@ -17,6 +17,18 @@
 
 #include <string>
 #include <lbfgs.h>
+
+// the weights are used by libLBFGS in place, which needs double weights and
+// libLBFGS built without SSE (x would then have to come from lbfgs_malloc).
+// Only builds with the flags of this code are checked here, learnWeights
+// throws LBFGS_SSE_ERROR if the library was built with SSE on its own
+#if LBFGS_FLOAT != 64
+#error "LBFGS_FLOAT must be 64 (double weights)"
+#endif
+#if defined(USE_SSE) && defined(__SSE2__)
+#error "libLBFGS with SSE2 needs the weights in memory from lbfgs_malloc"
+#endif
+
 #include "GradientDescent.h"
 
 // LBFGS is a wrapper for the libLBFGS library
@@ -34,12 +46,25 @@ class LBFGS : public GradientDescent {
 
     int iterations;
 
+    // iterations done before resuming from a checkpoint
+    int previousIterations;
+
+    // objective values of the last params.past iterations (iteration k at
+    // k % past, the start of the first run at 0), kept in checkpoints so the
+    // stop test on them continues across a resume
+    Dvector pastObjectives;
+    bool recordStart;
+
     // string for temporary weights
     std::string tempWeightsPath;
 
   protected:
     
-    lbfgsfloatval_t *m_x;
+    // libLBFGS works on the weights in place (x is m_w.data(), see the checks
+    // above), so they are not copied to Weights before every evaluation. There
+    // are no span views of x and g: the objective functions take Weights, and
+    // only the gradient has a raw pointer overload (evaluateWithGradient)
+    Weights m_w;
     lbfgs_parameter_t params;
     
     // functions for evaluating objective function
@@ -99,8 +124,16 @@ class LBFGS : public GradientDescent {
     // path for storing temporary weights between iterations
     void setTempWeightsPath(std::string path);
     
+    // stop criterion ||g|| < epsilon * max(1, ||w||) (default 1e-3)
+    double getEpsilon();
+    void setEpsilon(double epsilon);
+
     // get number of iterations 
     int getIterations();
+
+    // objective and gradient evaluations of the last call to learnWeights
+    // (the line search may take more than one per iteration)
+    int getFunctionEvaluations();
   
     // redefine learnWeights function
     virtual Weights learnWeights(const Weights &w);
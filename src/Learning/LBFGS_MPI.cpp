@@ -24,7 +24,7 @@ using namespace std;
 
 // wrapper for using the libLBFGS C library
 // constructor
-LBFGS_MPI::LBFGS_MPI(ObjectiveFunction *obj, Gradient *grad) : GradientDescent(obj, grad), m_x(NULL) { 
+LBFGS_MPI::LBFGS_MPI(ObjectiveFunction *obj, Gradient *grad) : GradientDescent(obj, grad) { 
 
   // initialize L-BFGS parameters
   // use Wolfe conditions
@@ -45,12 +45,7 @@ LBFGS_MPI::LBFGS_MPI(ObjectiveFunction *obj, Gradient *grad) : GradientDescent(o
 }
 
 // deconstructor
-LBFGS_MPI::~LBFGS_MPI() { 
-  if (m_x != NULL) {
-    lbfgs_free(m_x);
-    m_x = NULL;
-  }
-}
+LBFGS_MPI::~LBFGS_MPI() { }
 
 // set path for storing temporary weights
 void LBFGS_MPI::setTempWeightsPath(string path) {
@@ -73,36 +68,33 @@ Weights LBFGS_MPI::learnWeights(const Weights &w) {
   lbfgsfloatval_t fx;
   
   n = w.size();
-  m_x = lbfgs_malloc(n);
-  Weights w_new(n);
 
   // reset function and gradient evaluation counts
   function_evals = 0;
   gradient_evals = 0;
 
   // initialize variables to the weight values
-  for (int i=0; i<n; i++) {
-    m_x[i] = w[i];
-  }
+  m_w = w;
   
   // call L-BFGS procedure
   printf("Running LBFGS procedure...\n");
-  ret = lbfgs(n, m_x, &fx, _evaluate, _progress, this, &params);
+  ret = lbfgs(n, &m_w[0], &fx, _evaluate, _progress, this, &params);
   
   printf("L-BFGS optimization terminated with status code = %d\n", ret);
-  
-  // convert result to Weights and return
-  for (int i=0; i<n; i++) {
-    w_new[i] = m_x[i];
+
+  // libLBFGS built with SSE rejects the weights before the first iteration
+  if (ret == LBFGSERR_INVALID_X_SSE || ret == LBFGSERR_INVALID_N_SSE) {
+    fprintf(stderr, "libLBFGS must be built without SSE (the weights are not from lbfgs_malloc)\n");
+    throw LBFGS_SSE_ERROR;
   }
   
-  return w_new;
+  return m_w;
 }
 
 
 
 // evaluate objective function and gradient
-// converts weight vectors back and forth to arrays which is time consuming!
+// x is the storage of m_w and the gradient is summed up in g in place
 lbfgsfloatval_t LBFGS_MPI::evaluate(
         const lbfgsfloatval_t *x,
         lbfgsfloatval_t *g,
@@ -111,21 +103,46 @@ lbfgsfloatval_t LBFGS_MPI::evaluate(
         )
 {
   
-  Weights w(n);
-  for (int i=0; i<n; i++) {
-    w[i] = x[i];
+  // (only copied if libLBFGS evaluates somewhere else)
+  if (x != &m_w[0]) {
+    m_w.assign(x, x+n);
   }
+  Weights &w = m_w;
   
-  // evaluate objective function
   double fx;
-  fx = objective->evaluate(w);
-  
-  // compute gradient
-  Dvector grad(w.size());
 
-  gradient->evaluate(grad, w);
+  if (fusedEvaluation) {
+
+    // every worker evaluates objective function and gradient on its share of the images
+    SearchIx searchIx = objective->getSearchIx();
+    objective->setSearchIx(workerSearchIx(searchIx));
+    double workerFx = objective->evaluateWithGradient(w, g);
+    objective->setSearchIx(searchIx);
+
+    MPI::COMM_WORLD.Allreduce(&workerFx, &fx, 1, MPI::DOUBLE, MPI::SUM);
+    MPI::COMM_WORLD.Allreduce(MPI::IN_PLACE, g, n, MPI::DOUBLE, MPI::SUM);
+
+    // the regularizer was added by every worker, so remove all but one
+    int worldSize = MPI::COMM_WORLD.Get_size();
+    double lambda = objective->getLambda();
+    double regularizer = 0.0;
+    for (int i=0; i<n; i++) {
+      regularizer += w[i]*w[i];
+      g[i] -= (worldSize-1)*2*lambda*w[i];
+    }
+    fx -= (worldSize-1)*lambda*regularizer;
+
+  } else {
+
+    // evaluate objective function
+    fx = objective->evaluate(w);
   
-  MPI::COMM_WORLD.Allreduce(&grad[0], g, w.size(), MPI::DOUBLE, MPI::SUM);
+    // compute gradient
+    gradientBuffer.resize(n);
+    gradient->evaluate(gradientBuffer, w);
+  
+    MPI::COMM_WORLD.Allreduce(&gradientBuffer[0], g, n, MPI::DOUBLE, MPI::SUM);
+  }
   
   function_evals++;
   gradient_evals++;
@@ -133,6 +150,37 @@ lbfgsfloatval_t LBFGS_MPI::evaluate(
   return (lbfgsfloatval_t) fx;
 }
 
+// images of the search index evaluated by this worker
+// images without objects are skipped and the rest is split evenly between workers
+SearchIx LBFGS_MPI::workerSearchIx(const SearchIx &searchIx) {
+
+  int id = MPI::COMM_WORLD.Get_rank();
+  int worldSize = MPI::COMM_WORLD.Get_size();
+
+  Bboxes &bboxes = objective->getDataManager()->getBboxes();
+  SearchIx nonEmptyIndices;
+  for (size_t i=0; i<searchIx.size(); i++) {
+    if (bboxes[searchIx[i]].numObject > 0) {
+      nonEmptyIndices.push_back(searchIx[i]);
+    }
+  }
+
+  int numImages, workerSize, theRest, start, stop;
+  numImages = nonEmptyIndices.size();
+
+  workerSize = numImages / worldSize;
+  theRest = numImages % worldSize;
+  if (id < theRest) {
+    start = id*(workerSize+1);
+    stop  = start + workerSize + 1;
+  } else {
+    start = id*workerSize + theRest;
+    stop = start + workerSize;
+  }
+
+  return SearchIx(nonEmptyIndices.begin()+start, nonEmptyIndices.begin()+stop);
+}
+
 // print progress after each iteration and store temporary weights
 int LBFGS_MPI::progress(
         const lbfgsfloatval_t *x,
@@ -155,6 +203,7 @@ int LBFGS_MPI::progress(
     printf("  obj = %f, w[0] = %f, w[1] = %f ...\n", fx, x[0], x[1]);
     printf("  wnorm = %f, gnorm = %f, step = %f\n", xnorm, gnorm, step);
     printf("  function evaluations: %d\n  gradient evaluations: %d\n", function_evals, gradient_evals);
+    printf("  images per second: %.1f\n", objective->getImagesPerSecond());
     printf("\n"); 
 
     // update iterations class variable
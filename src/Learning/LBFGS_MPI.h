@@ -17,6 +17,18 @@
 
 #include <string>
 #include <lbfgs.h>
+
+// the weights are used by libLBFGS in place, which needs double weights and
+// libLBFGS built without SSE (x would then have to come from lbfgs_malloc).
+// Only builds with the flags of this code are checked here, learnWeights
+// throws LBFGS_SSE_ERROR if the library was built with SSE on its own
+#if LBFGS_FLOAT != 64
+#error "LBFGS_FLOAT must be 64 (double weights)"
+#endif
+#if defined(USE_SSE) && defined(__SSE2__)
+#error "libLBFGS with SSE2 needs the weights in memory from lbfgs_malloc"
+#endif
+
 #include "mpi.h"
 #include "GradientDescent.h"
 
@@ -40,7 +52,11 @@ class LBFGS_MPI : public GradientDescent {
 
   protected:
     
-    lbfgsfloatval_t *m_x;
+    // libLBFGS works on the weights in place (x is m_w.data(), see the checks
+    // above), so they are not copied to Weights before every evaluation. There
+    // are no span views of x and g: the objective functions take Weights, and
+    // only the gradient has a raw pointer overload (evaluateWithGradient)
+    Weights m_w;
     lbfgs_parameter_t params;
     
     // functions for evaluating objective function
@@ -91,6 +107,9 @@ class LBFGS_MPI : public GradientDescent {
         int ls
         );
 
+    // images of the search index evaluated by this worker
+    SearchIx workerSearchIx(const SearchIx &searchIx);
+
   public:
     
     // constructor
@@ -0,0 +1,289 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include "NewtonCG.h"
+#include "Types.h"
+
+using namespace std;
+
+// dot product
+static double dot(const Dvector &a, const Dvector &b) {
+  double sum = 0.0;
+  for (size_t i=0; i<a.size(); i++) {
+    sum += a[i]*b[i];
+  }
+  return sum;
+}
+
+// constructor
+NewtonCG::NewtonCG(ObjectiveFunction *obj, Gradient *grad, HessianVectorProduct *hvp)
+  : GradientDescent(obj, grad), hessian(hvp) {
+
+  maxIterations = 100;
+  maxCGIterations = 50;
+
+  iterations = 0;
+  function_evals = 0;
+  hessian_evals = 0;
+
+  tempWeightsPath = "tempWeights.txt";
+}
+
+// getters/setters
+HessianVectorProduct *NewtonCG::getHessianVectorProduct() {
+  return hessian;
+}
+
+void NewtonCG::setHessianVectorProduct(HessianVectorProduct *hvp) {
+  hessian = hvp;
+}
+
+void NewtonCG::setMaxIterations(int its) {
+  maxIterations = its;
+}
+
+void NewtonCG::setMaxCGIterations(int its) {
+  maxCGIterations = its;
+}
+
+void NewtonCG::setTempWeightsPath(string path) {
+  tempWeightsPath = path;
+}
+
+int NewtonCG::getIterations() {
+  return iterations;
+}
+
+int NewtonCG::getFunctionEvaluations() {
+  return function_evals;
+}
+
+int NewtonCG::getHessianEvaluations() {
+  return hessian_evals;
+}
+
+
+// approximately solve H d = -g with conjugate gradients
+// CG is stopped when the residual is below min(0.5, sqrt(||g||))*||g|| (superlinear
+// convergence near the optimum) or when a direction of negative curvature is found
+int NewtonCG::solveNewtonStep(Dvector &d, Weights &w, const Dvector &g, double gnorm) {
+
+  int n = w.size();
+  double tolerance = min(0.5, sqrt(gnorm))*gnorm;
+  double alpha, beta, rr, rrNew, curvature;
+
+  Dvector r(n), p(n), Hp(n);
+
+  // start at d = 0, so the residual is -g
+  for (int i=0; i<n; i++) {
+    d[i] = 0.0;
+    r[i] = -g[i];
+    p[i] = r[i];
+  }
+  rr = dot(r, r);
+
+  int k;
+  for (k=0; k<maxCGIterations; k++) {
+    hessian->evaluate(Hp, w, p);
+    hessian_evals++;
+
+    curvature = dot(p, Hp);
+    if (curvature <= 0.0) {
+      // use the steepest descent direction if no CG step has been taken
+      if (k == 0) {
+        d = r;
+      }
+      break;
+    }
+
+    alpha = rr/curvature;
+    for (int i=0; i<n; i++) {
+      d[i] += alpha*p[i];
+      r[i] -= alpha*Hp[i];
+    }
+
+    rrNew = dot(r, r);
+    if (sqrt(rrNew) < tolerance) {
+      k++;
+      break;
+    }
+
+    beta = rrNew/rr;
+    for (int i=0; i<n; i++) {
+      p[i] = r[i] + beta*p[i];
+    }
+    rr = rrNew;
+  }
+
+  return k;
+}
+
+
+// learn weights using truncated Newton
+Weights NewtonCG::learnWeights(const Weights &w0) {
+
+  int n = w0.size();
+  Weights w(w0), wTrial(n);
+  Dvector g(n), gTrial(n), d(n);
+  double fx, fTrial, gnorm, wnorm, slope, step;
+  double fxPast;
+  int cgIterations;
+
+  // the Hessian uses the same regularizer as the objective
+  hessian->setLambda(objective->getLambda());
+
+  iterations = 0;
+  function_evals = 0;
+  hessian_evals = 0;
+
+  // or continue after the iteration of a checkpoint (the weights are the
+  // complete state of Newton-CG)
+  Checkpoint *state = takeResumeState("NewtonCG");
+  if (state != NULL) {
+    try {
+      state->get(iterations);
+      state->get(function_evals);
+      state->get(hessian_evals);
+      state->getVector(w);
+      if ((int) w.size() != n) {
+        throw CHECKPOINT_ERROR;
+      }
+    }
+    catch (int e) {
+      delete state;
+      throw;
+    }
+    delete state;
+    printf("Resuming after iteration %d\n", iterations);
+  }
+
+  printf("Running Newton-CG procedure...\n");
+  fflush(stdout);
+  startTrace();
+  startValidation();
+
+  fx = evaluateWithGradient(w, g);
+  function_evals++;
+
+  for (int k=iterations+1; k<=maxIterations; k++) {
+
+    // stop criterion: ||g|| < epsilon * max(1, ||w||) (as for LBFGS)
+    gnorm = sqrt(dot(g, g));
+    wnorm = sqrt(dot(w, w));
+    if (gnorm < 1e-3*max(1.0, wnorm)) {
+      break;
+    }
+
+    // Newton direction
+    cgIterations = solveNewtonStep(d, w, g, gnorm);
+
+    slope = dot(g, d);
+    if (slope >= 0.0) {
+      // not a descent direction (can happen because of round-off)
+      for (int i=0; i<n; i++) {
+        d[i] = -g[i];
+      }
+      slope = -gnorm*gnorm;
+    }
+
+    // backtracking line search (Armijo condition), the full Newton step is tried first
+    // (the gradient is computed together with the objective, which costs about
+    // the same, and kept for the accepted step, which is usually the first)
+    step = 1.0;
+    while (true) {
+      for (int i=0; i<n; i++) {
+        wTrial[i] = w[i] + step*d[i];
+      }
+      fTrial = evaluateWithGradient(wTrial, gTrial);
+      function_evals++;
+
+      if (fTrial <= fx + 1e-4*step*slope) {
+        break;
+      }
+      step *= 0.5;
+      if (step < 1e-20) {
+        throw ROUNDOFF_ERROR;
+      }
+    }
+
+    fxPast = fx;
+    fx = fTrial;
+    w.swap(wTrial);
+    g.swap(gTrial);
+    iterations = k;
+    recordTrace(getLearningTime(), fx);
+
+    progress(w, fx, sqrt(dot(w, w)), sqrt(dot(g, g)), step, cgIterations);
+
+    // checkpoint
+    if (!checkpointPath.empty()) {
+      Checkpoint checkpoint("NewtonCG");
+      checkpoint.put(iterations);
+      checkpoint.put(function_evals);
+      checkpoint.put(hessian_evals);
+      checkpoint.putVector(w);
+      writeCheckpoint(checkpoint);
+    }
+
+    // stop early
+    if (validate(w, k)) {
+      printf("Stopping early: the validation AUC has stopped improving\n");
+      break;
+    }
+
+    // stop criterion: (f' - f) / f < delta
+    if (fabs(fxPast - fx) / max(1.0, fabs(fx)) < 1e-6) {
+      break;
+    }
+  }
+
+  printf("Newton-CG optimization terminated after %d iterations\n", iterations);
+  finishCheckpoints();
+  finishValidation(w);
+
+  return w;
+}
+
+
+// print progress after each iteration and store temporary weights
+void NewtonCG::progress(const Weights &w, double fx, double wnorm, double gnorm, double step, int cgIterations) {
+
+  printf("Iteration %d:\n", iterations);
+  printf("  obj = %f, w[0] = %f, w[1] = %f ...\n", fx, w[0], w[1]);
+  printf("  wnorm = %f, gnorm = %f, step = %f\n", wnorm, gnorm, step);
+  printf("  CG iterations: %d\n", cgIterations);
+  printf("  function evaluations: %d\n  Hessian-vector products: %d\n", function_evals, hessian_evals);
+  printf("  images per second: %.1f\n", objective->getImagesPerSecond());
+  printf("\n");
+
+  // store weights
+  ofstream tempWeightFile(tempWeightsPath.c_str());
+  if (!tempWeightFile) {
+    cerr << "Could not open file " << tempWeightsPath << endl;
+  }
+
+  for (size_t i=0; i<w.size(); i++) {
+    tempWeightFile << w[i] << "\n";
+  }
+
+  tempWeightFile.close();
+
+  fflush(stdout);
+}
@@ -0,0 +1,76 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _NEWTON_CG_H_
+#define _NEWTON_CG_H_
+
+#include <string>
+#include "GradientDescent.h"
+#include "ObjectiveFunctions/HessianVectorProduct.h"
+
+// truncated Newton (Newton-CG) learning
+// the Newton step H d = -g is solved approximately with conjugate gradients,
+// using only Hessian-vector products, and followed by a backtracking line search.
+// The stopping criteria are the same as for LBFGS
+class NewtonCG : public GradientDescent {
+
+  private:
+
+    // Hessian-vector product
+    HessianVectorProduct *hessian;
+
+    int maxIterations;
+    int maxCGIterations;
+
+    // statistics
+    int iterations;
+    int function_evals;
+    int hessian_evals;
+
+    // string for temporary weights
+    std::string tempWeightsPath;
+
+    // approximately solve H d = -g with conjugate gradients
+    // (returns the number of CG iterations)
+    int solveNewtonStep(Dvector &d, Weights &w, const Dvector &g, double gnorm);
+
+    // print progress and store temporary weights
+    void progress(const Weights &w, double fx, double wnorm, double gnorm, double step, int cgIterations);
+
+  public:
+
+    // constructor
+    NewtonCG(ObjectiveFunction *obj, Gradient *grad, HessianVectorProduct *hvp);
+
+    // getters/setters
+    HessianVectorProduct *getHessianVectorProduct();
+    void setHessianVectorProduct(HessianVectorProduct *hvp);
+
+    void setMaxIterations(int iterations);
+    void setMaxCGIterations(int iterations);
+
+    // path for storing temporary weights between iterations
+    void setTempWeightsPath(std::string path);
+
+    // get number of iterations, objective evaluations and Hessian-vector products
+    int getIterations();
+    int getFunctionEvaluations();
+    int getHessianEvaluations();
+
+    // redefine learnWeights function
+    virtual Weights learnWeights(const Weights &w);
+
+};
+
+#endif // _NEWTON_CG_H_
@@ -0,0 +1,228 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "ProgressEvaluator.h"
+
+using namespace std;
+
+
+// constructor (starts the thread in the background)
+ProgressEvaluator::ProgressEvaluator(ObjectiveFunction *obj, string tempWeightsPath_, bool background_, int sampleSize, bool gradientNorm_) :
+  objective(obj),
+  tempWeightsPath(tempWeightsPath_),
+  background(background_),
+  gradientNorm(gradientNorm_),
+  busy(false),
+  stop(false)
+{
+  DataManager *dataManager = objective->getDataManager();
+  Bboxes &bboxes = dataManager->getBboxes();
+
+  // images with objects (a fixed random subset of them)
+  SearchIx searchIx = objective->getSearchIx();
+  for (size_t j=0; j<searchIx.size(); j++) {
+    if (bboxes[searchIx[j]].numObject > 0) {
+      images.push_back(searchIx[j]);
+    }
+  }
+  numImages = images.size();
+  if (sampleSize > 0 && sampleSize < numImages) {
+    random_shuffle(images.begin(), images.end());
+    images.resize(sampleSize);
+    sort(images.begin(), images.end());
+  }
+
+  // the ground truth features are computed on first use, so not by the thread
+  workspace = objective->getCRF()->clone();
+  if (!images.empty()) {
+    dataManager->getGroundTruthFeatures(images[0], workspace->getStepSize());
+  }
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&queueCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  if (background) {
+    pthread_create(&thread, NULL, worker, this);
+  }
+}
+
+// destructor (evaluates the remaining snapshots and joins the thread)
+ProgressEvaluator::~ProgressEvaluator() {
+  if (background) {
+    pthread_mutex_lock(&mutex);
+    stop = true;
+    pthread_cond_signal(&queueCond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+  }
+
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&queueCond);
+  pthread_mutex_destroy(&mutex);
+  delete workspace;
+}
+
+bool ProgressEvaluator::isBackground() {
+  return background;
+}
+
+int ProgressEvaluator::getNumImages() {
+  return images.size();
+}
+
+const Dvector &ProgressEvaluator::getTimes() {
+  return times;
+}
+
+const Dvector &ProgressEvaluator::getObjectives() {
+  return objectives;
+}
+
+
+// queue (or evaluate) a snapshot of the weights
+void ProgressEvaluator::submit(const Weights &w, int epoch, int t, double eta, bool averaged, double time) {
+
+  Snapshot snapshot;
+  snapshot.w = w;
+  snapshot.epoch = epoch;
+  snapshot.t = t;
+  snapshot.eta = eta;
+  snapshot.averaged = averaged;
+  snapshot.time = time;
+
+  if (!background) {
+    evaluate(snapshot);
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  queue.push_back(snapshot);
+  pthread_cond_signal(&queueCond);
+  pthread_mutex_unlock(&mutex);
+}
+
+// wait until the queue is empty and the thread idle
+void ProgressEvaluator::finish() {
+  if (!background) {
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  while (!queue.empty() || busy) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+
+// evaluate objective function (and norm of its gradient), print them and store the weights
+void ProgressEvaluator::evaluate(Snapshot &snapshot) {
+
+  Dvector grad;
+  double fval;
+  ostringstream os;
+  try {
+    if (gradientNorm) {
+      grad.resize(snapshot.w.size());
+      fval = objective->evaluateSubset(workspace, snapshot.w, grad, images);
+    } else {
+      fval = objective->evaluateSubset(workspace, snapshot.w, images);
+    }
+  }
+  catch (int e) {
+    if (!background) {
+      throw;
+    }
+    os << "Epoch " << snapshot.epoch << ": progress evaluation threw exception " << e << endl << endl;
+    cout << os.str() << flush;
+    return;
+  }
+  double gnorm = 0.0;
+  for (size_t i=0; i<grad.size(); i++) {
+    gnorm += grad[i]*grad[i];
+  }
+  gnorm = sqrt(gnorm);
+
+  // print as one block, the learner may print at the same time
+  os << "Epoch:      " << snapshot.epoch << endl;
+  os << "Iterations: " << snapshot.t << endl;
+  os << "eta:        " << snapshot.eta << endl;
+  os << (snapshot.averaged ? "fvalAvg:    " : "fval:       ") << fval;
+  if ((int) images.size() < numImages) {
+    os << " (estimated from " << images.size() << " of " << numImages << " images)";
+  }
+  os << endl;
+  if (gradientNorm) {
+    os << "gnorm:      " << gnorm << endl;
+  }
+  os << endl;
+  cout << os.str() << flush;
+
+  times.push_back(snapshot.time);
+  objectives.push_back(fval);
+
+  // store weights
+  ofstream tempWeightFile(tempWeightsPath.c_str());
+  if (!tempWeightFile) {
+    cerr << "Could not open file " << tempWeightsPath << endl;
+  }
+  for (size_t i=0; i<snapshot.w.size(); i++) {
+    tempWeightFile << snapshot.w[i] << "\n";
+  }
+  tempWeightFile.close();
+}
+
+
+// main loop of the thread
+void *ProgressEvaluator::worker(void *arg) {
+  ((ProgressEvaluator *) arg)->work();
+  return NULL;
+}
+
+void ProgressEvaluator::work() {
+
+  Snapshot snapshot;
+
+  pthread_mutex_lock(&mutex);
+  while (true) {
+
+    // wait for a snapshot (the remaining ones are evaluated before stopping)
+    while (!stop && queue.empty()) {
+      pthread_cond_wait(&queueCond, &mutex);
+    }
+    if (queue.empty()) {
+      break;
+    }
+    snapshot = queue.front();
+    queue.pop_front();
+    busy = true;
+    pthread_mutex_unlock(&mutex);
+
+    evaluate(snapshot);
+
+    pthread_mutex_lock(&mutex);
+    busy = false;
+    if (queue.empty()) {
+      pthread_cond_broadcast(&doneCond);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,102 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _PROGRESS_EVALUATOR_H_
+#define _PROGRESS_EVALUATOR_H_
+
+#include <deque>
+#include <string>
+#include <pthread.h>
+
+#include "ObjectiveFunctions/ObjectiveFunction.h"
+#include "Types.h"
+
+// evaluates the objective function at snapshots of the weights taken by a
+// learner after every epoch, prints them and stores the weights. In the
+// background the snapshots are queued and evaluated by a thread with its own
+// copy of the CRF, so the learner never waits for them. The objective can be
+// estimated from a fixed random subset of the images (see evaluateSubset)
+class ProgressEvaluator {
+
+  private:
+
+    // snapshot of the learner
+    struct Snapshot {
+      Weights w;
+      int epoch;
+      int t;
+      double eta;
+      bool averaged;
+      double time;
+    };
+
+    ObjectiveFunction *objective;
+    ConditionalRandomField *workspace;
+    SearchIx images;              // images the objective is evaluated on
+    int numImages;                // number of images with objects in the search index
+    std::string tempWeightsPath;
+    bool background;
+    bool gradientNorm;            // also compute the norm of the gradient
+
+    // snapshots waiting for the thread
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t queueCond;     // signalled when a snapshot is queued or the thread stops
+    pthread_cond_t doneCond;      // signalled when the queue is empty and the thread idle
+    std::deque<Snapshot> queue;
+    bool busy;
+    bool stop;
+
+    // learning time of the snapshots and their objective values
+    Dvector times;
+    Dvector objectives;
+
+    // evaluate, print and store a snapshot
+    void evaluate(Snapshot &snapshot);
+
+    // main loop of the thread
+    static void *worker(void *arg);
+    void work();
+
+    // not copyable (owns the thread and the CRF)
+    ProgressEvaluator(const ProgressEvaluator &);
+    ProgressEvaluator &operator=(const ProgressEvaluator &);
+
+  public:
+
+    // constructor and destructor (the destructor evaluates the remaining
+    // snapshots). sampleSize images with objects are drawn at random from the
+    // search index of the objective (0 uses all images). The norm of the
+    // gradient is only printed when asked for, since it costs a gradient
+    // evaluation on top of the objective
+    ProgressEvaluator(ObjectiveFunction *objective, std::string tempWeightsPath, bool background, int sampleSize = 0, bool gradientNorm = false);
+    ~ProgressEvaluator();
+
+    bool isBackground();
+    int getNumImages();
+
+    // evaluate the objective function at a copy of w, taken at the given
+    // learning time (right away unless in the background)
+    void submit(const Weights &w, int epoch, int t, double eta, bool averaged, double time);
+
+    // wait until all snapshots have been evaluated
+    void finish();
+
+    // learning times and objective values of the evaluated snapshots
+    const Dvector &getTimes();
+    const Dvector &getObjectives();
+
+};
+
+#endif // _PROGRESS_EVALUATOR_H_
@@ -0,0 +1,96 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+
+#include "Types.h"
+#include "SAGA.h"
+
+using namespace std;
+
+// constructor
+SAGA::SAGA(ObjectiveFunction *obj, Gradient *grad, StochasticGradient *sgrad) :
+  VarianceReducedGradientDescent(obj, grad, sgrad) { }
+
+
+// learn weights with SAGA
+Weights SAGA::learnWeights(const Weights &w0) {
+
+  int weightDim = w0.size();
+  Weights w(w0);
+  Dvector fullGradient(weightDim);
+  SparseVector grad;
+  double fval, elapsed;
+
+  indices = objective->getNonEmpty();
+  int m = indices.size();
+
+  // seed random number generator used in shuffling the dataset
+  srand((unsigned)time(NULL)); rand();
+  startTrace();
+  epoch = 0;
+
+  // initialize the stored gradients at w0 (one pass over the images)
+  storedGradients.assign(m, SparseVector());
+  averageGradient.assign(weightDim, 0.0);
+  for (int i=0; i<m; i++) {
+    stochasticGradient->evaluateSparse(storedGradients[i], w, 1.0, indices[i]);
+    for (size_t k=0; k<storedGradients[i].index.size(); k++) {
+      averageGradient[storedGradients[i].index[k]] += storedGradients[i].value[k]/m;
+    }
+  }
+
+  // visit the images in random order (order is the position in storedGradients)
+  Ivector order(m);
+  for (int i=0; i<m; i++) {
+    order[i] = i;
+  }
+
+  while (true) {
+
+    // objective and gradient only for the progress report (not counted as learning time)
+    elapsed = getLearningTime();
+    fval = evaluateWithGradient(w, fullGradient);
+    recordTrace(elapsed, fval);
+    if (progress(w, fval, fullGradient) || epoch == maxEpochs) {
+      break;
+    }
+    epoch++;
+
+    random_shuffle(order.begin(), order.end());
+    for (int j=0; j<m; j++) {
+      int i = order[j];
+      SparseVector &stored = storedGradients[i];
+
+      // grad f_i(w) - stored_i (same visual words)
+      stochasticGradient->evaluateSparse(grad, w, 1.0, indices[i]);
+      for (size_t k=0; k<grad.value.size(); k++) {
+        double delta = grad.value[k] - stored.value[k];
+        stored.value[k] = grad.value[k];
+        grad.value[k] = delta;
+      }
+
+      // step with the average before this update
+      step(w, averageGradient, grad);
+
+      for (size_t k=0; k<grad.index.size(); k++) {
+        averageGradient[grad.index[k]] += grad.value[k]/m;
+      }
+    }
+  }
+
+  return w;
+}
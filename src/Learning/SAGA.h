@@ -0,0 +1,44 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _SAGA_H_
+#define _SAGA_H_
+
+#include <vector>
+#include "VarianceReducedGradientDescent.h"
+
+// SAGA (Defazio, Bach and Lacoste-Julien, 2014)
+// the last gradient of every image is stored (sparse, over the visual words
+// of the image) together with their average, and each step uses
+//   grad F_i(w) - stored_i + average
+// which takes one per image gradient, but memory for all of them
+class SAGA : public VarianceReducedGradientDescent {
+
+  private:
+
+    // stored per image gradients (without the regularizer) and their average
+    std::vector<SparseVector> storedGradients;
+    Dvector averageGradient;
+
+  public:
+
+    // constructor
+    SAGA(ObjectiveFunction *obj, Gradient *grad, StochasticGradient *sgrad);
+
+    // redefine learnWeights function
+    virtual Weights learnWeights(const Weights &w);
+
+};
+
+#endif // _SAGA_H_
@@ -0,0 +1,78 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+
+#include "Types.h"
+#include "SVRG.h"
+
+using namespace std;
+
+// constructor
+SVRG::SVRG(ObjectiveFunction *obj, Gradient *grad, StochasticGradient *sgrad) :
+  VarianceReducedGradientDescent(obj, grad, sgrad) { }
+
+
+// learn weights with SVRG
+Weights SVRG::learnWeights(const Weights &w0) {
+
+  int weightDim = w0.size();
+  Weights w(w0), snapshot(weightDim);
+  Dvector fullGradient(weightDim), dense(weightDim);
+  SparseVector grad, snapshotGrad;
+  double fval;
+
+  double lambda = objective->getLambda();
+  indices = objective->getNonEmpty();
+  int m = indices.size();
+
+  // seed random number generator used in shuffling the dataset
+  srand((unsigned)time(NULL)); rand();
+  startTrace();
+  epoch = 0;
+
+  while (true) {
+
+    // full gradient at the snapshot (also reported as progress)
+    snapshot = w;
+    fval = evaluateWithGradient(snapshot, fullGradient);
+    recordTrace(getLearningTime(), fval);
+    if (progress(snapshot, fval, fullGradient) || epoch == maxEpochs) {
+      break;
+    }
+    epoch++;
+
+    // constant part of the steps: (grad F(w~) - 2*lambda*w~)/m
+    for (int i=0; i<weightDim; i++) {
+      dense[i] = (fullGradient[i] - 2*lambda*snapshot[i])/m;
+    }
+
+    random_shuffle(indices.begin(), indices.end());
+    for (int i=0; i<m; i++) {
+
+      // grad f_i(w) - grad f_i(w~) (both over the visual words of the image)
+      stochasticGradient->evaluateSparse(grad, w, 1.0, indices[i]);
+      stochasticGradient->evaluateSparse(snapshotGrad, snapshot, 1.0, indices[i]);
+      for (size_t k=0; k<grad.value.size(); k++) {
+        grad.value[k] -= snapshotGrad.value[k];
+      }
+
+      step(w, dense, grad);
+    }
+  }
+
+  return w;
+}
@@ -0,0 +1,38 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _SVRG_H_
+#define _SVRG_H_
+
+#include "VarianceReducedGradientDescent.h"
+
+// stochastic variance reduced gradient (Johnson and Zhang, 2013)
+// every epoch starts with the full gradient at a snapshot w~ (computed with
+// the gradient of the learner, which also gives the progress report), and
+// each step uses
+//   grad F_i(w) - grad F_i(w~) + grad F(w~)/m
+// which takes two per image gradients
+class SVRG : public VarianceReducedGradientDescent {
+
+  public:
+
+    // constructor
+    SVRG(ObjectiveFunction *obj, Gradient *grad, StochasticGradient *sgrad);
+
+    // redefine learnWeights function
+    virtual Weights learnWeights(const Weights &w);
+
+};
+
+#endif // _SVRG_H_
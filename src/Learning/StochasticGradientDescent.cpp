@@ -18,6 +18,7 @@
 
 #include "Types.h"
 #include "StochasticGradientDescent.h"
+#include "Parallel/ThreadPool.h"
 
 using namespace std;
 
@@ -32,9 +33,20 @@ StochasticGradientDescent::StochasticGradientDescent(ObjectiveFunction *obj, Sto
   alpha(0.), 
   t0(0.), 
   maxEpochs(50), 
+  averageStartEpoch(0),
+  averageStartIteration(0),
   epoch(0), 
   t(0),
-  tempWeightsPath("tempWeightsSGD.txt") { }
+  epochsRun(0),
+  tempWeightsPath("tempWeightsSGD.txt"),
+  numThreads(1),
+  batchSize(1),
+  numTrialThreads(getNumProcessors()),
+  shuffleSeed(0),
+  backgroundProgress(false),
+  progressSampleSize(0),
+  progressGradientNorm(false),
+  progressEvaluator(NULL) { }
 
 StochasticGradientDescent::StochasticGradientDescent(ObjectiveFunction *obj, StochasticGradient *grad, double alpha_, double t0_, bool constLearningRate_) : 
   GradientDescent(obj, grad), 
@@ -43,9 +55,25 @@ StochasticGradientDescent::StochasticGradientDescent(ObjectiveFunction *obj, Sto
   alpha(alpha_), 
   t0(t0_), 
   maxEpochs(50),
+  averageStartEpoch(0),
+  averageStartIteration(0),
   epoch(0), 
   t(0),
-  tempWeightsPath("tempWeightsSGD.txt") { }
+  epochsRun(0),
+  tempWeightsPath("tempWeightsSGD.txt"),
+  numThreads(1),
+  batchSize(1),
+  numTrialThreads(getNumProcessors()),
+  shuffleSeed(0),
+  backgroundProgress(false),
+  progressSampleSize(0),
+  progressGradientNorm(false),
+  progressEvaluator(NULL) { }
+
+// destructor
+StochasticGradientDescent::~StochasticGradientDescent() {
+  delete progressEvaluator;
+}
 
 // getters and setters
 double StochasticGradientDescent::getAlpha() {
@@ -64,39 +92,313 @@ void StochasticGradientDescent::setT0(double t0_) {
   t0 = t0_;
 }
 
+int StochasticGradientDescent::getMaxEpochs() {
+  return maxEpochs;
+}
+
 void StochasticGradientDescent::setMaxEpochs(int maxEpochs_) {
   maxEpochs = maxEpochs_;
 }
 
+int StochasticGradientDescent::getEpochs() {
+  return epochsRun;
+}
+
+// start averaging at an epoch (0 means the last epoch)
+void StochasticGradientDescent::setAverageStartEpoch(int epoch_) {
+  averageStartEpoch = epoch_;
+  averageStartIteration = 0;
+}
+
+// start averaging at an iteration (takes precedence over the epoch)
+void StochasticGradientDescent::setAverageStartIteration(int iteration) {
+  averageStartIteration = iteration;
+}
+
 // set path for storing temporary weights
 void StochasticGradientDescent::setTempWeightsPath(string path) {
   tempWeightsPath = path;
 }
 
+int StochasticGradientDescent::getNumThreads() {
+  return numThreads;
+}
+
+void StochasticGradientDescent::setNumThreads(int n) {
+  numThreads = n > 0 ? n : 1;
+}
+
+int StochasticGradientDescent::getBatchSize() {
+  return batchSize;
+}
+
+void StochasticGradientDescent::setBatchSize(int n) {
+  batchSize = n > 0 ? n : 1;
+}
+
+int StochasticGradientDescent::getNumTrialThreads() {
+  return numTrialThreads;
+}
+
+void StochasticGradientDescent::setNumTrialThreads(int n) {
+  numTrialThreads = n > 0 ? n : 1;
+}
+
+unsigned StochasticGradientDescent::getSeed() {
+  return shuffleSeed;
+}
+
+void StochasticGradientDescent::setSeed(unsigned seed_) {
+  shuffleSeed = seed_;
+}
+
+void StochasticGradientDescent::setBackgroundProgress(bool background) {
+  backgroundProgress = background;
+}
+
+void StochasticGradientDescent::setProgressSampleSize(int sampleSize) {
+  progressSampleSize = sampleSize;
+}
+
+void StochasticGradientDescent::setProgressGradientNorm(bool gradientNorm) {
+  progressGradientNorm = gradientNorm;
+}
+
+// take a step on the scaled weights w = scale*v
+void StochasticGradientDescent::scaledStep(Weights &v, double &scale, const SparseVector &grad, double eta, double lambda, bool average) {
+
+  // regularizer: w = (1 - 2*eta*lambda)*w
+  // (fold the scale into v before it underflows, the average must then
+  // no longer depend on v)
+  double decay = 1.0 - 2*eta*lambda;
+  if (decay <= 0.0 || scale*decay < 1e-9) {
+    for (size_t i=0; i<v.size(); i++) {
+      if (average) {
+        avgA[i] += avgBeta/avgAlpha*v[i];
+      }
+      v[i] *= scale*decay;
+    }
+    avgBeta = 0.0;
+    scale = 1.0;
+  } else {
+    scale *= decay;
+  }
+
+  // w = w - eta*gradient (only the visual words of the image)
+  double delta;
+  for (size_t k=0; k<grad.index.size(); k++) {
+    delta = eta*grad.value[k]/scale;
+    v[grad.index[k]] -= delta;
+    if (average) {
+      avgA[grad.index[k]] += avgBeta/avgAlpha*delta;
+    }
+  }
+}
+
+// add w = scale*v to the average
+// a = (1-mu)*a + mu*w only changes the coefficients of the lazy average
+void StochasticGradientDescent::updateAverage(const Weights &v, double scale) {
+
+  // the first average is w itself
+  if (avgCount == 0) {
+    avgA.assign(v.size(), 0.0);
+    avgAlpha = 1.0;
+    avgBeta = scale;
+    avgCount = 1;
+    return;
+  }
+
+  avgCount++;
+  double mu = 1.0/avgCount;
+  avgAlpha *= 1.0 - mu;
+  avgBeta = (1.0 - mu)*avgBeta + mu*scale;
+
+  // fold avgAlpha into avgA before it underflows
+  if (avgAlpha < 1e-9) {
+    for (size_t i=0; i<v.size(); i++) {
+      avgA[i] = avgAlpha*avgA[i] + avgBeta*v[i];
+    }
+    avgAlpha = 1.0;
+    avgBeta = 0.0;
+  }
+}
+
+// wAvg = avgAlpha*avgA + avgBeta*v
+void StochasticGradientDescent::averagedWeights(Weights &wAvg, const Weights &v) {
+  wAvg.resize(v.size());
+  for (size_t i=0; i<v.size(); i++) {
+    wAvg[i] = avgAlpha*avgA[i] + avgBeta*v[i];
+  }
+}
+
+// w = scale*v
+void StochasticGradientDescent::unscale(Weights &w, const Weights &v, double scale) {
+  w.resize(v.size());
+  for (size_t i=0; i<v.size(); i++) {
+    w[i] = scale*v[i];
+  }
+}
+
+// learning rate
+// eta(t) = 1/(alpha*(t+t0)) or 1/(alpha*t0) (at most 1)
+double StochasticGradientDescent::learningRate(int iteration) {
+  if (constLearningRate) {
+    return min(1.0/(alpha*t0), 1.0);
+  }
+  return min(1.0/(alpha*(iteration+t0)), 1.0);
+}
+
+// SGD steps along the gradient
+void StochasticGradientDescent::direction(SparseVector &grad) { }
+
+// the step of a mini-batch is the sum of the steps of its images
+double StochasticGradientDescent::batchScale(int n) {
+  return n;
+}
+
+// SGD has no state besides the weights
+void StochasticGradientDescent::initializeState(int weightDim) { }
+
+void StochasticGradientDescent::saveState(Checkpoint &checkpoint) { }
+
+void StochasticGradientDescent::loadState(Checkpoint &checkpoint) { }
+
+// SGD steps only depend on the gradient
+bool StochasticGradientDescent::lockFreeSteps() {
+  return true;
+}
+
+// SGD trials only share the weights they start from
+bool StochasticGradientDescent::independentTrials() {
+  return true;
+}
+
 // try eta on sample from the training set using unnormalized objective
 // run one epoch on subset and return resulting function value
 double StochasticGradientDescent::tryEta(Weights &w, double eta, SearchIx &subset, bool normalized) {
+  return tryEta(gradient, NULL, w, eta, subset, normalized);
+}
+
+// (the objective function is evaluated with its own CRF without a workspace)
+double StochasticGradientDescent::tryEta(StochasticGradient *grad, ConditionalRandomField *workspace, Weights &w,
+                                         double eta, SearchIx &subset, bool normalized) {
   
-  Dvector grad(w.size(), 0.0);
+  SparseVector sparse;
+  Weights v(w);
+  double scale = 1.0;
+  double lambda = grad->getLambda();
 
   for (size_t i=0; i<subset.size(); i++) {
       
-    gradient->evaluate(grad, w, i, normalized);
+    grad->evaluateSparse(sparse, v, scale, subset[i], normalized);
    
     // update weights
     // w = w + eta*d = w - eta*gradient
-    for (size_t j=0; j<w.size(); j++) {    
-      w[j] = w[j] - eta*grad[j];
-    }
+    scaledStep(v, scale, sparse, eta, lambda);
   
   }
-  return objective->evaluate(w, normalized);
+  unscale(w, v, scale);
+
+  if (workspace == NULL) {
+    return objective->evaluate(w, normalized);
+  }
+  Dvector fgrad(w.size());
+  return objective->evaluateSubset(workspace, w, fgrad, objective->getSearchIx(), normalized);
+}
+
+
+// a learning rate trial on each job (the index of the learning rate)
+class StochasticGradientDescent::TrialTask : public ParallelTask {
+
+  public:
+
+    StochasticGradientDescent *sgd;
+    const Weights *w;
+    const Dvector *etas;
+    SearchIx *subset;
+    bool normalized;
+    Dvector fvals;
+
+    // workspace of each thread
+    std::vector<ConditionalRandomField *> crfs;
+    std::vector<StochasticGradient *> gradients;
+
+    void run(int job, int thread) {
+      Weights wNew(*w);
+      fvals[job] = sgd->tryEta(gradients[thread], crfs[thread], wNew, (*etas)[job], *subset, normalized);
+    }
+};
+
+// try the learning rates (in parallel)
+void StochasticGradientDescent::tryEtas(const Weights &w, const Dvector &etas, SearchIx &subset, bool normalized, Dvector &fvals) {
+
+  int numTrials = etas.size();
+  int threads = independentTrials() ? min(numTrialThreads, numTrials) : 1;
+  fvals.assign(numTrials, 0.0);
+
+  // tryEta changes w, so use new vector
+  if (threads <= 1) {
+    Weights wNew(w.size());
+    for (int k=0; k<numTrials; k++) {
+      wNew = w;
+      fvals[k] = tryEta(wNew, etas[k], subset, normalized);
+    }
+    return;
+  }
+
+  // every thread uses a copy of the CRF and of the gradient (and its sampler)
+  ConditionalRandomField *crf = gradient->getCRF();
+  TrialTask task;
+  task.sgd = this;
+  task.w = &w;
+  task.etas = &etas;
+  task.subset = &subset;
+  task.normalized = normalized;
+  task.fvals.assign(numTrials, 0.0);
+  task.crfs.resize(threads);
+  task.gradients.resize(threads);
+  for (int i=0; i<threads; i++) {
+    task.crfs[i] = crf->clone();
+    task.gradients[i] = gradient->clone(task.crfs[i]);
+  }
+
+  // the ground truth features are computed on first use, so not by the threads
+  if (!subset.empty()) {
+    objective->getDataManager()->getGroundTruthFeatures(subset[0], crf->getStepSize());
+  }
+
+  Ivector jobs(numTrials);
+  for (int k=0; k<numTrials; k++) {
+    jobs[k] = k;
+  }
+
+  int error = 0;
+  ThreadPool threadPool(threads);
+  try {
+    threadPool.run(task, jobs);
+  }
+  catch (int e) {
+    error = e;
+  }
+
+  for (int i=0; i<threads; i++) {
+    delete task.gradients[i];
+    delete task.crfs[i];
+  }
+  if (error != 0) {
+    throw error;
+  }
+
+  fvals = task.fvals;
 }
 
 
 // initialization of learning rate parameters
 // run a number of different parameters on the normalized or unnormalized objective and choose
 // those with best decrease
+// the learning rates are tried in rounds of numTrialThreads at a time: the next
+// ones are known unless a trial fails while increasing eta, so the rest of the
+// round is discarded then and the choice is the same as trying them one by one
 void StochasticGradientDescent::initializeLearningRate(Weights &w, double initialEta, int subsetSize, bool normalized) {
 
   const double factor = 10.0; //2.0;
@@ -136,8 +438,16 @@ void StochasticGradientDescent::initializeLearningRate(Weights &w, double initia
   }
   
   // compute initial fval
+  // (the initial eta is tried in the first round)
   initialFval = objective->evaluate(w, normalized);
-  bestFval = tryEta(w, initialEta, subset, normalized);
+  Dvector etas, fvals;
+  etas.push_back(initialEta);
+  for (int k=1; k<numTrialThreads && k<=tries; k++) {
+    etas.push_back(etas.back()*factor);
+  }
+  tryEtas(w, etas, subset, normalized, fvals);
+
+  bestFval = fvals[0];
   bestEta = eta = initialEta;
   
   if (isnan(bestFval)) {
@@ -148,24 +458,29 @@ void StochasticGradientDescent::initializeLearningRate(Weights &w, double initia
 
   // run through different set of parameters and choose one that minimizes fval most
   // run minimum 10 tries
-  Weights wNew(w.size()); 
   int i = 0;
   bool tryincrease = true;
+  size_t next = 1;
   while (i < tries) {
+
+    // next round of learning rates
+    if (next == etas.size()) {
+      etas.clear();
+      for (int k=0; k<numTrialThreads && i+k<tries; k++) {
+        etas.push_back(tryincrease ? eta*pow(factor, k+1) : eta/pow(factor, k+1));
+      }
+      tryEtas(w, etas, subset, normalized, fvals);
+      next = 0;
+    }
       
     i++;
     cout << "Try " << i <<  " of minimum " << tries << endl;    
 
     // first try increasing eta
-    if (tryincrease)     
-      eta *= factor;
-    else
-      eta /= factor;
-    
-    // tryEta changes w, so use new vector
-    wNew = w;
+    eta = etas[next];
+    fval = fvals[next];
+    next++;
 
-    fval = tryEta(wNew, eta, subset, normalized);
     cout << "testing: eta = " << eta << ", t0 = " << 1/(alpha*eta) << ", alpha = " << alpha << ", fval = " << fval << endl;
     if (!isnan(fval) && fval < initialFval) {  // must decrease original fval
       if (fval < bestFval) {
@@ -175,6 +490,7 @@ void StochasticGradientDescent::initializeLearningRate(Weights &w, double initia
     } else if (tryincrease) {
         eta = initialEta;
         tryincrease = false;
+        next = etas.size();
     }
 
   }
@@ -192,83 +508,512 @@ void StochasticGradientDescent::initializeLearningRate(Weights &w, double initia
 // implementation of SGD learning
 Weights StochasticGradientDescent::learnWeights(const Weights &w) {
 
-  int weightDim = w.size();
-  Dvector grad(weightDim, 0.0);
+  if (numThreads > 1 && batchSize == 1 && lockFreeSteps()) {
+    return learnWeightsHogwild(w);
+  }
+
+  SparseVector grad;
+  SearchIx batch;
+  int n;
   Weights wNew(w);
-  Weights wAvg(weightDim, 0.0);
+  Weights wAvg;
+
+  // scaled weights w = scale*v
+  Weights v(w);
+  double scale = 1.0;
+  double lambda = gradient->getLambda();
 
-  // learning rate
-  double eta;
+  // learning rate (and its multiplier for a mini-batch)
+  double eta, stepScale;
 
   // get number of training examples with object
   SearchIx indices = objective->getNonEmpty();
   int numIndices = indices.size();
+
+  // iteration of this call from which the weights are averaged
+  int averageStart;
+  if (averageStartIteration > 0) {
+    averageStart = averageStartIteration;
+  } else if (averageStartEpoch > 0) {
+    averageStart = (averageStartEpoch-1)*numIndices + 1;
+  } else {
+    averageStart = (maxEpochs-1)*numIndices + 1;
+  }
+  bool averaging = false;
+  avgCount = 0;
+  avgBeta = 0.0;
   
   // seed random number generator used in shuffling the dataset
-  srand((unsigned)time(NULL)); rand();
+  srand(shuffleSeed != 0 ? shuffleSeed : (unsigned)time(NULL)); rand();
+  initializeState(w.size());
+
+  // or continue after the epoch of a checkpoint
+  int firstEpoch = 0;
+  Checkpoint *state = takeResumeState("SGD");
+  if (state != NULL) {
+    unsigned seed;
+    try {
+      state->get(firstEpoch);
+      state->get(epoch);
+      state->get(t);
+      state->get(alpha);
+      state->get(t0);
+      state->getVector(v);
+      state->get(scale);
+      state->get(averaging);
+      state->getVector(avgA);
+      state->get(avgAlpha);
+      state->get(avgBeta);
+      state->get(avgCount);
+      state->get(seed);
+      state->getVector(indices);
+      loadState(*state);
+      if (v.size() != w.size() || (int) indices.size() != numIndices) {
+        throw CHECKPOINT_ERROR;
+      }
+    }
+    catch (int e) {
+      delete state;
+      throw;
+    }
+    delete state;
+    srand(seed);
+    cout << "Resuming after epoch " << epoch << endl;
+  }
+
+  epochsRun = firstEpoch;
+  startTrace();
+  startProgress();
+  startValidation();
   
   // main loop
-  for (int j=0; j<maxEpochs; j++) {
+  for (int j=firstEpoch; j<maxEpochs; j++) {
     
     // update epoch number
     epoch++;
+    epochsRun++;
 
     // randomly shuffle dataset    
     random_shuffle(indices.begin(), indices.end());
     
     // print stuff
-    // run through all training examples
-    for (int i=0; i<numIndices; i++) {
+    // run through all training examples (a mini-batch at a time)
+    for (int i=0; i<numIndices; i+=n) {
       
-      // update iteration number
-      t++;  
+      // update iteration number (counts images)
+      n = min(batchSize, numIndices - i);
+      t += n;
       
       // compute gradient for one training example
-      gradient->evaluate(grad, wNew, indices[i]);
-
-      // update learning rate
-      if (constLearningRate) {
-        eta = min(1.0/(alpha*t0), 1.0);
+      // (mean gradient of the images of a mini-batch)
+      if (n == 1) {
+        gradient->evaluateSparse(grad, v, scale, indices[i]);
       } else {
-        eta = min(1.0/(alpha*(t+t0)), 1.0);
+        batch.assign(indices.begin() + i, indices.begin() + i + n);
+        gradient->evaluateBatch(grad, v, scale, batch);
+        for (size_t k=0; k<grad.value.size(); k++) {
+          grad.value[k] /= n;
+        }
       }
+
+      // update learning rate (scaled to the batch size)
+      stepScale = batchScale(n);
+      eta = stepScale*learningRate(t);
       
       // update weights
       // w = w + eta*d = w - eta*gradient
-      for (int i=0; i<weightDim; i++) {
-        wNew[i] = wNew[i] - eta*grad[i];
-      }
+      // (the regularizer decays the weights once per image of the batch)
+      direction(grad);
+      scaledStep(v, scale, grad, eta, lambda*(n/stepScale), averaging);
       
-      // average weights from the last epoch
-      if (epoch == maxEpochs) {
-        for (int i=0; i<weightDim; i++) {
-          wAvg[i] += wNew[i]/numIndices;
-        }
+      // average weights (ASGD)
+      if (j*numIndices + i + n >= averageStart) {
+        averaging = true;
+        updateAverage(v, scale);
       }   
     }
     
-    // print progress and store temporary weights
-    progress(wNew, wAvg, epoch, t, eta, epoch == maxEpochs);
+    // print progress, store temporary weights and validate them
+    // (the averaged weights once averaging has started)
+    bool stopEarly;
+    if (averaging) {
+      averagedWeights(wAvg, v);
+      progress(wAvg, epoch, t, eta, true);
+      stopEarly = validate(wAvg, epoch);
+    } else {
+      unscale(wNew, v, scale);
+      progress(wNew, epoch, t, eta, false);
+      stopEarly = validate(wNew, epoch);
+    }
+
+    // new seed for the next epoch, which is stored in the checkpoint with the
+    // order of the images it shuffles, so a resumed run shuffles them as this
+    // one would have
+    unsigned seed = rand();
+    srand(seed);
+
+    // checkpoint
+    if (!checkpointPath.empty()) {
+      Checkpoint checkpoint("SGD");
+      checkpoint.put(j+1);
+      checkpoint.put(epoch);
+      checkpoint.put(t);
+      checkpoint.put(alpha);
+      checkpoint.put(t0);
+      checkpoint.putVector(v);
+      checkpoint.put(scale);
+      checkpoint.put(averaging);
+      checkpoint.putVector(avgA);
+      checkpoint.put(avgAlpha);
+      checkpoint.put(avgBeta);
+      checkpoint.put(avgCount);
+      checkpoint.put(seed);
+      checkpoint.putVector(indices);
+      saveState(checkpoint);
+      writeCheckpoint(checkpoint);
+    }
+
+    if (stopEarly) {
+      cout << "Stopping early: the validation AUC has stopped improving" << endl;
+      break;
+    }
     
   }
 
+  finishProgress();
+  finishCheckpoints();
+
   // return averaged weights
-  return wAvg;
+  // (or the last weights if averaging has not started, or the best weights
+  // validated)
+  if (averaging) {
+    averagedWeights(wAvg, v);
+    finishValidation(wAvg);
+    return wAvg;
+  }
+  unscale(wNew, v, scale);
+  finishValidation(wNew);
+  return wNew;
+}
+
+// one step of Hogwild for an image (run by the threads of the pool)
+// the weights of the visual words of the image are read and written with
+// relaxed atomic loads and stores, so concurrent steps on the same visual
+// word may overwrite each other, but never tear a weight
+class StochasticGradientDescent::HogwildTask : public ParallelTask {
+
+  public:
+
+    StochasticGradientDescent *sgd;
+    DataManager *dataManager;
+
+    // shared weights and the iteration at which each weight was last decayed
+    Weights *shared;
+    Ivector *lastDecay;
+
+    // log of the product of the decays (1 - 2*eta(s)*lambda) of the iterations
+    // s = 1, ..., tStart + k of the current epoch (k = 0, ..., number of steps)
+    Dvector *logDecay;
+    int tStart;
+
+    // workspace of each thread
+    std::vector<StochasticGradient *> gradients;
+    std::vector<Weights> weights;
+    std::vector<SparseVector> sparse;
+
+    void run(int imageNumber, int thread) {
+
+      Image &img = dataManager->getImages()[imageNumber];
+      Weights &w = weights[thread];
+      SparseVector &grad = sparse[thread];
+      int c, last;
+      double weight, decay;
+
+      // read the current weights of the visual words of the image, decayed up
+      // to the current iteration (other weights are not used by the image)
+      int current;
+      __atomic_load(&sgd->t, &current, __ATOMIC_RELAXED);
+      for (int i=0; i<img.numClusters; i++) {
+        c = img.clusters[i];
+        __atomic_load(&(*shared)[c], &weight, __ATOMIC_RELAXED);
+        __atomic_load(&(*lastDecay)[c], &last, __ATOMIC_RELAXED);
+        if (last < current) {
+          weight *= exp((*logDecay)[current-tStart] - (*logDecay)[last-tStart]);
+        }
+        w[c] = weight;
+      }
+
+      gradients[thread]->evaluateSparse(grad, w, 1.0, imageNumber);
+
+      int iteration = __atomic_add_fetch(&sgd->t, 1, __ATOMIC_RELAXED);
+      double eta = sgd->learningRate(iteration);
+
+      // w_c = (product of the decays since it was last decayed)*w_c - eta*gradient_c
+      // (the regularizer is applied lazily to the visual words of the image)
+      for (size_t k=0; k<grad.index.size(); k++) {
+        c = grad.index[k];
+        __atomic_load(&(*shared)[c], &weight, __ATOMIC_RELAXED);
+        __atomic_load(&(*lastDecay)[c], &last, __ATOMIC_RELAXED);
+        if (last < iteration) {
+          decay = exp((*logDecay)[iteration-tStart] - (*logDecay)[last-tStart]);
+          __atomic_store(&(*lastDecay)[c], &iteration, __ATOMIC_RELAXED);
+        } else {
+          decay = 1.0;
+        }
+        weight = decay*weight - eta*grad.value[k];
+        __atomic_store(&(*shared)[c], &weight, __ATOMIC_RELAXED);
+      }
+    }
+};
+
+
+// Hogwild SGD
+Weights StochasticGradientDescent::learnWeightsHogwild(const Weights &w) {
+
+  int weightDim = w.size();
+  Weights shared(w);
+  Weights wAvg(weightDim, 0.0);
+  Ivector lastDecay(weightDim, 0);
+  Dvector logDecay;
+  double lambda = gradient->getLambda();
+  double eta = 0.0;
+
+  // get number of training examples with object
+  SearchIx indices = objective->getNonEmpty();
+  int numIndices = indices.size();
+
+  // the lazy average of the serial learner needs the weights after every step,
+  // so the weights are averaged after every epoch from the averaging epoch on
+  // (by default over the second half of the epochs instead of the last one)
+  int averageEpoch = maxEpochs/2 + 1;
+  if (averageStartIteration > 0) {
+    averageEpoch = (averageStartIteration + numIndices - 1)/numIndices;
+  } else if (averageStartEpoch > 0) {
+    averageEpoch = averageStartEpoch;
+  }
+  int numAveraged = 0;
+
+  // workspace of each thread: a copy of the CRF, of the gradient (and its sampler)
+  ConditionalRandomField *crf = gradient->getCRF();
+  std::vector<ConditionalRandomField *> threadCRFs(numThreads);
+  HogwildTask task;
+  task.sgd = this;
+  task.dataManager = objective->getDataManager();
+  task.shared = &shared;
+  task.lastDecay = &lastDecay;
+  task.logDecay = &logDecay;
+  task.gradients.resize(numThreads);
+  task.weights.assign(numThreads, w);
+  task.sparse.resize(numThreads);
+  for (int i=0; i<numThreads; i++) {
+    threadCRFs[i] = crf->clone();
+    task.gradients[i] = gradient->clone(threadCRFs[i]);
+  }
+
+  ThreadPool threadPool(numThreads);
+
+  // the ground truth features are computed on first use, so not by the threads
+  if (numIndices > 0) {
+    task.dataManager->getGroundTruthFeatures(indices[0], crf->getStepSize());
+  }
+
+  // seed random number generator used in shuffling the dataset
+  srand(shuffleSeed != 0 ? shuffleSeed : (unsigned)time(NULL)); rand();
+
+  // or continue after the epoch of a checkpoint
+  int firstEpoch = 0;
+  Checkpoint *state = takeResumeState("Hogwild");
+  if (state != NULL) {
+    unsigned seed;
+    try {
+      state->get(firstEpoch);
+      state->get(epoch);
+      state->get(t);
+      state->get(alpha);
+      state->get(t0);
+      state->getVector(shared);
+      state->getVector(wAvg);
+      state->get(numAveraged);
+      state->get(seed);
+      state->getVector(indices);
+      loadState(*state);
+      if (shared.size() != w.size() || wAvg.size() != w.size() || (int) indices.size() != numIndices) {
+        throw CHECKPOINT_ERROR;
+      }
+    }
+    catch (int e) {
+      delete state;
+      for (int i=0; i<numThreads; i++) {
+        delete task.gradients[i];
+        delete threadCRFs[i];
+      }
+      throw;
+    }
+    delete state;
+    srand(seed);
+    cout << "Resuming after epoch " << epoch << endl;
+  }
+
+  epochsRun = firstEpoch;
+  startTrace();
+  startProgress();
+  startValidation();
+
+  for (int j=firstEpoch; j<maxEpochs; j++) {
+
+    epoch++;
+    epochsRun++;
+    random_shuffle(indices.begin(), indices.end());
+
+    // decays of the iterations of this epoch (as in the serial learner)
+    int tStart = t;
+    logDecay.assign(numIndices+1, 0.0);
+    for (int k=1; k<=numIndices; k++) {
+      logDecay[k] = logDecay[k-1] + log(max(1.0 - 2*learningRate(tStart+k)*lambda, 1e-300));
+    }
+    for (int i=0; i<weightDim; i++) {
+      lastDecay[i] = tStart;
+    }
+    task.tStart = tStart;
+
+    try {
+      threadPool.run(task, indices);
+    }
+    catch (int e) {
+      for (int i=0; i<numThreads; i++) {
+        delete task.gradients[i];
+        delete threadCRFs[i];
+      }
+      throw;
+    }
+
+    // bring the decay of all weights up to the end of the epoch
+    for (int i=0; i<weightDim; i++) {
+      shared[i] *= exp(logDecay[numIndices] - logDecay[lastDecay[i]-tStart]);
+    }
+    t = tStart + numIndices;
+    eta = learningRate(t);
+
+    // average weights (ASGD)
+    bool stopEarly;
+    if (j+1 >= averageEpoch) {
+      numAveraged++;
+      for (int i=0; i<weightDim; i++) {
+        wAvg[i] += (shared[i] - wAvg[i])/numAveraged;
+      }
+      progress(wAvg, epoch, t, eta, true);
+      stopEarly = validate(wAvg, epoch);
+    } else {
+      progress(shared, epoch, t, eta, false);
+      stopEarly = validate(shared, epoch);
+    }
+
+    // checkpoint (with a new seed as in the serial learner)
+    unsigned seed = rand();
+    srand(seed);
+    if (!checkpointPath.empty()) {
+      Checkpoint checkpoint("Hogwild");
+      checkpoint.put(j+1);
+      checkpoint.put(epoch);
+      checkpoint.put(t);
+      checkpoint.put(alpha);
+      checkpoint.put(t0);
+      checkpoint.putVector(shared);
+      checkpoint.putVector(wAvg);
+      checkpoint.put(numAveraged);
+      checkpoint.put(seed);
+      checkpoint.putVector(indices);
+      saveState(checkpoint);
+      writeCheckpoint(checkpoint);
+    }
+
+    if (stopEarly) {
+      cout << "Stopping early: the validation AUC has stopped improving" << endl;
+      break;
+    }
+  }
+
+  for (int i=0; i<numThreads; i++) {
+    delete task.gradients[i];
+    delete threadCRFs[i];
+  }
+  finishProgress();
+  finishCheckpoints();
+
+  if (numAveraged > 0) {
+    finishValidation(wAvg);
+    return wAvg;
+  }
+  finishValidation(shared);
+  return shared;
+}
+
+
+// create the progress evaluator
+void StochasticGradientDescent::startProgress() {
+  delete progressEvaluator;
+  progressEvaluator = NULL;
+  if (backgroundProgress || progressSampleSize > 0) {
+    progressEvaluator = new ProgressEvaluator(objective, tempWeightsPath, backgroundProgress, progressSampleSize, progressGradientNorm);
+  }
+}
+
+// wait for the progress evaluator
+void StochasticGradientDescent::finishProgress() {
+  if (progressEvaluator == NULL) {
+    return;
+  }
+
+  // the background evaluations did not stop learning, so they are traced at
+  // the learning time of their snapshots
+  progressEvaluator->finish();
+  if (progressEvaluator->isBackground()) {
+    traceTimes = progressEvaluator->getTimes();
+    traceObjectives = progressEvaluator->getObjectives();
+  }
+  delete progressEvaluator;
+  progressEvaluator = NULL;
 }
 
 // print progress and store temp weights
-void StochasticGradientDescent::progress(Weights &w, Weights &wAvg, int epoch, int t, double eta, bool lastEpoch) {
+void StochasticGradientDescent::progress(Weights &w, int epoch, int t, double eta, bool averaged) {
+
+  // evaluated by the progress evaluator (in the background or on a subset)
+  if (progressEvaluator != NULL) {
+    double elapsed = getLearningTime();
+    progressEvaluator->submit(w, epoch, t, eta, averaged, elapsed);
+    if (!progressEvaluator->isBackground()) {
+      recordTrace(elapsed, progressEvaluator->getObjectives().back());
+    }
+    return;
+  }
+
+  // compute current value of objective (and norm of the full gradient)
+  double elapsed = getLearningTime();
+  double fval;
+  double gnorm = 0.0;
+  if (progressGradientNorm) {
+    Dvector grad(w.size());
+    fval = objective->evaluateWithGradient(w, grad);
+    for (size_t i=0; i<grad.size(); i++) {
+      gnorm += grad[i]*grad[i];
+    }
+    gnorm = sqrt(gnorm);
+  } else {
+    fval = objective->evaluate(w);
+  }
+  recordTrace(elapsed, fval);
 
-  // compute current value of objective
-  double fval = objective->evaluate(w);
   cout << "Epoch:      " << epoch << endl;
   cout << "Iterations: " << t << endl;
   cout << "eta:        " << eta << endl;
-  cout << "fval:       " << fval << endl;
-  
-  if (lastEpoch) {
-    double fvalAvg = objective->evaluate(wAvg);
-    cout << "fvalAvg:    " << fvalAvg << endl;
+  if (averaged) {
+    cout << "fvalAvg:    " << fval << endl;
+  } else {
+    cout << "fval:       " << fval << endl;
+  }
+  if (progressGradientNorm) {
+    cout << "gnorm:      " << gnorm << endl;
   }
   
   cout << endl;
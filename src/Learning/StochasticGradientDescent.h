@@ -16,6 +16,7 @@
 #define _STOCHASTIC_GRADIENT_DESCENT_H_
 
 #include "GradientDescent.h"
+#include "ProgressEvaluator.h"
 #include "ObjectiveFunctions/StochasticGradient.h"
 
 
@@ -37,26 +38,127 @@ class StochasticGradientDescent : public GradientDescent {
       
     // maximum number of epochs
     int maxEpochs;
+
+    // averaging (ASGD) starts at this epoch or iteration of learnWeights
+    // (counted from 1, by default the last epoch is averaged)
+    int averageStartEpoch;
+    int averageStartIteration;
+
+    // lazy average of the weights: wAvg = avgAlpha*avgA + avgBeta*v,
+    // so the average is updated in O(1) per step plus the sparse update
+    Weights avgA;
+    double avgAlpha;
+    double avgBeta;
+    int avgCount;
     
     // current epoch and iteration
     int epoch;
     int t; 
+
+    // epochs of the last call to learnWeights
+    int epochsRun;
     
     // path for temporary weights
     std::string tempWeightsPath;
 
+    // number of threads (Hogwild when more than one)
+    int numThreads;
+
+    // number of images per step (mini-batches when more than one)
+    int batchSize;
+
+    // number of threads for the trials of initializeLearningRate
+    int numTrialThreads;
+
+    // seed of the shuffling of the images (0 for the time)
+    unsigned shuffleSeed;
+
+    // progress evaluation in the background and/or on a random subset of the
+    // images (the evaluator only exists during learnWeights)
+    bool backgroundProgress;
+    int progressSampleSize;
+    bool progressGradientNorm;
+    ProgressEvaluator *progressEvaluator;
+
+    // create the progress evaluator (if used) at the start of learnWeights and
+    // wait for it and add its results to the trace at the end
+    void startProgress();
+    void finishProgress();
+
+    // the weights are represented as w = scale*v during learning, so that the
+    // L2 regularizer only changes scale and a step only touches the visual
+    // words of the image: w = (1 - 2*eta*lambda)*w - eta*gradient
+    // (when average is true the lazy average is kept equal while v changes)
+    void scaledStep(Weights &v, double &scale, const SparseVector &grad, double eta, double lambda, bool average = false);
+
+    // add w = scale*v to the lazy average
+    void updateAverage(const Weights &v, double scale);
+
+    // wAvg = avgAlpha*avgA + avgBeta*v
+    void averagedWeights(Weights &wAvg, const Weights &v);
+
+    // w = scale*v
+    void unscale(Weights &w, const Weights &v, double scale);
+
+    // learning rate at an iteration
+    virtual double learningRate(int iteration);
+
+    // turn the sparse gradient into the step direction in place
+    // (SGD steps along the gradient, adaptive learners rescale each visual word)
+    virtual void direction(SparseVector &grad);
+
+    // multiplier of the learning rate for a step along the mean gradient of n
+    // images (n for SGD, so a mini-batch goes as far as its images would one
+    // by one, 1 for adaptive learners, whose direction is already normalized).
+    // The weights decay once per image either way
+    virtual double batchScale(int n);
+
+    // reset the state of the learner at the start of learnWeights
+    virtual void initializeState(int weightDim);
+
+    // state of the learner besides the weights in checkpoints (e.g. the
+    // accumulated gradients of AdaGrad), put after the state of SGD
+    virtual void saveState(Checkpoint &checkpoint);
+    virtual void loadState(Checkpoint &checkpoint);
+
+    // true if a step only depends on the gradient and the learning rate, so that
+    // threads can take steps without locks (false for learners with state per
+    // visual word, which always learn with one thread)
+    virtual bool lockFreeSteps();
+
+    // true if the learning rate trials can run on copies of the gradient at the
+    // same time (false when the copies share state which the trials change,
+    // e.g. persistent Gibbs chains, which are then tried one by one)
+    virtual bool independentTrials();
+
+    // Hogwild (Niu, Recht, Re and Wright, 2011): threads take the images of an
+    // epoch from the thread pool and update the shared weights without locks
+    Weights learnWeightsHogwild(const Weights &w);
+    class HogwildTask;
+
     // try given learning rate on sample subset
     // for use in initializeLearningRate
     double tryEta(Weights &w, double eta, SearchIx &sample, bool normalized);
 
+    // the same using the given gradient and CRF workspace (a copy of the CRF),
+    // so trials can run on different threads
+    double tryEta(StochasticGradient *grad, ConditionalRandomField *workspace, Weights &w, double eta, SearchIx &sample, bool normalized);
+
+    // try the learning rates etas starting from w, concurrently on up to
+    // numTrialThreads threads (if the trials are independent)
+    void tryEtas(const Weights &w, const Dvector &etas, SearchIx &sample, bool normalized, Dvector &fvals);
+    class TrialTask;
+
     // print progress
-    void progress(Weights &w, Weights &wAvg, int epoch, int t, double eta, bool lastEpoch) ;
+    // (for the averaged weights once averaging has started)
+    virtual void progress(Weights &w, int epoch, int t, double eta, bool averaged);
 
   public:
 
     // constructors
     StochasticGradientDescent(ObjectiveFunction *obj, StochasticGradient *grad);
     StochasticGradientDescent(ObjectiveFunction *obj, StochasticGradient *grad, double alpha_, double t0_, bool constLearningRate = false);
+    virtual ~StochasticGradientDescent();
 
     // getters and setters for learning rate parameters
     double getAlpha();
@@ -65,11 +167,56 @@ class StochasticGradientDescent : public GradientDescent {
     double getT0();
     void setT0(double t0_);
     
+    int getMaxEpochs();
     void setMaxEpochs(int maxEpochs_);
+
+    // epochs of the last call to learnWeights (fewer than maxEpochs when it
+    // stopped early, and including the epochs before the checkpoint when it
+    // resumed from one), unlike the epoch counter of the learning rate, which
+    // continues over calls until initializeLearningRate
+    int getEpochs();
+
+    // averaged SGD: average the weights from the given epoch or iteration
+    // (the averaged weights are returned by learnWeights)
+    void setAverageStartEpoch(int epoch);
+    void setAverageStartIteration(int iteration);
     
     // path for storing temporary weights between iterations
     void setTempWeightsPath(std::string path);
 
+    // number of threads used by learnWeights (each with its own copy of the CRF
+    // and the gradient)
+    int getNumThreads();
+    void setNumThreads(int n);
+
+    // mini-batch SGD: take a step for every batchSize images along their mean
+    // gradient with the learning rate multiplied by batchScale. The gradients of
+    // a batch are evaluated in parallel by the gradient (see
+    // StochasticGradient::evaluateBatch), so Hogwild is only used for batch size 1
+    int getBatchSize();
+    void setBatchSize(int n);
+
+    // number of learning rates tried at the same time by initializeLearningRate
+    // (defaults to the number of processors, 1 tries them one by one)
+    int getNumTrialThreads();
+    void setNumTrialThreads(int n);
+
+    // seed of the random order of the images in learnWeights (the default 0
+    // seeds it with the time, any other seed gives the same order every run)
+    unsigned getSeed();
+    void setSeed(unsigned seed_);
+
+    // evaluate the objective after every epoch on a background thread working
+    // on a copy of the weights, so learning does not wait for it (the progress
+    // is printed when it is done), and/or estimate it from a fixed random
+    // subset of sampleSize images (0 for all images)
+    void setBackgroundProgress(bool background);
+    void setProgressSampleSize(int sampleSize);
+
+    // print the norm of the full gradient with the objective after every
+    // epoch (costs a gradient evaluation on top of the objective, off by default)
+    void setProgressGradientNorm(bool gradientNorm);
+
     // use training data (or a subset) to initialize t0 and alpha
     void initializeLearningRate(Weights &w, double initialEta, int sampleSize, bool normalized);
     
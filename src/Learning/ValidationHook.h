@@ -0,0 +1,44 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _VALIDATION_HOOK_H_
+#define _VALIDATION_HOOK_H_
+
+#include "Types.h"
+
+// hook through which a learner has its weights validated during learning
+// (e.g. ValidationMonitor in Measures), so it can stop early and return the
+// best weights found instead of the last ones
+// abstract base class
+class ValidationHook {
+
+  public:
+
+    virtual ~ValidationHook() { }
+
+    // forget the validations of an earlier call to learnWeights
+    virtual void start() = 0;
+
+    // validate the weights after an iteration (L-BFGS and Newton-CG) or epoch
+    // (SGD and CD) and return whether the learner should stop (the validation
+    // may happen later, so the answer may lag behind the weights given)
+    virtual bool validate(const Weights &w, int step) = 0;
+
+    // wait for the validations and get the best weights validated
+    // (returns false if none were)
+    virtual bool finish(Weights &best) = 0;
+
+};
+
+#endif // _VALIDATION_HOOK_H_
@@ -0,0 +1,105 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+#include "Types.h"
+#include "VarianceReducedGradientDescent.h"
+
+using namespace std;
+
+// constructor
+VarianceReducedGradientDescent::VarianceReducedGradientDescent(ObjectiveFunction *obj, Gradient *grad, StochasticGradient *sgrad) :
+  GradientDescent(obj, grad),
+  stochasticGradient(sgrad),
+  eta(1e-3),
+  maxEpochs(50),
+  epoch(0),
+  tempWeightsPath("tempWeightsVR.txt") { }
+
+// getters/setters
+double VarianceReducedGradientDescent::getEta() {
+  return eta;
+}
+
+void VarianceReducedGradientDescent::setEta(double eta_) {
+  eta = eta_;
+}
+
+void VarianceReducedGradientDescent::setMaxEpochs(int maxEpochs_) {
+  maxEpochs = maxEpochs_;
+}
+
+int VarianceReducedGradientDescent::getEpochs() {
+  return epoch;
+}
+
+void VarianceReducedGradientDescent::setTempWeightsPath(string path) {
+  tempWeightsPath = path;
+}
+
+
+// take a step
+// (the O(D) part is negligible next to the sliding window over the image)
+void VarianceReducedGradientDescent::step(Weights &w, const Dvector &dense, const SparseVector &sparse) {
+
+  double decay = 1.0 - 2*eta*objective->getLambda()/indices.size();
+  if (dense.empty()) {
+    for (size_t i=0; i<w.size(); i++) {
+      w[i] *= decay;
+    }
+  } else {
+    for (size_t i=0; i<w.size(); i++) {
+      w[i] = decay*w[i] - eta*dense[i];
+    }
+  }
+
+  for (size_t k=0; k<sparse.index.size(); k++) {
+    w[sparse.index[k]] -= eta*sparse.value[k];
+  }
+}
+
+
+// print progress and store temp weights
+bool VarianceReducedGradientDescent::progress(const Weights &w, double fval, const Dvector &grad) {
+
+  double gnorm = 0.0, wnorm = 0.0;
+  for (size_t i=0; i<w.size(); i++) {
+    gnorm += grad[i]*grad[i];
+    wnorm += w[i]*w[i];
+  }
+  gnorm = sqrt(gnorm);
+  wnorm = sqrt(wnorm);
+
+  cout << "Epoch:      " << epoch << endl;
+  cout << "time:       " << traceTimes.back() << endl;
+  cout << "fval:       " << fval << endl;
+  cout << "gnorm:      " << gnorm << endl;
+  cout << endl;
+
+  // store weights
+  ofstream tempWeightFile(tempWeightsPath.c_str());
+  if (!tempWeightFile) {
+    cerr << "Could not open file " << tempWeightsPath << endl;
+  }
+  for (size_t i=0; i<w.size(); i++) {
+    tempWeightFile << w[i] << "\n";
+  }
+  tempWeightFile.close();
+
+  // stop criterion: ||g|| < epsilon * max(1, ||w||) (as for LBFGS)
+  return gnorm < 1e-3*max(1.0, wnorm);
+}
@@ -0,0 +1,73 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _VARIANCE_REDUCED_GRADIENT_DESCENT_H_
+#define _VARIANCE_REDUCED_GRADIENT_DESCENT_H_
+
+#include <string>
+#include "GradientDescent.h"
+#include "ObjectiveFunctions/StochasticGradient.h"
+
+// base class for variance reduced stochastic gradient methods (SVRG, SAGA)
+// the objective is split into one term per image with the object,
+//   F(w) = sum_i F_i(w),  F_i(w) = lambda/m ||w||^2 + f_i(w),
+// and each step uses an unbiased estimate of grad F(w)/m whose variance
+// vanishes at the optimum, so a constant learning rate can be used and the
+// methods converge to the same weights as LBFGS
+class VarianceReducedGradientDescent : public GradientDescent {
+
+  protected:
+
+    // per image gradients (sparse, without the regularizer)
+    StochasticGradient *stochasticGradient;
+
+    // constant learning rate
+    double eta;
+
+    // maximum number of epochs (an epoch takes one step per image)
+    int maxEpochs;
+    int epoch;
+
+    // images with the object (m = indices.size())
+    SearchIx indices;
+
+    // path for temporary weights
+    std::string tempWeightsPath;
+
+    // w = w - eta*(2*lambda/m*w + dense + sparse)
+    // (dense may be empty)
+    void step(Weights &w, const Dvector &dense, const SparseVector &sparse);
+
+    // print progress and store temporary weights for the objective value and
+    // gradient at w (true when the stop criterion of LBFGS is met)
+    bool progress(const Weights &w, double fval, const Dvector &grad);
+
+  public:
+
+    // constructor
+    VarianceReducedGradientDescent(ObjectiveFunction *obj, Gradient *grad, StochasticGradient *sgrad);
+
+    // getters/setters
+    double getEta();
+    void setEta(double eta_);
+
+    void setMaxEpochs(int maxEpochs_);
+    int getEpochs();
+
+    // path for storing temporary weights between epochs
+    void setTempWeightsPath(std::string path);
+
+};
+
+#endif // _VARIANCE_REDUCED_GRADIENT_DESCENT_H_
@@ -0,0 +1,217 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include "ValidationMonitor.h"
+#include "LossMeasures.h"
+
+using namespace std;
+
+
+// constructor (starts the thread)
+ValidationMonitor::ValidationMonitor(DataManager *validationSet_, int interval_, int patience_, int sampleSize, int predictionStepSize_) :
+  validationSet(validationSet_),
+  interval(max(interval_, 1)),
+  patience(max(patience_, 1)),
+  predictionStepSize(predictionStepSize_),
+  bestAUC(-1.0),
+  bestStep(0),
+  sinceBest(0),
+  stopRequested(false),
+  hasPending(false),
+  busy(false),
+  stop(false)
+{
+  // images with objects (a fixed random subset of them)
+  Bboxes &bboxes = validationSet->getBboxes();
+  for (int i=0; i<validationSet->getNumFiles(); i++) {
+    if (bboxes[i].numObject > 0) {
+      images.push_back(i);
+    }
+  }
+  if (sampleSize > 0 && sampleSize < (int) images.size()) {
+    random_shuffle(images.begin(), images.end());
+    images.resize(sampleSize);
+    sort(images.begin(), images.end());
+  }
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&pendingCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+  pthread_create(&thread, NULL, worker, this);
+}
+
+// destructor (validates the pending snapshot and joins the thread)
+ValidationMonitor::~ValidationMonitor() {
+  pthread_mutex_lock(&mutex);
+  stop = true;
+  pthread_cond_signal(&pendingCond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(thread, NULL);
+
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&pendingCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+int ValidationMonitor::getNumImages() {
+  return images.size();
+}
+
+
+// forget the last run (after the thread has finished it)
+void ValidationMonitor::start() {
+  pthread_mutex_lock(&mutex);
+  while (hasPending || busy) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  aucs.clear();
+  steps.clear();
+  bestWeights.clear();
+  bestAUC = -1.0;
+  bestStep = 0;
+  sinceBest = 0;
+  stopRequested = false;
+  pthread_mutex_unlock(&mutex);
+}
+
+// submit a copy of the weights every interval steps
+// (replacing the snapshot waiting, if any)
+bool ValidationMonitor::validate(const Weights &w, int step) {
+  pthread_mutex_lock(&mutex);
+  if (step % interval == 0 && !images.empty()) {
+    pending.w = w;
+    pending.step = step;
+    hasPending = true;
+    pthread_cond_signal(&pendingCond);
+  }
+  bool stopLearning = stopRequested;
+  pthread_mutex_unlock(&mutex);
+  return stopLearning;
+}
+
+// wait until the thread is idle
+bool ValidationMonitor::finish(Weights &best) {
+  pthread_mutex_lock(&mutex);
+  while (hasPending || busy) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  bool found = !bestWeights.empty();
+  if (found) {
+    best = bestWeights;
+  }
+  pthread_mutex_unlock(&mutex);
+  return found;
+}
+
+// getters (after finish)
+const Dvector &ValidationMonitor::getAUCs() {
+  return aucs;
+}
+
+const Ivector &ValidationMonitor::getSteps() {
+  return steps;
+}
+
+double ValidationMonitor::getBestAUC() {
+  return bestAUC;
+}
+
+int ValidationMonitor::getBestStep() {
+  return bestStep;
+}
+
+bool ValidationMonitor::stoppedEarly() {
+  return stopRequested;
+}
+
+
+// compute AUC and keep the best weights
+void ValidationMonitor::evaluate(Snapshot &snapshot) {
+
+  ostringstream os;
+  double auc;
+  try {
+    validationSet->setWeights(snapshot.w);
+    auc = computeRecallOverlap(*validationSet, images, predictionStepSize, false).AUC;
+  }
+  catch (int e) {
+    os << "Validation at " << snapshot.step << " threw exception " << e << endl << endl;
+    cout << os.str() << flush;
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  aucs.push_back(auc);
+  steps.push_back(snapshot.step);
+  if (auc > bestAUC) {
+    bestAUC = auc;
+    bestStep = snapshot.step;
+    bestWeights.swap(snapshot.w);
+    sinceBest = 0;
+  } else {
+    sinceBest++;
+    if (sinceBest >= patience) {
+      stopRequested = true;
+    }
+  }
+
+  // print as one block, the learner may print at the same time
+  os << "Validation at " << snapshot.step << ": AUC " << auc << " on " << images.size() << " images";
+  os << " (best " << bestAUC << " at " << bestStep << ")" << endl << endl;
+  pthread_mutex_unlock(&mutex);
+  cout << os.str() << flush;
+}
+
+
+// main loop of the thread
+void *ValidationMonitor::worker(void *arg) {
+  ((ValidationMonitor *) arg)->work();
+  return NULL;
+}
+
+void ValidationMonitor::work() {
+
+  Snapshot snapshot;
+
+  pthread_mutex_lock(&mutex);
+  while (true) {
+
+    // wait for a snapshot (the pending one is validated before stopping)
+    while (!stop && !hasPending) {
+      pthread_cond_wait(&pendingCond, &mutex);
+    }
+    if (!hasPending) {
+      break;
+    }
+    snapshot.w.swap(pending.w);
+    snapshot.step = pending.step;
+    hasPending = false;
+    busy = true;
+    pthread_mutex_unlock(&mutex);
+
+    evaluate(snapshot);
+
+    pthread_mutex_lock(&mutex);
+    busy = false;
+    if (!hasPending) {
+      pthread_cond_broadcast(&doneCond);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
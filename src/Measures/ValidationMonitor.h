@@ -0,0 +1,102 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _VALIDATION_MONITOR_H_
+#define _VALIDATION_MONITOR_H_
+
+#include <pthread.h>
+
+#include "DataManager.h"
+#include "Learning/ValidationHook.h"
+#include "Types.h"
+
+// early stopping on the validation set: every interval iterations or epochs
+// the AUC of the recall-overlap curve is computed on a fixed random subset of
+// the validation images by a thread, so the learner does not wait for it.
+// Learning stops when the AUC has not improved for patience validations, and
+// the weights with the best AUC are returned by the learner. When the thread
+// falls behind, only the newest weights waiting are validated.
+// The validation set (and its weights) belongs to the thread while learning
+class ValidationMonitor : public ValidationHook {
+
+  private:
+
+    // weights to validate
+    struct Snapshot {
+      Weights w;
+      int step;
+    };
+
+    DataManager *validationSet;
+    SearchIx images;              // validation images with objects the AUC is computed on
+    int interval;
+    int patience;
+    int predictionStepSize;
+
+    // validations and the best weights (guarded by the mutex)
+    Dvector aucs;
+    Ivector steps;
+    Weights bestWeights;
+    double bestAUC;
+    int bestStep;
+    int sinceBest;                // validations since the best one
+    bool stopRequested;
+
+    // snapshot waiting for the thread
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t pendingCond;   // signalled when a snapshot is submitted or the thread stops
+    pthread_cond_t doneCond;      // signalled when the thread is idle
+    Snapshot pending;
+    bool hasPending;
+    bool busy;
+    bool stop;
+
+    // compute the AUC of a snapshot and update the best weights
+    void evaluate(Snapshot &snapshot);
+
+    // main loop of the thread
+    static void *worker(void *arg);
+    void work();
+
+    // not copyable (owns the thread)
+    ValidationMonitor(const ValidationMonitor &);
+    ValidationMonitor &operator=(const ValidationMonitor &);
+
+  public:
+
+    // constructor and destructor (starts the thread). sampleSize images with
+    // objects are drawn at random from the validation set (0 uses all
+    // images). The boxes are predicted with ESS for predictionStepSize 1 and
+    // by sliding window in the quantized images otherwise
+    ValidationMonitor(DataManager *validationSet, int interval = 1, int patience = 3, int sampleSize = 0, int predictionStepSize = 1);
+    ~ValidationMonitor();
+
+    int getNumImages();
+
+    // validation hook
+    void start();
+    bool validate(const Weights &w, int step);
+    bool finish(Weights &best);
+
+    // validations of the last run (after finish)
+    const Dvector &getAUCs();
+    const Ivector &getSteps();
+    double getBestAUC();
+    int getBestStep();
+    bool stoppedEarly();
+
+};
+
+#endif // _VALIDATION_MONITOR_H_
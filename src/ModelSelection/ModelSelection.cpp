@@ -19,17 +19,25 @@
 #include <cstdlib>
 #include <algorithm>
 #include <iostream>
+#include <iomanip>
 #include <sstream>
 #include <fstream>
 
 #include "DataManager.h"
 #include "ConditionalRandomField.h"
+#include "PiecewiseConditionalRandomField.h"
 #include "Measures/LossMeasures.h"
 #include "ObjectiveFunctions/ObjectiveFunction.h"
 #include "ObjectiveFunctions/Gradient.h"
 #include "ObjectiveFunctions/StochasticGradient.h"
+#include "ObjectiveFunctions/PseudoLikelihood.h"
+#include "ObjectiveFunctions/PseudoLikelihoodGradient.h"
+#include "ObjectiveFunctions/PiecewiseLogLikelihood.h"
+#include "ObjectiveFunctions/PiecewiseGradient.h"
 #include "Learning/GradientDescent.h"
 #include "Learning/StochasticGradientDescent.h"
+#include "Learning/LBFGS.h"
+#include "Learning/CoarseToFine.h"
 #include "Types.h"
 
 using namespace std;
@@ -230,3 +238,170 @@ double modelSelectionStochastic(DataManager &trainingSet,
 
   return 2.0;
 }*/
+
+
+// remove option from the arguments
+bool takeOption(int &argc, char **argv, const string &option) {
+  for (int i=1; i<argc; i++) {
+    if (option.compare(argv[i]) == 0) {
+      for (int k=i; k<argc-1; k++) {
+        argv[k] = argv[k+1];
+      }
+      argc--;
+      return true;
+    }
+  }
+  return false;
+}
+
+// remove option and its value from the arguments
+bool takeOption(int &argc, char **argv, const string &option, string &value) {
+  for (int i=1; i<argc-1; i++) {
+    if (option.compare(argv[i]) == 0) {
+      value = string(argv[i+1]);
+      for (int k=i; k<argc-2; k++) {
+        argv[k] = argv[k+2];
+      }
+      argc -= 2;
+      return true;
+    }
+  }
+  return false;
+}
+
+// parse coarse-to-fine schedule
+bool parseSchedule(const string &schedule, Ivector &stepSizes, Dvector &tolerances) {
+  istringstream is(schedule);
+  string stage;
+  char colon;
+  int stepSize;
+  double tolerance;
+
+  stepSizes.clear();
+  tolerances.clear();
+  while (getline(is, stage, ',')) {
+    istringstream stageStream(stage);
+    if (!(stageStream >> stepSize >> colon >> tolerance) || colon != ':' || stepSize <= 0 || tolerance <= 0) {
+      return false;
+    }
+    stepSizes.push_back(stepSize);
+    tolerances.push_back(tolerance);
+  }
+  return !stepSizes.empty();
+}
+
+// parse early stopping option
+bool parseEarlyStopping(const string &option, int &interval, int &patience, int &sampleSize) {
+  istringstream is(option);
+  char colon1, colon2;
+  if (!(is >> interval >> colon1 >> patience >> colon2 >> sampleSize) || colon1 != ':' || colon2 != ':') {
+    return false;
+  }
+  return interval > 0 && patience > 0 && sampleSize >= 0;
+}
+
+// print time and validation AUC of the stages
+void printStages(ostream &infostream, CoarseToFine &c2f, DataManager &validationSet) {
+  const Dvector &times = c2f.getStageTimes();
+  vector<Weights> weights = c2f.getStageWeights();
+  SearchIx indices;
+  RecallOverlap recallOverlap;
+  double total = 0.0;
+  ostringstream label;
+
+  for (size_t k=0; k<weights.size(); k++) {
+    validationSet.setWeights(weights[k]);
+    recallOverlap = computeRecallOverlap(validationSet, indices, 1, false);
+    total += times[k];
+
+    label.clear();
+    label.str("");
+    label << "Stage " << k+1 << " (step size " << c2f.getStepSize(k) << ")";
+    infostream << left << setw(24) << label.str() << ": wall time " << times[k];
+    infostream << " (total " << total << "), AUC val " << recallOverlap.AUC << endl;
+  }
+  infostream << endl;
+}
+
+// learn or load warm start weights
+int warmStart(const string &source, DataManager &trainingSet, int stepSize, double lambda,
+              const Weights &initial, const string &tempWeightsPath, Weights &warm) {
+
+  // the CRF of the cheap objective is only needed here
+  if (source.compare("pseudo") == 0) {
+    ConditionalRandomField crf(&trainingSet);
+    crf.setStepSize(stepSize);
+    crf.setWeights(initial);
+    PseudoLikelihood pseudolik(&trainingSet, &crf);
+    PseudoLikelihoodGradient pseudograd(&trainingSet, &crf);
+    pseudolik.setLambda(lambda);
+    pseudograd.setLambda(lambda);
+
+    LBFGS lbfgs(&pseudolik, &pseudograd);
+    lbfgs.setTempWeightsPath(tempWeightsPath);
+    warm = lbfgs.learnWeights(initial);
+    return lbfgs.getFunctionEvaluations();
+  }
+
+  if (source.compare("piecewise") == 0) {
+    PiecewiseConditionalRandomField pcrf(&trainingSet);
+    pcrf.setStepSize(stepSize);
+    pcrf.setWeights(initial);
+    PiecewiseLogLikelihood piecewiselik(&trainingSet, &pcrf);
+    PiecewiseGradient piecewisegrad(&trainingSet, &pcrf);
+    piecewiselik.setLambda(lambda);
+    piecewisegrad.setLambda(lambda);
+
+    LBFGS lbfgs(&piecewiselik, &piecewisegrad);
+    lbfgs.setTempWeightsPath(tempWeightsPath);
+    warm = lbfgs.learnWeights(initial);
+    return lbfgs.getFunctionEvaluations();
+  }
+
+  // e.g. weights/pseudolikelihood/<object>_<stepSize>_<lambda>_weights.txt
+  trainingSet.loadWeights(source);
+  warm = trainingSet.getWeights();
+  return 0;
+}
+
+// read value from info file
+bool readInfoValue(const string &infoFile, const string &key, double &value) {
+  ifstream fs(infoFile.c_str());
+  string line;
+  size_t colon;
+
+  while (getline(fs, line)) {
+    colon = line.find(':');
+    if (colon == string::npos || line.compare(0, key.size(), key) != 0) {
+      continue;
+    }
+    // the key is followed by spaces only
+    if (line.find_first_not_of(' ', key.size()) != colon) {
+      continue;
+    }
+    istringstream is(line.substr(colon+1));
+    return (bool) (is >> value);
+  }
+  return false;
+}
+
+// print cost and savings of a warm start
+void printWarmStart(ostream &infostream, const string &source, int warmEvaluations, double warmTime,
+                    const string &coldInfoFile, const string &key, int evaluations) {
+  infostream << left << setw(24) << "Warm start" << ": " << source;
+  infostream << " (" << warmEvaluations << " cheap evaluations in " << warmTime << " s wall time)" << endl;
+
+  // lower case key, e.g. "Saved function evaluations"
+  string label = key;
+  transform(label.begin(), label.end(), label.begin(), ::tolower);
+  label = "Saved " + label;
+
+  double coldEvaluations;
+  infostream << left << setw(24) << label << ": ";
+  if (readInfoValue(coldInfoFile, key, coldEvaluations)) {
+    infostream << (int) coldEvaluations - evaluations << " of " << (int) coldEvaluations;
+    infostream << " with random initialization (" << coldInfoFile << ")" << endl << endl;
+  } else {
+    infostream << "unknown (no run with random initialization at " << coldInfoFile << ")" << endl << endl;
+  }
+}
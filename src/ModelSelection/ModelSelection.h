@@ -15,6 +15,8 @@
 // functions for doing model selection using either a validation set or by using
 // cross validation
 
+#include <iostream>
+
 #include "DataManager.h"
 #include "ConditionalRandomField.h"
 #include "Types.h"
@@ -24,6 +26,8 @@
 #include "Learning/GradientDescent.h"
 #include "Learning/StochasticGradientDescent.h"
 
+class CoarseToFine;
+
 
 // perform model selection on validation set
 // min and max determines the power of 2 to be used such that the range of
@@ -72,3 +76,41 @@ double modelSelectionStochastic(DataManager &trainingSet,
                       int folds,
                       int min, 
                       int max);*/
+
+// remove an option without value (e.g. --resume) from the arguments of a
+// program and return whether it was given
+bool takeOption(int &argc, char **argv, const std::string &option);
+
+// remove an option and its value (e.g. --schedule 32:1e-2,16:1e-3) from the
+// arguments of a program and return whether it was given
+bool takeOption(int &argc, char **argv, const std::string &option, std::string &value);
+
+// parse the stages of a coarse-to-fine schedule given as a comma separated
+// list of stepSize:tolerance (returns false if it is malformed)
+bool parseSchedule(const std::string &schedule, Ivector &stepSizes, Dvector &tolerances);
+
+// parse the early stopping option interval:patience:sampleSize of the
+// validation monitor (returns false if it is malformed)
+bool parseEarlyStopping(const std::string &option, int &interval, int &patience, int &sampleSize);
+
+// print the learning (wall) time and the validation AUC after each stage of
+// the last run of a coarse-to-fine schedule to an info file
+void printStages(std::ostream &infostream, CoarseToFine &c2f, DataManager &validationSet);
+
+// weights to start learning the log-likelihood at: learned from initial by
+// L-BFGS on the pseudo-likelihood ("pseudo") or the piecewise log-likelihood
+// ("piecewise") of the training set, or loaded from a weight file (any other
+// source). Returns the number of evaluations of the cheap objective (0 for a
+// file). Throws FILE_NOT_FOUND if the file can not be read
+int warmStart(const std::string &source, DataManager &trainingSet, int stepSize, double lambda,
+              const Weights &initial, const std::string &tempWeightsPath, Weights &warm);
+
+// read the value of a line "key : value" of an info file
+// (returns false if the file or the line is missing)
+bool readInfoValue(const std::string &infoFile, const std::string &key, double &value);
+
+// print the cost of a warm start and the evaluations (or epochs) it saved
+// compared to the run with random initial weights in coldInfoFile, read from
+// its line given by key
+void printWarmStart(std::ostream &infostream, const std::string &source, int warmEvaluations, double warmTime,
+                    const std::string &coldInfoFile, const std::string &key, int evaluations);
@@ -22,6 +22,7 @@
 
 #include "DataManager.h"
 #include "ConditionalRandomField.h"
+#include "IntegralHistogramCache.h"
 #include "Types.h"
 
 #include "Inference/GibbsSampler.h"
@@ -30,29 +31,67 @@
 #include "ObjectiveFunctions/SampledGradient.h"
 
 #include "Learning/ContrastiveDivergence.h"
+#include "Learning/CoarseToFine.h"
 
 #include "Measures/LossMeasures.h"
+#include "Measures/ValidationMonitor.h"
+#include "ModelSelection/ModelSelection.h"
 
 using namespace std;
 
 
 void usage() {
-  cout << "modelSelectionCD [rootpath] [object] [stepSize] [lambda] [maxEpochs] [intialEta] [constantEta] [numSteps]" << endl;
+  cout << "modelSelectionCD [rootpath] [object] [stepSize] [lambda] [maxEpochs] [intialEta] [constantEta] [numSteps] ([cacheDir] [batchSize] [numChains] [background] [progressSample]) [--resume] [--schedule stages] [--early-stop interval:patience:sample]" << endl;
   cout << "Options:" << endl;
   cout << "  maxEpochs        : number of epochs to run " << endl;
   cout << "  initialEta       : value of initial eta when testing " << endl;
   cout << "  constantEta      : use constant eta or not" << endl;
   cout << "  numSteps         : number of Gibbs chain steps" << endl; 
+  cout << "  cacheDir         : directory for integral histogram cache files (optional, none for no cache)" << endl;
+  cout << "  batchSize        : number of images per step (default: 1)" << endl;
+  cout << "  numChains        : persistent Gibbs chains per image (default: 0, CD-k from the ground truth)" << endl;
+  cout << "  background       : evaluate the progress after each epoch in the background (default: 0)" << endl;
+  cout << "  progressSample   : number of images the progress is estimated from (default: 0, all images)" << endl;
+  cout << "  --resume         : continue from the checkpoint of an earlier run with the same arguments" << endl;
+  cout << "  --schedule       : train at coarser step sizes first, e.g. 32:2,16:2 (stepSize:epochs), then at stepSize" << endl;
+  cout << "  --early-stop     : stop when the validation AUC, computed every interval epochs on sample images (0 for all)," << endl;
+  cout << "                     has not improved for patience validations, and keep the best weights, e.g. 1:3:100" << endl;
 }
 
 // chooses the objective, gradient and learning algorithm based on the input
 int main(int argc, char **argv) {
 
+  // continue an earlier run from its checkpoint
+  bool resume = takeOption(argc, argv, "--resume");
+
+  // coarse-to-fine stages before the stage at stepSize
+  string schedule;
+  Ivector scheduleStepSizes;
+  Dvector scheduleTolerances;
+  bool coarseToFine = takeOption(argc, argv, "--schedule", schedule);
+
+  // early stopping on the validation set
+  string earlyStop;
+  int validationInterval, validationPatience, validationSample;
+  bool earlyStopping = takeOption(argc, argv, "--early-stop", earlyStop);
+
   // ensure correct number of arguments
   if (argc < 9) {
     usage();  
     return -1;
   }
+  if (coarseToFine && !parseSchedule(schedule, scheduleStepSizes, scheduleTolerances)) {
+    usage();
+    return -1;
+  }
+  if (earlyStopping && !parseEarlyStopping(earlyStop, validationInterval, validationPatience, validationSample)) {
+    usage();
+    return -1;
+  }
+  if (coarseToFine && resume) {
+    cerr << "A coarse-to-fine run can not be resumed" << endl;
+    return -1;
+  }
 
   // parse input
   string rootPath     = string(argv[1]);
@@ -63,12 +102,29 @@ int main(int argc, char **argv) {
   double initialEta   = atof(argv[6]);
   bool constantEta    = false;
   int numSteps        = atoi(argv[8]);
+  int batchSize       = 1;
+  int numChains       = 0;
+  bool background     = false;
+  int progressSample  = 0;
 
 
   if (atoi(argv[7]) != 0) {
     cout << "Constant eta" << endl;
     constantEta = true;
   }
+
+  if (argc > 10) {
+    batchSize = atoi(argv[10]);
+  }
+  if (argc > 11) {
+    numChains = atoi(argv[11]);
+  }
+  if (argc > 12) {
+    background = atoi(argv[12]) != 0;
+  }
+  if (argc > 13) {
+    progressSample = atoi(argv[13]);
+  }
   
   // make lower case
   transform(object.begin(), object.end(), object.begin(), ::tolower);
@@ -108,41 +164,73 @@ int main(int argc, char **argv) {
   int weightDim = 3000;
   ConditionalRandomField crf(&datamanTrain);
   crf.setStepSize(stepSize);
+
+  // images are visited repeatedly, update their integral images when few weights changed
+  crf.setIncrementalIntegralImages(true);
   LogLikelihood loglik(&datamanTrain, &crf);
   
   GibbsSampler gibbs(&crf);
   SampledGradient loglikgrad(&datamanTrain, &crf, &gibbs);
   loglikgrad.setSkip(numSteps);
 
+  // map precomputed integral histograms of the training set
+  // (the file is built on the first run and reused by later runs)
+  IntegralHistogramCache histogramCache;
+  string cacheInfo = "none";
+  if (argc > 9 && string(argv[9]).compare("none") != 0) {
+    string cacheFile = IntegralHistogramCache::getFileName(string(argv[9]), &datamanTrain, stepSize);
+    try {
+      histogramCache.open(cacheFile, &datamanTrain, stepSize);
+    }
+    catch (int e) {
+      cerr << "Could not create integral histogram cache " << cacheFile << endl;
+      return e;
+    }
+    crf.setIntegralHistogramCache(&histogramCache);
+
+    ostringstream cs;
+    cs << cacheFile << (histogramCache.wasRebuilt() ? " (built in " : " (mapped in ")
+       << histogramCache.getOpenTime() << " s, " << histogramCache.getBytes()/(1024.*1024.) << " MB)";
+    cacheInfo = cs.str();
+    cout << "Integral histogram cache: " << cacheInfo << endl;
+  }
+
   // set lambda
   loglik.setLambda(lambda);
   loglikgrad.setLambda(lambda);
  
   
   // setup log files and info file
+  // (coarse-to-fine runs are stored next to the runs at a single step size)
+  string tag = coarseToFine ? "_c2f" : "";
   ostringstream os;
-  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << "_info.txt";
+  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << tag << "_info.txt";
   string infoFile = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << "_weights.txt";
+  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << tag << "_weights.txt";
   string weightFile = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << "_tempWeights.txt";
+  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << tag << "_tempWeights.txt";
   string tempWeightFile = os.str();
+
+  os.clear();
+  os.str("");
+  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << tag << "_checkpoint.bin";
+  string checkpointFile = os.str();
   
   // recall overlap figures
   os.clear();
   os.str("");
-  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << "_recallOverlapTrain";
+  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << tag << "_recallOverlapTrain";
   string lossTrain = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << "_recallOverlapVal";
+  os << rootPath << "/results/cd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_" << numSteps << tag << "_recallOverlapVal";
   string lossVal = os.str();
 
   // print info for model selection run
@@ -157,6 +245,15 @@ int main(int argc, char **argv) {
   infostream << "Initial eta             : " << initialEta << "\n";
   infostream << "Constant eta            : " << constantEta << "\n";
   infostream << "Number of steps         : " << numSteps << "\n";
+  infostream << "Histogram cache         : " << cacheInfo << "\n";
+  infostream << "Batch size              : " << batchSize << "\n";
+  infostream << "Persistent chains       : " << numChains << "\n";
+  if (coarseToFine) {
+    infostream << "Schedule                : " << schedule << "," << stepSize << ":" << maxEpochs << "\n";
+  }
+  if (earlyStopping) {
+    infostream << "Early stopping          : " << earlyStop << " (interval:patience:sample)\n";
+  }
   infostream.close();
  
 
@@ -172,10 +269,31 @@ int main(int argc, char **argv) {
   crf.setWeights(initialW);
 
   // create learning algorithm
+  // (its constructor sets the number of Gibbs steps to 1)
   ContrastiveDivergence cd(&loglik, &loglikgrad);
+  loglikgrad.setSkip(numSteps);
+  loglikgrad.setNumChains(numChains);
   cd.setMaxEpochs(maxEpochs);
   cd.setAlpha(lambda);
   cd.setTempWeightsPath(tempWeightFile);
+  cd.setBatchSize(batchSize);
+  cd.setBackgroundProgress(background);
+  cd.setProgressSampleSize(progressSample);
+  cd.setCheckpointPath(checkpointFile);
+
+  // (the persistent chains follow the grid of each stage)
+  CoarseToFine c2f(&crf, &cd);
+  for (size_t k=0; k<scheduleStepSizes.size(); k++) {
+    c2f.addStage(scheduleStepSizes[k], scheduleTolerances[k]);
+  }
+  c2f.addStage(stepSize, maxEpochs);
+
+  // validation monitor for early stopping
+  ValidationMonitor *monitor = NULL;
+  if (earlyStopping) {
+    monitor = new ValidationMonitor(&datamanVal, validationInterval, validationPatience, validationSample);
+    cd.setValidationHook(monitor);
+  }
   
   // perform model selection
   double start, stop;
@@ -184,8 +302,19 @@ int main(int argc, char **argv) {
   // initialize learning rate
   try {
     start = gettime();
-    cd.initializeLearningRate(initialW, initialEta, 0, true);
-    wNew = cd.learnWeights(initialW);
+    if (resume) {
+      cout << "Resuming from " << checkpointFile << endl;
+      cd.resume(checkpointFile);
+    } else {
+      // (at the step size of the first stage)
+      crf.setStepSize(c2f.getStepSize(0));
+      cd.initializeLearningRate(initialW, initialEta, 0, true);
+    }
+    if (coarseToFine) {
+      wNew = c2f.learnWeights(initialW);
+    } else {
+      wNew = cd.learnWeights(initialW);
+    }
     stop = gettime();
   } 
   catch (int e) {
@@ -213,9 +342,20 @@ int main(int argc, char **argv) {
   infostream << "alpha                   : " << alpha << endl;
   infostream << "t0                      : " << t0 << endl;
   infostream << "eta                     : " << eta << endl;
-  infostream << "Time taken              : " << stop-start << endl << endl;
+  infostream << "Time taken              : " << stop-start << endl;
+  infostream << "Integral images (incremental/full) : " << crf.getIntegralImageStore()->getNumIncremental()
+             << "/" << crf.getIntegralImageStore()->getNumFull() << endl << endl;
   infostream << "AUC train               : " << recallOverlapTrain.AUC << endl;
   infostream << "AUC val                 : " << recallOverlapVal.AUC << endl << endl;
+
+  // time and validation AUC after each stage (for comparing with training at a single step size)
+  if (coarseToFine) {
+    printStages(infostream, c2f, datamanVal);
+  }
+  if (monitor != NULL) {
+    infostream << "Best validation AUC     : " << monitor->getBestAUC() << " at " << monitor->getBestStep();
+    infostream << (monitor->stoppedEarly() ? " (stopped early)" : "") << endl << endl;
+  }
   
   // create figures 
   printRecallOverlap(lossTrain, recallOverlapTrain);
@@ -247,6 +387,7 @@ int main(int argc, char **argv) {
   }
   weightFileStream.close();
   
+  delete monitor;
   cout << "Done!" << endl;  
 
   return 0;
@@ -18,6 +18,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <iomanip>
 #include <algorithm>
 
 #include "DataManager.h"
@@ -28,27 +29,72 @@
 #include "ObjectiveFunctions/LogLikelihoodGradient.h"
 
 #include "Learning/LBFGS.h"
+#include "Learning/CoarseToFine.h"
 
 #include "Measures/LossMeasures.h"
+#include "Measures/ValidationMonitor.h"
+#include "ModelSelection/ModelSelection.h"
 
 using namespace std;
 
 
 void usage() {
-  cout << "modelSelectionLBFGS [rootpath] [object] [stepSize] [lambda] [kickstart] [weightpath]" << endl;
+  cout << "modelSelectionLBFGS [rootpath] [object] [stepSize] [lambda] [kickstart] [weightpath] [--resume] [--schedule stages] [--early-stop interval:patience:sample] [--warm-start source]" << endl;
   cout << "Options:" << endl;
   cout << "  kickStart        : algorithm to find good start weights, for example SGD" << endl;
   cout << "  path             : path to already computed weights" << endl;
+  cout << "  --resume         : continue from the checkpoint of an earlier run with the same arguments" << endl;
+  cout << "                     (L-BFGS starts again without its curvature pairs, so the iterations" << endl;
+  cout << "                     after resuming differ from those of an uninterrupted run)" << endl;
+  cout << "  --schedule       : train at coarser step sizes first, e.g. 32:1e-2,16:1e-3 (stepSize:epsilon), then at stepSize" << endl;
+  cout << "  --early-stop     : stop when the validation AUC, computed every interval iterations on sample images (0 for all)," << endl;
+  cout << "                     has not improved for patience validations, and keep the best weights, e.g. 1:3:100" << endl;
+  cout << "  --warm-start     : start at the weights learned with the pseudo-likelihood (pseudo) or the piecewise" << endl;
+  cout << "                     log-likelihood (piecewise), or at the weights in a file, e.g. weights/piecewise/..." << endl;
 }
 
 // chooses the objective, gradient and learning algorithm based on the input
 int main(int argc, char **argv) {
 
+  // continue an earlier run from its checkpoint
+  bool resume = takeOption(argc, argv, "--resume");
+
+  // coarse-to-fine stages before the stage at stepSize
+  string schedule;
+  Ivector scheduleStepSizes;
+  Dvector scheduleTolerances;
+  bool coarseToFine = takeOption(argc, argv, "--schedule", schedule);
+
+  // early stopping on the validation set
+  string earlyStop;
+  int validationInterval, validationPatience, validationSample;
+  bool earlyStopping = takeOption(argc, argv, "--early-stop", earlyStop);
+
+  // warm start from a cheap objective or a weight file
+  string warmSource;
+  bool warm = takeOption(argc, argv, "--warm-start", warmSource);
+
   // ensure correct number of arguments
   if (argc < 5) {
     usage();  
     return -1;
   }
+  if (coarseToFine && !parseSchedule(schedule, scheduleStepSizes, scheduleTolerances)) {
+    usage();
+    return -1;
+  }
+  if (earlyStopping && !parseEarlyStopping(earlyStop, validationInterval, validationPatience, validationSample)) {
+    usage();
+    return -1;
+  }
+  if (coarseToFine && resume) {
+    cerr << "A coarse-to-fine run can not be resumed" << endl;
+    return -1;
+  }
+  if (warm && resume) {
+    cerr << "A resumed run continues from its checkpoint, not a warm start" << endl;
+    return -1;
+  }
 
   // parse input
   string rootPath     = string(argv[1]);
@@ -62,6 +108,10 @@ int main(int argc, char **argv) {
     kickstart = true;
     initWPath = string(argv[6]);
   }
+  if (warm && kickstart) {
+    cerr << "Use either kickstart or --warm-start" << endl;
+    return -1;
+  }
   
   // make lower case
   transform(object.begin(), object.end(), object.begin(), ::tolower);
@@ -110,29 +160,51 @@ int main(int argc, char **argv) {
 
   
   // setup log files and info file
+  // (coarse-to-fine and warm started runs are stored next to the others, and
+  // a warm started run is compared to the run with random initial weights)
+  string coldTag = coarseToFine ? "_c2f" : "";
+  string tag = coldTag;
+  if (warm) {
+    tag += "_warm_" + (warmSource == "pseudo" || warmSource == "piecewise" ? warmSource : string("file"));
+  }
   ostringstream os;
-  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << "_info.txt";
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << tag << "_info.txt";
   string infoFile = os.str();
+
+  os.clear();
+  os.str("");
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << coldTag << "_info.txt";
+  string coldInfoFile = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << "_weights.txt";
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << tag << "_weights.txt";
   string weightFile = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << "_tempWeights.txt";
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << tag << "_tempWeights.txt";
   string tempWeightFile = os.str();
+
+  os.clear();
+  os.str("");
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << tag << "_warmTempWeights.txt";
+  string warmTempWeightFile = os.str();
+
+  os.clear();
+  os.str("");
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << tag << "_checkpoint.bin";
+  string checkpointFile = os.str();
   
   // recall overlap figures
   os.clear();
   os.str("");
-  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << "_recallOverlapTrain";
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << tag << "_recallOverlapTrain";
   string lossTrain = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << "_recallOverlapVal";
+  os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << tag << "_recallOverlapVal";
   string lossVal = os.str();
 
   // print info for model selection run
@@ -144,6 +216,15 @@ int main(int argc, char **argv) {
   infostream << "Step size               : " << stepSize << "\n";
   infostream << "Lambda                  : " << lambda << "\n";
   infostream << "Kickstart               : " << kickstart << " " << initWPath << "\n";
+  if (coarseToFine) {
+    infostream << "Schedule                : " << schedule << "," << stepSize << "\n";
+  }
+  if (earlyStopping) {
+    infostream << "Early stopping          : " << earlyStop << " (interval:patience:sample)\n";
+  }
+  if (warm) {
+    infostream << "Warm start              : " << warmSource << "\n";
+  }
   infostream.close();
  
 
@@ -165,16 +246,57 @@ int main(int argc, char **argv) {
     crf.setWeights(initialW);
   }
 
+  // continue from the weights of the cheap objective
+  int warmEvaluations = 0;
+  double warmTime = 0.0;
+  if (warm) {
+    cout << "Warm start from " << warmSource << endl;
+    Weights warmW;
+    try {
+      warmTime = getwalltime();
+      warmEvaluations = warmStart(warmSource, datamanTrain, stepSize, lambda, initialW, warmTempWeightFile, warmW);
+      warmTime = getwalltime() - warmTime;
+    }
+    catch (int e) {
+      cerr << "There was an error with error code " << e << endl;
+      return e;
+    }
+    initialW = warmW;
+    crf.setWeights(initialW);
+  }
+
   // create learning algorithm
   LBFGS lbfgs(&loglik, &loglikgrad);
   lbfgs.setTempWeightsPath(tempWeightFile);
+  lbfgs.setCheckpointPath(checkpointFile);
+
+  CoarseToFine c2f(&crf, &lbfgs);
+  for (size_t k=0; k<scheduleStepSizes.size(); k++) {
+    c2f.addStage(scheduleStepSizes[k], scheduleTolerances[k]);
+  }
+  c2f.addStage(stepSize, lbfgs.getEpsilon());
+
+  // validation monitor for early stopping
+  ValidationMonitor *monitor = NULL;
+  if (earlyStopping) {
+    monitor = new ValidationMonitor(&datamanVal, validationInterval, validationPatience, validationSample);
+    lbfgs.setValidationHook(monitor);
+  }
 
   // perform model selection
   double start, stop;
   Weights wNew;
   try {
     start = gettime();
-    wNew = lbfgs.learnWeights(initialW);
+    if (resume) {
+      cout << "Resuming from " << checkpointFile << endl;
+      lbfgs.resume(checkpointFile);
+    }
+    if (coarseToFine) {
+      wNew = c2f.learnWeights(initialW);
+    } else {
+      wNew = lbfgs.learnWeights(initialW);
+    }
     stop = gettime();
   } 
   catch (int e) {
@@ -194,11 +316,27 @@ int main(int argc, char **argv) {
   RecallOverlap recallOverlapVal;
   recallOverlapVal = computeRecallOverlap(datamanVal, indices, 1, false);
 
+  // objective evaluations of all stages of a coarse-to-fine run
+  int evaluations = coarseToFine ? c2f.getTotalWork() : lbfgs.getFunctionEvaluations();
+
   infostream.open(infoFile.c_str(), ios_base::app);
   infostream << "Iterations              : " << lbfgs.getIterations() << endl;
+  infostream << "Function evaluations    : " << evaluations << endl;
   infostream << "Time taken              : " << stop-start << endl << endl;
   infostream << "AUC train               : " << recallOverlapTrain.AUC << endl;
   infostream << "AUC val                 : " << recallOverlapVal.AUC << endl << endl;
+
+  // time and validation AUC after each stage (for comparing with training at a single step size)
+  if (coarseToFine) {
+    printStages(infostream, c2f, datamanVal);
+  }
+  if (monitor != NULL) {
+    infostream << "Best validation AUC     : " << monitor->getBestAUC() << " at " << monitor->getBestStep();
+    infostream << (monitor->stoppedEarly() ? " (stopped early)" : "") << endl << endl;
+  }
+  if (warm) {
+    printWarmStart(infostream, warmSource, warmEvaluations, warmTime, coldInfoFile, "Function evaluations", evaluations);
+  }
   
   // create figures 
   printRecallOverlap(lossTrain, recallOverlapTrain);
@@ -230,6 +368,7 @@ int main(int argc, char **argv) {
   }
   weightFileStream.close();
   
+  delete monitor;
   cout << "Done!" << endl;  
 
   return 0;
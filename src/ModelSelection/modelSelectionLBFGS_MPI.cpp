@@ -117,6 +117,9 @@ int main(int argc, char **argv) {
   loglik.setLambda(lambda);
   loglikgrad.setLambda(lambda);
 
+  // one process per core, so each process evaluates its images serially
+  loglik.setNumThreads(1);
+
   // setup log files and info file
   ostringstream os;
   os << rootPath << "/results/lbfgs/" << object << "_" << stepSize << "_" << lambda << "_info.txt";
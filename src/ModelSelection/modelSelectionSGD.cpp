@@ -28,28 +28,78 @@
 #include "ObjectiveFunctions/StochasticGradient.h"
 
 #include "Learning/StochasticGradientDescent.h"
+#include "Learning/AdaGrad.h"
+#include "Learning/Adam.h"
+#include "Learning/CoarseToFine.h"
 
 #include "Measures/LossMeasures.h"
+#include "Measures/ValidationMonitor.h"
+#include "ModelSelection/ModelSelection.h"
 
 using namespace std;
 
 
 void usage() {
-  cout << "modelSelectionSGD [rootpath] [object] [stepSize] [lambda] [maxEpochs] [intialEta] [constantEta]" << endl;
+  cout << "modelSelectionSGD [rootpath] [object] [stepSize] [lambda] [maxEpochs] [intialEta] [constantEta] ([averageStart] [learner] [batchSize] [background] [progressSample]) [--resume] [--schedule stages] [--early-stop interval:patience:sample] [--warm-start source]" << endl;
   cout << "Options:" << endl;
   cout << "  maxEpochs        : number of epochs to run " << endl;
-  cout << "  initialEta       : value of initial eta when testing " << endl;
+  cout << "  initialEta       : value of initial eta when testing (base learning rate of adagrad/adam)" << endl;
   cout << "  constantEta      : use constant eta or not" << endl;
+  cout << "  averageStart     : epoch from which the weights are averaged (ASGD, default: last epoch)" << endl;
+  cout << "  learner          : sgd (default), adagrad or adam (no learning rate search)" << endl;
+  cout << "  batchSize        : number of images per step (default: 1)" << endl;
+  cout << "  background       : evaluate the progress after each epoch in the background (default: 0)" << endl;
+  cout << "  progressSample   : number of images the progress is estimated from (default: 0, all images)" << endl;
+  cout << "  --resume         : continue from the checkpoint of an earlier run with the same arguments" << endl;
+  cout << "  --schedule       : train at coarser step sizes first, e.g. 32:2,16:2 (stepSize:epochs), then at stepSize" << endl;
+  cout << "  --early-stop     : stop when the validation AUC, computed every interval epochs on sample images (0 for all)," << endl;
+  cout << "                     has not improved for patience validations, and keep the best weights, e.g. 1:3:100" << endl;
+  cout << "  --warm-start     : start at the weights learned with the pseudo-likelihood (pseudo) or the piecewise" << endl;
+  cout << "                     log-likelihood (piecewise), or at the weights in a file, e.g. weights/piecewise/..." << endl;
 }
 
 // chooses the objective, gradient and learning algorithm based on the input
 int main(int argc, char **argv) {
 
+  // continue an earlier run from its checkpoint
+  bool resume = takeOption(argc, argv, "--resume");
+
+  // coarse-to-fine stages before the stage at stepSize
+  string schedule;
+  Ivector scheduleStepSizes;
+  Dvector scheduleTolerances;
+  bool coarseToFine = takeOption(argc, argv, "--schedule", schedule);
+
+  // early stopping on the validation set
+  string earlyStop;
+  int validationInterval, validationPatience, validationSample;
+  bool earlyStopping = takeOption(argc, argv, "--early-stop", earlyStop);
+
+  // warm start from a cheap objective or a weight file
+  string warmSource;
+  bool warm = takeOption(argc, argv, "--warm-start", warmSource);
+
   // ensure correct number of arguments
   if (argc < 8) {
     usage();  
     return -1;
   }
+  if (coarseToFine && !parseSchedule(schedule, scheduleStepSizes, scheduleTolerances)) {
+    usage();
+    return -1;
+  }
+  if (earlyStopping && !parseEarlyStopping(earlyStop, validationInterval, validationPatience, validationSample)) {
+    usage();
+    return -1;
+  }
+  if (coarseToFine && resume) {
+    cerr << "A coarse-to-fine run can not be resumed" << endl;
+    return -1;
+  }
+  if (warm && resume) {
+    cerr << "A resumed run continues from its checkpoint, not a warm start" << endl;
+    return -1;
+  }
 
   // parse input
   string rootPath     = string(argv[1]);
@@ -59,11 +109,33 @@ int main(int argc, char **argv) {
   int maxEpochs       = atoi(argv[5]);
   double initialEta   = atof(argv[6]);
   bool constantEta    = false;
+  int averageStart    = 0;
+  string learner      = "sgd";
+  int batchSize       = 1;
+  bool background     = false;
+  int progressSample  = 0;
 
   if (atoi(argv[7]) != 0) {
     cout << "Constant eta" << endl;
     constantEta = true;
   }
+
+  if (argc > 8) {
+    averageStart = atoi(argv[8]);
+  }
+  if (argc > 9) {
+    learner = string(argv[9]);
+    transform(learner.begin(), learner.end(), learner.begin(), ::tolower);
+  }
+  if (argc > 10) {
+    batchSize = atoi(argv[10]);
+  }
+  if (argc > 11) {
+    background = atoi(argv[11]) != 0;
+  }
+  if (argc > 12) {
+    progressSample = atoi(argv[12]);
+  }
   
   // make lower case
   transform(object.begin(), object.end(), object.begin(), ::tolower);
@@ -103,6 +175,9 @@ int main(int argc, char **argv) {
   int weightDim = 3000;
   ConditionalRandomField crf(&datamanTrain);
   crf.setStepSize(stepSize);
+
+  // images are visited repeatedly, update their integral images when few weights changed
+  crf.setIncrementalIntegralImages(true);
   LogLikelihood loglik(&datamanTrain, &crf);
   StochasticGradient loglikgrad(&datamanTrain, &crf);
 
@@ -112,34 +187,56 @@ int main(int argc, char **argv) {
 
   
   // setup log files and info file
+  // (coarse-to-fine and warm started runs are stored next to the others, and
+  // a warm started run is compared to the run with random initial weights)
+  string coldTag = coarseToFine ? "_c2f" : "";
+  string tag = coldTag;
+  if (warm) {
+    tag += "_warm_" + (warmSource == "pseudo" || warmSource == "piecewise" ? warmSource : string("file"));
+  }
   ostringstream os;
-  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_info.txt";
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << tag << "_info.txt";
   string infoFile = os.str();
+
+  os.clear();
+  os.str("");
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << coldTag << "_info.txt";
+  string coldInfoFile = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_weights.txt";
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << tag << "_weights.txt";
   string weightFile = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_tempWeights.txt";
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << tag << "_tempWeights.txt";
   string tempWeightFile = os.str();
+
+  os.clear();
+  os.str("");
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << tag << "_warmTempWeights.txt";
+  string warmTempWeightFile = os.str();
+
+  os.clear();
+  os.str("");
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << tag << "_checkpoint.bin";
+  string checkpointFile = os.str();
   
   // recall overlap figures
   os.clear();
   os.str("");
-  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_recallOverlapTrain";
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << tag << "_recallOverlapTrain";
   string lossTrain = os.str();
   
   os.clear();
   os.str("");
-  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << "_recallOverlapVal";
+  os << rootPath << "/results/sgd/" << object << "_" << stepSize << "_" << lambda << "_" << maxEpochs << tag << "_recallOverlapVal";
   string lossVal = os.str();
 
   // print info for model selection run
   ofstream infostream(infoFile.c_str());
-  infostream << "Learning algorithm      : StochasticGradientDescent\n";
+  infostream << "Learning algorithm      : StochasticGradientDescent (" << learner << ")\n";
   infostream << "Objective function      : LogLikelihood\n";
   infostream << "Gradient                : StochasticGradient\n";
   infostream << "Object                  : " << object << "\n";
@@ -148,6 +245,17 @@ int main(int argc, char **argv) {
   infostream << "Max epochs              : " << maxEpochs << "\n";
   infostream << "Initial eta             : " << initialEta << "\n";
   infostream << "Constant eta            : " << constantEta << "\n";
+  infostream << "Average from epoch      : " << (averageStart > 0 ? averageStart : maxEpochs) << "\n";
+  infostream << "Batch size              : " << batchSize << "\n";
+  if (coarseToFine) {
+    infostream << "Schedule                : " << schedule << "," << stepSize << ":" << maxEpochs << "\n";
+  }
+  if (earlyStopping) {
+    infostream << "Early stopping          : " << earlyStop << " (interval:patience:sample)\n";
+  }
+  if (warm) {
+    infostream << "Warm start              : " << warmSource << "\n";
+  }
   infostream.close();
  
 
@@ -162,11 +270,57 @@ int main(int argc, char **argv) {
   }
   crf.setWeights(initialW);
 
+  // continue from the weights of the cheap objective
+  // (the learning rate is initialized at them)
+  int warmEvaluations = 0;
+  double warmTime = 0.0;
+  if (warm) {
+    cout << "Warm start from " << warmSource << endl;
+    Weights warmW;
+    try {
+      warmTime = getwalltime();
+      warmEvaluations = warmStart(warmSource, datamanTrain, stepSize, lambda, initialW, warmTempWeightFile, warmW);
+      warmTime = getwalltime() - warmTime;
+    }
+    catch (int e) {
+      cerr << "There was an error with error code " << e << endl;
+      return e;
+    }
+    initialW = warmW;
+    crf.setWeights(initialW);
+  }
+
   // create learning algorithm
-  StochasticGradientDescent sgd(&loglik, &loglikgrad);
-  sgd.setMaxEpochs(maxEpochs);
-  sgd.setAlpha(lambda);
-  sgd.setTempWeightsPath(tempWeightFile);
+  // (adaptive learners use initialEta as base learning rate and need no search)
+  StochasticGradientDescent *sgd;
+  if (learner.compare("adagrad") == 0) {
+    sgd = new AdaGrad(&loglik, &loglikgrad, initialEta);
+  } else if (learner.compare("adam") == 0) {
+    sgd = new Adam(&loglik, &loglikgrad, initialEta);
+  } else {
+    sgd = new StochasticGradientDescent(&loglik, &loglikgrad);
+  }
+  sgd->setMaxEpochs(maxEpochs);
+  sgd->setAlpha(lambda);
+  sgd->setAverageStartEpoch(averageStart);
+  sgd->setBatchSize(batchSize);
+  sgd->setBackgroundProgress(background);
+  sgd->setProgressSampleSize(progressSample);
+  sgd->setTempWeightsPath(tempWeightFile);
+  sgd->setCheckpointPath(checkpointFile);
+
+  CoarseToFine c2f(&crf, sgd);
+  for (size_t k=0; k<scheduleStepSizes.size(); k++) {
+    c2f.addStage(scheduleStepSizes[k], scheduleTolerances[k]);
+  }
+  c2f.addStage(stepSize, maxEpochs);
+
+  // validation monitor for early stopping
+  ValidationMonitor *monitor = NULL;
+  if (earlyStopping) {
+    monitor = new ValidationMonitor(&datamanVal, validationInterval, validationPatience, validationSample);
+    sgd->setValidationHook(monitor);
+  }
 
   // perform model selection
   double start, stop;
@@ -175,8 +329,19 @@ int main(int argc, char **argv) {
   // initialize learning rate
   try {
     start = gettime();
-    sgd.initializeLearningRate(initialW, initialEta, 0, true);
-    wNew = sgd.learnWeights(initialW);
+    if (resume) {
+      cout << "Resuming from " << checkpointFile << endl;
+      sgd->resume(checkpointFile);
+    } else if (learner.compare("sgd") == 0) {
+      // (at the step size of the first stage)
+      crf.setStepSize(c2f.getStepSize(0));
+      sgd->initializeLearningRate(initialW, initialEta, 0, true);
+    }
+    if (coarseToFine) {
+      wNew = c2f.learnWeights(initialW);
+    } else {
+      wNew = sgd->learnWeights(initialW);
+    }
     stop = gettime();
   } 
   catch (int e) {
@@ -196,17 +361,35 @@ int main(int argc, char **argv) {
   RecallOverlap recallOverlapVal;
   recallOverlapVal = computeRecallOverlap(datamanVal, indices, 1, false);
   
-  double alpha  = sgd.getAlpha();
-  double t0     = sgd.getT0();
-  double eta    = 1.0/(alpha*t0);
+  double alpha  = sgd->getAlpha();
+  double t0     = sgd->getT0();
+  double eta    = (learner.compare("sgd") == 0) ? 1.0/(alpha*t0) : initialEta;
+
+  // epochs of all stages of a coarse-to-fine run
+  int epochs = coarseToFine ? c2f.getTotalWork() : sgd->getEpochs();
 
   infostream.open(infoFile.c_str(), ios_base::app);
   infostream << "alpha                   : " << alpha << endl;
   infostream << "t0                      : " << t0 << endl;
   infostream << "eta                     : " << eta << endl;
-  infostream << "Time taken              : " << stop-start << endl << endl;
+  infostream << "Epochs                  : " << epochs << endl;
+  infostream << "Time taken              : " << stop-start << endl;
+  infostream << "Integral images (incremental/full) : " << crf.getIntegralImageStore()->getNumIncremental()
+             << "/" << crf.getIntegralImageStore()->getNumFull() << endl << endl;
   infostream << "AUC train               : " << recallOverlapTrain.AUC << endl;
   infostream << "AUC val                 : " << recallOverlapVal.AUC << endl << endl;
+
+  // time and validation AUC after each stage (for comparing with training at a single step size)
+  if (coarseToFine) {
+    printStages(infostream, c2f, datamanVal);
+  }
+  if (monitor != NULL) {
+    infostream << "Best validation AUC     : " << monitor->getBestAUC() << " at " << monitor->getBestStep();
+    infostream << (monitor->stoppedEarly() ? " (stopped early)" : "") << endl << endl;
+  }
+  if (warm) {
+    printWarmStart(infostream, warmSource, warmEvaluations, warmTime, coldInfoFile, "Epochs", epochs);
+  }
   
   // create figures 
   printRecallOverlap(lossTrain, recallOverlapTrain);
@@ -237,7 +420,9 @@ int main(int argc, char **argv) {
     weightFileStream << wNew[i] << "\n";
   }
   weightFileStream.close();
+  delete sgd;
   
+  delete monitor;
   cout << "Done!" << endl;  
 
   return 0;
@@ -23,7 +23,7 @@ using namespace std;
 
 // constructor
 Gradient::Gradient(DataManager *dm, ConditionalRandomField *crfield, SearchIx si)
-  : dataManager(dm), crf(crfield), searchIx(si)
+  : dataManager(dm), crf(crfield), searchIx(si), empiricalStepSize(0)
 {
   // if no search indices are defined, use the whole dataset
   if (dm != NULL && searchIx.empty()) {
@@ -94,6 +94,12 @@ void Gradient::computeIntegralImage(int imageNumber, Weights &w) {
   iiHeight = crf->getIntegralImageHeight();
 }
 
+void Gradient::computeIntegralImage(int imageNumber, const Weights &v, double scale) {
+  crf->computeIntegralImage(imageNumber, v, scale);
+  iiWidth = crf->getIntegralImageWidth();
+  iiHeight = crf->getIntegralImageHeight();
+}
+
 // compute integral histogram
 void Gradient::computeIntegralHistogram(int imageNumber) {
   crf->computeIntegralHistogram(imageNumber);
@@ -106,3 +112,15 @@ double Gradient::slidingWindowLogSumExp() {
   return crf->slidingWindowLogSumExp();
 }
 
+
+// sum of the ground truth feature vectors
+const Dvector &Gradient::getEmpiricalFeatures(const SearchIx &si, int weightDim) {
+  int stepSize = getStepSize();
+  if ((int) empirical.size() != weightDim || empiricalStepSize != stepSize || empiricalSearchIx != si) {
+    empirical.assign(weightDim, 0.0);
+    dataManager->addEmpiricalFeatures(empirical, si, stepSize);
+    empiricalSearchIx = si;
+    empiricalStepSize = stepSize;
+  }
+  return empirical;
+}
@@ -36,11 +36,22 @@ class Gradient {
     // for current integral image and integral histogram
     int iiWidth, iiHeight;
 
+    // sum of the ground truth feature vectors of the images in si
+    // (only recomputed when the images or the step size change)
+    const Dvector &getEmpiricalFeatures(const SearchIx &si, int weightDim);
+
+  private:
+
+    // cached empirical feature term
+    Dvector empirical;
+    SearchIx empiricalSearchIx;
+    int empiricalStepSize;
 
   public:
 
     // constructor
     Gradient(DataManager *dm=NULL, ConditionalRandomField *crfield=NULL, SearchIx si=SearchIx());
+    virtual ~Gradient() {}
 
     // getters/setters
     DataManager *getDataManager();
@@ -67,9 +78,12 @@ class Gradient {
        
     // useful functions which will be called through the CRF
     void computeIntegralImage(int imageNumber, Weights &w);
+    void computeIntegralImage(int imageNumber, const Weights &v, double scale);   // for w = scale*v
     void computeIntegralHistogram(int imageNumber);   
     double computeBboxScore(short xl, short yl, short xh, short yh);
     void computeFeatureMap(Ivector &featureMap, short xl, short yl, short xh, short yh);
+    void computeFeatureMap(Ivector &featureMap, int imageNumber, short xl, short yl, short xh, short yh);
+    void addFeatureMap(Dvector &result, double p, short xl, short yl, short xh, short yh);
     double slidingWindowLogSumExp();   
     int iiOffset(int x, int y);
 
@@ -87,6 +101,14 @@ inline void Gradient::computeFeatureMap(Ivector &featureMap, short xl, short yl,
   crf->computeFeatureMap(featureMap, xl, yl, xh, yh);
 }
 
+inline void Gradient::computeFeatureMap(Ivector &featureMap, int imageNumber, short xl, short yl, short xh, short yh) {
+  crf->computeFeatureMap(featureMap, imageNumber, xl, yl, xh, yh);
+}
+
+inline void Gradient::addFeatureMap(Dvector &result, double p, short xl, short yl, short xh, short yh) {
+  crf->addFeatureMap(result, p, xl, yl, xh, yh);
+}
+
 // convert (x,y) into 1d index
 inline int Gradient::iiOffset(int x, int y) {
   return crf->iiOffset(x,y);
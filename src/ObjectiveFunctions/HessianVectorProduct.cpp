@@ -0,0 +1,110 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+// implementation of the log-likelihood Hessian-vector product
+#include "HessianVectorProduct.h"
+
+using namespace std;
+
+// constructor
+HessianVectorProduct::HessianVectorProduct(DataManager *dm, ConditionalRandomField *crfield, SearchIx si)
+  : dataManager(dm), crf(crfield), searchIx(si), lambda(0.)
+{
+  // if no search indices are defined, use the whole dataset
+  if (dm != NULL && searchIx.empty()) {
+    searchIx = SearchIx(dm->getNumFiles());
+    for (size_t k=0; k<searchIx.size(); k++) {
+      searchIx[k] = k;
+    }
+  }
+}
+
+// getters/setters
+SearchIx HessianVectorProduct::getSearchIx() {
+  return searchIx;
+}
+
+void HessianVectorProduct::setSearchIx(SearchIx si) {
+  searchIx = si;
+}
+
+double HessianVectorProduct::getLambda() {
+  return lambda;
+}
+
+void HessianVectorProduct::setLambda(double lam) {
+  lambda = lam;
+}
+
+
+// Hessian-vector product
+void HessianVectorProduct::evaluate(Dvector &hv, Weights &w, const Dvector &v) {
+
+  int imageNumber, numObject;
+  double logZ, meanScore;
+  Bboxes &bboxes = dataManager->getBboxes();
+  int weightDim = w.size();
+
+  // check sizes
+  if (hv.size() != w.size() || v.size() != w.size()) {
+    throw GRADIENT_SIZE_ERROR;
+  }
+
+  Dvector coverage, weightedCoverage;
+  Dvector expectation, weightedExpectation;
+
+  // regularizer
+  for (int i=0; i<weightDim; i++) {
+    hv[i] = 2*lambda*v[i];
+  }
+
+  for (size_t j=0; j<searchIx.size(); j++) {
+
+    // extract image index
+    imageNumber = searchIx[j];
+    numObject = bboxes[imageNumber].numObject;
+    Image &img = dataManager->getImages()[imageNumber];
+
+    // only work on images that actually contain the object
+    if (numObject > 0) {
+
+      // integral image of v (the integral image of w is computed last,
+      // so that it is the one held by the CRF)
+      crf->computeIntegralImage(imageNumber, v);
+      directionImage = *crf->getIntegralImage();
+      crf->computeIntegralImage(imageNumber, w);
+
+      // probability of each cell being covered, without and with the box scores of v
+      logZ = crf->slidingWindowLogSumExp();
+      crf->slidingWindowCoverage(coverage, weightedCoverage, logZ, directionImage);
+
+      // E[phi] and E[phi <phi,v>] (indexed by the visual words present in the image)
+      expectation.assign(img.numClusters, 0.0);
+      weightedExpectation.assign(img.numClusters, 0.0);
+      crf->accumulateFeatureField(expectation, coverage, imageNumber);
+      crf->accumulateFeatureField(weightedExpectation, weightedCoverage, imageNumber);
+
+      // E[<phi,v>]
+      meanScore = 0.0;
+      for (int i=0; i<img.numClusters; i++) {
+        meanScore += expectation[i]*v[img.clusters[i]];
+      }
+
+      // covariance times v (once for every object)
+      for (int i=0; i<img.numClusters; i++) {
+        hv[img.clusters[i]] += numObject*(weightedExpectation[i] - expectation[i]*meanScore);
+      }
+    }
+  }
+}
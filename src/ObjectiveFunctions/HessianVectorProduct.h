@@ -0,0 +1,59 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ * 
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _HESSIAN_VECTOR_PRODUCT_H_
+#define _HESSIAN_VECTOR_PRODUCT_H_
+
+#include "DataManager.h"
+#include "ConditionalRandomField.h"
+
+// Hessian-vector product of the negative log-likelihood
+// the Hessian is 2*lambda*I plus the covariance of the feature map under the
+// model for every object, so
+//   Hv = 2*lambda*v + sum_objects E[phi <phi,v>] - E[phi] E[<phi,v>]
+// which takes one pass over the boxes of each image, like the gradient
+class HessianVectorProduct {
+
+  protected:
+
+    DataManager *dataManager;
+    ConditionalRandomField *crf;
+
+    // search index
+    SearchIx searchIx;
+    
+    // regularizer
+    double lambda;
+
+    // integral image of v
+    IntegralImage directionImage;
+
+  public:
+
+    // constructor
+    HessianVectorProduct(DataManager *dm=NULL, ConditionalRandomField *crfield=NULL, SearchIx si=SearchIx());
+
+    // getters/setters
+    SearchIx getSearchIx();
+    void setSearchIx(SearchIx si);
+
+    double getLambda();
+    void setLambda(double lambda);
+
+    // Hessian at w times v
+    void evaluate(Dvector &hv, Weights &w, const Dvector &v);
+
+};
+
+#endif // _HESSIAN_VECTOR_PRODUCT_H_
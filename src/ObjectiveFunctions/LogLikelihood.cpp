@@ -29,56 +29,25 @@ LogLikelihood::LogLikelihood(DataManager *dm, ConditionalRandomField *crfield, S
 // evaluate (specific to the actual objective function)
 double LogLikelihood::evaluate(Weights &w, bool normalized) {
 
-  int imageNumber;
-  double regularizer, dotproduct, logZ, currentLogZ;
+  double regularizer, dotproduct, logZ;
   
   int weightDim = w.size();
-  int stepSize = getStepSize(); // retrieve step size from CRF
-
-  Bboxes &bboxes = dataManager->getBboxes();
 
   // compute regularizer
+  // compute dot product with the ground truth feature vectors
+  const Dvector &empiricalFeatures = getEmpiricalFeatures(searchIx, weightDim);
   regularizer = 0.0;
+  dotproduct = 0.0;
   for (int i=0; i<weightDim; i++) {
     regularizer += w[i]*w[i];
+    dotproduct += w[i]*empiricalFeatures[i];
   }
   regularizer *= lambda;
 
-  // compute dot product with feature map
-  // compute log Z (normalizing constant)
-  dotproduct = 0.0;
-  logZ = 0.0; 
-  for (size_t i=0; i<searchIx.size(); i++) {
-
-    // extract image index
-    imageNumber = searchIx[i];
-
-    // only compute integral image when needed
-    if (bboxes[imageNumber].numObject > 0) {
-      // compute integral image
-      computeIntegralImage(imageNumber, w);
-
-      // compute logZ for current image 
-      if (normalized) {
-        currentLogZ = slidingWindowLogSumExp();
-      }
-    }
-
-    // only work on images that actually contain the object
-    for (int numObj = 0; numObj < bboxes[imageNumber].numObject; numObj++) {
-
-      // calculate score on ground truth bounding box
-      // fit to quantized integralImage space
-      // calls computeBboxScore(left, top, right, bottom) quantized
-      dotproduct += computeBboxScore(min(bboxes[imageNumber].ltrb[4*numObj+0]/stepSize, iiWidth-2),
-                                     min(bboxes[imageNumber].ltrb[4*numObj+1]/stepSize, iiHeight-2),
-                                     min(bboxes[imageNumber].ltrb[4*numObj+2]/stepSize, iiWidth-2),
-                                     min(bboxes[imageNumber].ltrb[4*numObj+3]/stepSize, iiHeight-2));
-      if (normalized) {
-        logZ += currentLogZ;
-      }
-    }
-  }
+  // compute log Z (normalizing constant) once for every object
+  // of the images that actually contain the object (in parallel)
+  // (no integral images needed when unnormalized)
+  logZ = normalized ? evaluateImageValues(w, normalized) : 0.0;
 
   double loglik = regularizer - dotproduct + logZ;
 
@@ -93,3 +62,43 @@ double LogLikelihood::evaluate(Weights &w, bool normalized) {
   return loglik;
 }
 
+
+// normalization of a single image in the log-likelihood and its gradient
+// the integral image and log Z are computed only once
+double LogLikelihood::evaluateImage(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, Dvector &gradient, bool normalized) {
+
+  Bbox &bbox = dataManager->getBboxes()[imageNumber];
+  Image &img = dataManager->getImages()[imageNumber];
+
+  // (indexed by the visual words present in the image)
+  gradient.assign(img.numClusters, 0.0);
+  if (!normalized) {
+    return 0.0;
+  }
+
+  // compute integral image
+  imageCRF->computeIntegralImage(imageNumber, w);
+
+  // compute logZ and expectation
+  Dvector coverage;
+  double logZ = imageCRF->slidingWindowLogSumExp();
+  imageCRF->slidingWindowCoverage(coverage, logZ);
+  imageCRF->accumulateFeatureField(gradient, coverage, imageNumber);
+
+  // every object adds log Z and the expectation
+  for (int i=0; i<img.numClusters; i++) {
+    gradient[i] *= bbox.numObject;
+  }
+
+  return bbox.numObject*logZ;
+}
+
+// normalization of a single image (log Z only)
+double LogLikelihood::evaluateImageValue(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, bool normalized) {
+
+  if (!normalized) {
+    return 0.0;
+  }
+  imageCRF->computeIntegralImage(imageNumber, w);
+  return dataManager->getBboxes()[imageNumber].numObject*imageCRF->slidingWindowLogSumExp();
+}
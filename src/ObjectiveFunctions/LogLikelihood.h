@@ -20,6 +20,12 @@
 // log-likelihood derived from the objective function class
 class LogLikelihood : public ObjectiveFunction {
 
+  protected:
+
+    // contribution of a single image to the objective function and its gradient
+    virtual double evaluateImage(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, Dvector &gradient, bool normalized);
+    virtual double evaluateImageValue(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, bool normalized);
+
   public:
   
     // constructor
@@ -31,7 +31,6 @@ void LogLikelihoodGradient::evaluate(Dvector &gradient, Weights &w, bool normali
 
   int imageNumber;
   Bboxes &bboxes = dataManager->getBboxes();
-  int stepSize = getStepSize();
   int weightDim = w.size();
 
   // check gradient size
@@ -40,52 +39,37 @@ void LogLikelihoodGradient::evaluate(Dvector &gradient, Weights &w, bool normali
   }
   
   // create temporary Dvector
-  Ivector featureMap      = Ivector(weightDim, 0);
-  Ivector tempFeatureMap  = Ivector(weightDim, 0);
-  Dvector expectation     = Dvector(weightDim, 0.0);
+  Dvector coverage;
+  Dvector expectation;
   
-  // compute gradient regularizer
+  // compute gradient regularizer and ground truth feature maps
   // (no need to reset gradient before computation, just overwrite!)
+  const Dvector &empiricalFeatures = getEmpiricalFeatures(searchIx, weightDim);
   for (int i=0; i<weightDim; i++) {
-    gradient[i] = 2*lambda*w[i];
+    gradient[i] = 2*lambda*w[i] - empiricalFeatures[i];
   }
 
-  // compute feature map and expectation
-  for (size_t j=0; j<searchIx.size(); j++) {
+  // compute expectation
+  // (no integral images needed when unnormalized)
+  for (size_t j=0; normalized && j<searchIx.size(); j++) {
 
     // extract image index
     imageNumber = searchIx[j];
+    Image &img = dataManager->getImages()[imageNumber];
 
-    // only compute integral image and integral histogram when necessary
+    // only work on images that actually contain the object
     if (bboxes[imageNumber].numObject > 0) {
       
       // compute integral image
       computeIntegralImage(imageNumber, w);
-      
-      // compute integral histogram
-      computeIntegralHistogram(imageNumber);
 
       // compute expectation
-      if (normalized) {
-        slidingWindowExpectation(expectation, tempFeatureMap);
-      }
-    }
+      slidingWindowExpectation(expectation, coverage, imageNumber);
 
-    // only work on images that actually contain the object
-    for (int numObj = 0; numObj < bboxes[imageNumber].numObject; numObj++) {
-    
-      // compute feature map
-      // fit to quantized integralImage space
-      computeFeatureMap(featureMap,
-                        min(bboxes[imageNumber].ltrb[4*numObj+0]/stepSize, iiWidth-2),
-                        min(bboxes[imageNumber].ltrb[4*numObj+1]/stepSize, iiHeight-2),
-                        min(bboxes[imageNumber].ltrb[4*numObj+2]/stepSize, iiWidth-2),
-                        min(bboxes[imageNumber].ltrb[4*numObj+3]/stepSize, iiHeight-2));
-      
-      
-      // update gradient
-      for (int i=0; i<weightDim; i++) {
-        gradient[i] -= featureMap[i] - expectation[i];
+      // update gradient once for every object
+      // (only visual words present in the image contribute)
+      for (int i=0; i<img.numClusters; i++) {
+        gradient[img.clusters[i]] += bboxes[imageNumber].numObject*expectation[i];
       }
     }
   }
@@ -96,34 +80,22 @@ void LogLikelihoodGradient::evaluate(Dvector &gradient, Weights &w, bool normali
 // SLIDING WINDOW FUNCTIONS
 
 // sliding window using expectation
-void LogLikelihoodGradient::slidingWindowExpectation(Dvector &expectation, Ivector &featureMap)
+// E[phi_c] = sum_features P(box covers the feature's cell) for features of word c
+void LogLikelihoodGradient::slidingWindowExpectation(Dvector &expectation, Dvector &coverage, int imageNumber)
 {
-  double logZ, p;
-  int weightDim = expectation.size();
+  double logZ;
 
   // clear and reset expectation
-  expectation.clear();
-  expectation.resize(weightDim, 0.0);
+  // (indexed by the visual words present in the image)
+  expectation.assign(dataManager->getImages()[imageNumber].numClusters, 0.0);
 
   // compute normalization constant
   logZ = slidingWindowLogSumExp();
   
-  // compute p(l,t,r,b) = p(l,r|x)p(t,b|x)
-  for (short bbox_h = 0; bbox_h < iiHeight - 1; bbox_h++) {
-    //for all bounding widths
-    for (short bbox_w = 0; bbox_w < iiWidth - 1; bbox_w++) {
-      //for all Top-Left y-coordinates
-      for (short y = 0; y < iiHeight - bbox_h - 1; y++) {
-        //all Top-Left x-coordinates
-        for (short x = 0; x < iiWidth - bbox_w - 1; x++) {
-          p = exp(computeBboxScore(x, y, x+bbox_w, y+bbox_h) - logZ);
-          computeFeatureMap(featureMap, x, y, (x+bbox_w), (y+bbox_h));
-          for (int i=0; i<weightDim; i++) {
-            expectation[i] += p*featureMap[i];
-          }
-        }
-      }
-    }
-  }
-}
+  // compute probability that each cell is covered by the box
+  // using p(l,t,r,b) = exp(<w,phi(l,t,r,b)> - logZ)
+  crf->slidingWindowCoverage(coverage, logZ);
 
+  // scatter coverage probabilities onto the features of the image
+  crf->accumulateFeatureField(expectation, coverage, imageNumber);
+}
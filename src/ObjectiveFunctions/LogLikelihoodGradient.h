@@ -20,10 +20,10 @@
 // log-likelihood gradient derived from the gradient class
 class LogLikelihoodGradient : public Gradient {
 
-  private:
+  protected:
     
     // computing the expectation over bounding boxes using sliding windows
-    void slidingWindowExpectation(Dvector &expectation, Ivector &featureMap);
+    void slidingWindowExpectation(Dvector &expectation, Dvector &coverage, int imageNumber);
 
 
   public:
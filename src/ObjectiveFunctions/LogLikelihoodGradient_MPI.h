@@ -24,7 +24,7 @@ class LogLikelihoodGradient_MPI : public Gradient {
   private:
     
     // computing the expectation over bounding boxes using sliding windows
-    void slidingWindowExpectation(Dvector &expectation, Ivector &featureMap);
+    void slidingWindowExpectation(Dvector &expectation, Dvector &coverage, int imageNumber);
 
 
   public:
@@ -15,6 +15,7 @@
 // implementation of the abstract objective function class
 #include <cstdio>
 #include <iostream>
+#include <algorithm>
 
 #include "ObjectiveFunction.h"
 
@@ -23,7 +24,9 @@ using namespace std;
 
 // constructor
 ObjectiveFunction::ObjectiveFunction(DataManager *dm, ConditionalRandomField *crfield, SearchIx si)
-  : dataManager(dm), crf(crfield), searchIx(si), lambda(0.)
+  : dataManager(dm), crf(crfield), searchIx(si), lambda(0.),
+    numThreads(getNumProcessors()), threadPool(NULL), threadCRFSource(NULL), imagesPerSecond(0.),
+    groundTruthWeight(1), empiricalStepSize(0)
 {
   // if no search indices are defined, use the whole dataset
   if (dm != NULL && searchIx.empty()) {
@@ -34,6 +37,14 @@ ObjectiveFunction::ObjectiveFunction(DataManager *dm, ConditionalRandomField *cr
   }
 }
 
+// destructor
+ObjectiveFunction::~ObjectiveFunction() {
+  delete threadPool;
+  for (size_t t=0; t<threadCRFs.size(); t++) {
+    delete threadCRFs[t];
+  }
+}
+
 // getters/setters
 DataManager *ObjectiveFunction::getDataManager()  {
   return dataManager;
@@ -80,6 +91,23 @@ SearchIx ObjectiveFunction::getNonEmpty() {
   return dataManager->getNonEmpty();
 }
 
+// number of threads used by evaluateWithGradient
+int ObjectiveFunction::getNumThreads() {
+  return numThreads;
+}
+
+void ObjectiveFunction::setNumThreads(int n) {
+  numThreads = n > 0 ? n : 1;
+  
+  // thread pool is restarted on next use
+  delete threadPool;
+  threadPool = NULL;
+}
+
+double ObjectiveFunction::getImagesPerSecond() {
+  return imagesPerSecond;
+}
+
 // functions from CRF
 int ObjectiveFunction::getStepSize() {
   return crf->getStepSize();
@@ -98,3 +126,327 @@ void ObjectiveFunction::computeIntegralImage(int imageNumber, Weights &w) {
 double ObjectiveFunction::slidingWindowLogSumExp() {
   return crf->slidingWindowLogSumExp();
 }
+
+
+// sum of the ground truth feature vectors
+const Dvector &ObjectiveFunction::getEmpiricalFeatures(const SearchIx &si, int weightDim) {
+  int stepSize = getStepSize();
+  if ((int) empirical.size() != weightDim || empiricalStepSize != stepSize || empiricalSearchIx != si) {
+    empirical.assign(weightDim, 0.0);
+    dataManager->addEmpiricalFeatures(empirical, si, stepSize);
+    empiricalSearchIx = si;
+    empiricalStepSize = stepSize;
+  }
+  return empirical;
+}
+
+
+// PARALLEL EVALUATION
+
+// evaluates the images of the search index on the thread pool
+// every image has its own result slot, so no locking is needed
+class ObjectiveFunction::ImageTask : public ParallelTask {
+
+  public:
+
+    ObjectiveFunction *objective;
+    Weights *w;
+    bool normalized;
+    bool withGradient;
+
+    Dvector values;
+    std::vector<Dvector> gradients;
+
+    void run(int job, int thread) {
+      if (withGradient) {
+        values[job] = objective->evaluateImage(objective->threadCRFs[thread], objective->searchIx[job],
+                                               *w, gradients[job], normalized);
+      } else {
+        values[job] = objective->evaluateImageValue(objective->threadCRFs[thread], objective->searchIx[job],
+                                                    *w, normalized);
+      }
+    }
+
+};
+
+// comparison of images by estimated cost (for longest-job-first)
+struct LargerImageCost {
+  const Dvector *cost;
+  bool operator()(int a, int b) const {
+    return (*cost)[a] > (*cost)[b];
+  }
+};
+
+
+// evaluate objective function and gradient
+double ObjectiveFunction::evaluateWithGradient(Weights &w, Dvector &gradient, bool normalized) {
+
+  // check gradient size
+  if (gradient.size() != w.size()) {
+    throw GRADIENT_SIZE_ERROR;
+  }
+
+  return evaluateWithGradient(w, &gradient[0], normalized);
+}
+
+double ObjectiveFunction::evaluateWithGradient(Weights &w, double *gradient, bool normalized) {
+
+  int imageNumber;
+  int weightDim = w.size();
+  Bboxes &bboxes = dataManager->getBboxes();
+  Images &images = dataManager->getImages();
+
+  double start = getwalltime();
+
+  // compute regularizer and ground truth term with their gradients
+  // (no need to reset gradient before computation, just overwrite!)
+  const Dvector &empiricalFeatures = getEmpiricalFeatures(searchIx, weightDim);
+  double regularizer = 0.0;
+  double dotproduct = 0.0;
+  for (int i=0; i<weightDim; i++) {
+    regularizer += w[i]*w[i];
+    dotproduct += w[i]*empiricalFeatures[i];
+    gradient[i] = 2*lambda*w[i] - groundTruthWeight*empiricalFeatures[i];
+  }
+  double fval = lambda*regularizer - groundTruthWeight*dotproduct;
+
+  // only images that contain the object contribute
+  SearchIx jobs = getJobs();
+
+  if (numThreads <= 1 || jobs.size() <= 1) {
+
+    // serial evaluation using the CRF of the objective function
+    Dvector imageGradient;
+    for (size_t j=0; j<jobs.size(); j++) {
+      imageNumber = searchIx[jobs[j]];
+      Image &img = images[imageNumber];
+
+      fval += evaluateImage(crf, imageNumber, w, imageGradient, normalized);
+      for (int i=0; i<img.numClusters; i++) {
+        gradient[img.clusters[i]] += imageGradient[i];
+      }
+    }
+
+  } else {
+
+    startThreads();
+    sortLongestFirst(jobs);
+
+    ImageTask task;
+    task.objective = this;
+    task.w = &w;
+    task.normalized = normalized;
+    task.withGradient = true;
+    task.values = Dvector(searchIx.size(), 0.0);
+    task.gradients = std::vector<Dvector>(searchIx.size());
+
+    threadPool->run(task, jobs);
+
+    // sum up in the order of the search index
+    for (size_t j=0; j<searchIx.size(); j++) {
+      if (bboxes[searchIx[j]].numObject > 0) {
+        Image &img = images[searchIx[j]];
+
+        fval += task.values[j];
+        for (int i=0; i<img.numClusters; i++) {
+          gradient[img.clusters[i]] += task.gradients[j][i];
+        }
+      }
+    }
+  }
+
+  double elapsed = getwalltime() - start;
+  imagesPerSecond = elapsed > 0.0 ? jobs.size()/elapsed : 0.0;
+
+  return fval;
+}
+
+
+// evaluate the normalization of the images without the gradient
+double ObjectiveFunction::evaluateImageValues(Weights &w, bool normalized) {
+
+  Bboxes &bboxes = dataManager->getBboxes();
+  SearchIx jobs = getJobs();
+  double fval = 0.0;
+
+  if (numThreads <= 1 || jobs.size() <= 1) {
+    for (size_t j=0; j<jobs.size(); j++) {
+      fval += evaluateImageValue(crf, searchIx[jobs[j]], w, normalized);
+    }
+    return fval;
+  }
+
+  startThreads();
+  sortLongestFirst(jobs);
+
+  ImageTask task;
+  task.objective = this;
+  task.w = &w;
+  task.normalized = normalized;
+  task.withGradient = false;
+  task.values = Dvector(searchIx.size(), 0.0);
+
+  threadPool->run(task, jobs);
+
+  // sum up in the order of the search index
+  for (size_t j=0; j<searchIx.size(); j++) {
+    if (bboxes[searchIx[j]].numObject > 0) {
+      fval += task.values[j];
+    }
+  }
+  return fval;
+}
+
+// start thread pool and give each thread its own copy of the CRF
+void ObjectiveFunction::startThreads() {
+  if (threadPool == NULL) {
+    threadPool = new ThreadPool(numThreads);
+  }
+  if ((int) threadCRFs.size() == numThreads && threadCRFSource == crf &&
+      threadCRFs[0]->getSettingsVersion() == crf->getSettingsVersion()) {
+    return;
+  }
+
+  for (size_t t=0; t<threadCRFs.size(); t++) {
+    delete threadCRFs[t];
+  }
+  threadCRFs.resize(numThreads);
+  for (int t=0; t<numThreads; t++) {
+    threadCRFs[t] = crf->clone();
+  }
+  threadCRFSource = crf;
+}
+
+// images with objects
+SearchIx ObjectiveFunction::getJobs() {
+  Bboxes &bboxes = dataManager->getBboxes();
+  SearchIx jobs;
+  for (size_t j=0; j<searchIx.size(); j++) {
+    if (bboxes[searchIx[j]].numObject > 0) {
+      jobs.push_back(j);
+    }
+  }
+  return jobs;
+}
+
+// sort images by cost
+void ObjectiveFunction::sortLongestFirst(SearchIx &jobs) {
+  Images &images = dataManager->getImages();
+
+  // longest job first: the cost of an image grows with its number of
+  // integral image cells (and features)
+  int stepSize = getStepSize();
+  Dvector cost(searchIx.size(), 0.0);
+  for (size_t j=0; j<jobs.size(); j++) {
+    Image &img = images[searchIx[jobs[j]]];
+    cost[jobs[j]] = (double) (img.width/stepSize + 1)*(img.height/stepSize + 1) + img.numFeatures;
+  }
+  LargerImageCost larger;
+  larger.cost = &cost;
+  stable_sort(jobs.begin(), jobs.end(), larger);
+}
+
+
+// evaluate objective function and gradient on some of the images
+double ObjectiveFunction::evaluateSubset(ConditionalRandomField *workspace, Weights &w, Dvector &gradient, const SearchIx &si, bool normalized) {
+
+  int weightDim = w.size();
+  Bboxes &bboxes = dataManager->getBboxes();
+  Images &images = dataManager->getImages();
+  int stepSize = workspace->getStepSize();
+
+  // check gradient size
+  if ((int) gradient.size() != weightDim) {
+    throw GRADIENT_SIZE_ERROR;
+  }
+
+  // scale of the image terms
+  double scale = subsetScale(si);
+
+  // regularizer
+  double fval = 0.0;
+  for (int i=0; i<weightDim; i++) {
+    fval += lambda*w[i]*w[i];
+    gradient[i] = 2*lambda*w[i];
+  }
+
+  // ground truth term and normalization of every image
+  Dvector imageGradient;
+  int imageNumber;
+  for (size_t j=0; j<si.size(); j++) {
+    imageNumber = si[j];
+    if (bboxes[imageNumber].numObject == 0) {
+      continue;
+    }
+    Image &img = images[imageNumber];
+
+    const vector<SparseFeatures> &objects = dataManager->getGroundTruthFeatures(imageNumber, stepSize);
+    for (size_t n=0; n<objects.size(); n++) {
+      for (size_t i=0; i<objects[n].words.size(); i++) {
+        fval -= scale*groundTruthWeight*w[objects[n].words[i]]*objects[n].counts[i];
+        gradient[objects[n].words[i]] -= scale*groundTruthWeight*objects[n].counts[i];
+      }
+    }
+
+    fval += scale*evaluateImage(workspace, imageNumber, w, imageGradient, normalized);
+    for (int i=0; i<img.numClusters; i++) {
+      gradient[img.clusters[i]] += scale*imageGradient[i];
+    }
+  }
+
+  return fval;
+}
+
+// evaluate objective function on some of the images
+double ObjectiveFunction::evaluateSubset(ConditionalRandomField *workspace, Weights &w, const SearchIx &si, bool normalized) {
+
+  int weightDim = w.size();
+  Bboxes &bboxes = dataManager->getBboxes();
+  int stepSize = workspace->getStepSize();
+  double scale = subsetScale(si);
+
+  // regularizer
+  double fval = 0.0;
+  for (int i=0; i<weightDim; i++) {
+    fval += lambda*w[i]*w[i];
+  }
+
+  // ground truth term and normalization of every image
+  int imageNumber;
+  for (size_t j=0; j<si.size(); j++) {
+    imageNumber = si[j];
+    if (bboxes[imageNumber].numObject == 0) {
+      continue;
+    }
+
+    const vector<SparseFeatures> &objects = dataManager->getGroundTruthFeatures(imageNumber, stepSize);
+    for (size_t n=0; n<objects.size(); n++) {
+      for (size_t i=0; i<objects[n].words.size(); i++) {
+        fval -= scale*groundTruthWeight*w[objects[n].words[i]]*objects[n].counts[i];
+      }
+    }
+
+    fval += scale*evaluateImageValue(workspace, imageNumber, w, normalized);
+  }
+
+  return fval;
+}
+
+// scale of the image terms of a subset
+double ObjectiveFunction::subsetScale(const SearchIx &si) {
+  Bboxes &bboxes = dataManager->getBboxes();
+  int numSearch = 0, numSubset = 0;
+  for (size_t j=0; j<searchIx.size(); j++) {
+    numSearch += bboxes[searchIx[j]].numObject > 0;
+  }
+  for (size_t j=0; j<si.size(); j++) {
+    numSubset += bboxes[si[j]].numObject > 0;
+  }
+  return numSubset > 0 ? (double) numSearch/numSubset : 0.0;
+}
+
+// normalization of a single image without the gradient
+double ObjectiveFunction::evaluateImageValue(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, bool normalized) {
+  Dvector gradient;
+  return evaluateImage(imageCRF, imageNumber, w, gradient, normalized);
+}
@@ -17,6 +17,7 @@
 
 #include "DataManager.h"
 #include "ConditionalRandomField.h"
+#include "Parallel/ThreadPool.h"
 
 
 // objective function base class
@@ -38,10 +39,71 @@ class ObjectiveFunction {
     // for current integral image
     int iiWidth, iiHeight;
 
+    // threads used by evaluateWithGradient and a copy of the CRF for each of
+    // them (kept between calls, so the copies keep their integral histograms)
+    int numThreads;
+    ThreadPool *threadPool;
+    std::vector<ConditionalRandomField *> threadCRFs;
+    ConditionalRandomField *threadCRFSource;
+
+    // throughput of the last call to evaluateWithGradient
+    double imagesPerSecond;
+
+    // number of times the ground truth score of an object enters the objective
+    // (4 for the pseudo-likelihood)
+    int groundTruthWeight;
+
+    // sum of the ground truth feature vectors of the images in si
+    // (only recomputed when the images or the step size change)
+    const Dvector &getEmpiricalFeatures(const SearchIx &si, int weightDim);
+
+    // contribution of the normalization constants of a single image to the
+    // objective function and its gradient (without regularizer and ground truth
+    // term, which are added once for all images). The gradient is the expected
+    // feature map indexed by the visual words present in the image. Only the
+    // given CRF may be used, so that images can be evaluated in parallel
+    virtual double evaluateImage(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, Dvector &gradient, bool normalized) = 0;
+
+    // the same without the gradient (computes the gradient and drops it
+    // unless the objective function has a cheaper way)
+    virtual double evaluateImageValue(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, bool normalized);
+
+    // sum of evaluateImageValue over the images of the search index, evaluated
+    // in parallel like evaluateWithGradient (summed in the order of the search
+    // index, so the result is the same for any number of threads)
+    double evaluateImageValues(Weights &w, bool normalized);
+
+  private:
+
+    // cached empirical feature term
+    Dvector empirical;
+    SearchIx empiricalSearchIx;
+    int empiricalStepSize;
+
+    // evaluates images on the thread pool
+    class ImageTask;
+
+    // number of images with objects in the search index over the number in si
+    double subsetScale(const SearchIx &si);
+
+    // start the thread pool and copy the CRF for each thread (again only when
+    // the CRF, one of its settings or the number of threads have changed)
+    void startThreads();
+
+    // images of the search index (positions in it) with objects, and the
+    // same sorted longest first for the thread pool
+    SearchIx getJobs();
+    void sortLongestFirst(SearchIx &jobs);
+
+    // not copyable (owns the thread pool)
+    ObjectiveFunction(const ObjectiveFunction &);
+    ObjectiveFunction &operator=(const ObjectiveFunction &);
+
   public:
 
-    // constructor
+    // constructor and destructor
     ObjectiveFunction(DataManager *dm=NULL, ConditionalRandomField *crf=NULL, SearchIx si=SearchIx());
+    virtual ~ObjectiveFunction();
 
     // getters/setters
     DataManager *getDataManager();
@@ -62,6 +124,16 @@ class ObjectiveFunction {
 
     int getNumImages();
     SearchIx getNonEmpty();
+
+    // number of threads used by evaluateWithGradient and by evaluate of the
+    // log-likelihood (defaults to the number of processors, 1 evaluates
+    // serially). evaluate of the other objectives and the Gradient classes
+    // are serial, the learners use evaluateWithGradient
+    int getNumThreads();
+    void setNumThreads(int n);
+
+    // images per second processed by the last call to evaluateWithGradient
+    double getImagesPerSecond();
     
     // useful functions which will be called through the CRF
     void computeIntegralImage(int imageNumber, Weights &w);
@@ -78,6 +150,27 @@ class ObjectiveFunction {
     // evaluate (specific to the actual objective function)
     virtual double evaluate(Weights &w, bool normalized = true) = 0;
 
+    // evaluate objective function and its gradient in one pass over the images
+    // (shares integral images and normalization constants)
+    // images are evaluated in parallel, longest first, and the results are summed
+    // in the order of the search index so that they do not depend on the threads
+    virtual double evaluateWithGradient(Weights &w, Dvector &gradient, bool normalized = true);
+
+    // the same writing the gradient to an array of w.size() values in place
+    // (e.g. the gradient of libLBFGS, so it does not have to be copied)
+    double evaluateWithGradient(Weights &w, double *gradient, bool normalized = true);
+
+    // objective function and gradient on the images si (of the search index)
+    // using the CRF workspace instead of the CRF of the objective function, so
+    // it can run on another thread while that one is in use (the ground truth
+    // features of the images must have been computed). The terms of the images
+    // are scaled by the number of images with objects in the search index over
+    // the number in si, so a random subset estimates the full objective
+    double evaluateSubset(ConditionalRandomField *workspace, Weights &w, Dvector &gradient, const SearchIx &si, bool normalized = true);
+
+    // the same without the gradient
+    double evaluateSubset(ConditionalRandomField *workspace, Weights &w, const SearchIx &si, bool normalized = true);
+
 };
 
 
@@ -29,9 +29,6 @@ class PiecewiseGradient : public Gradient {
     // sliding window for expectation computation
     void slidingWindowExpectation(Dvector &expectation, int imageNumber);
 
-    // convert (x,y) into 1d index (from CRF)
-    int iiOffset(int x, int y);
-
   public:
   
     // constructor
@@ -31,20 +31,18 @@ double PiecewiseLogLikelihood::evaluate(Weights &w, bool normalized) {
   
   int imageNumber;
   Bboxes &bboxes = dataManager->getBboxes();
-  IntegralImage *integralImage;
-  int stepSize = getStepSize();
   
   // compute regularizer
+  // compute dot product with the ground truth feature vectors
+  const Dvector &empiricalFeatures = getEmpiricalFeatures(searchIx, w.size());
   double regularizer = 0.0;
+  double dotproduct = 0.0;
   for (size_t i = 0; i < w.size(); i++) {
     regularizer += w[i]*w[i];
+    dotproduct += w[i]*empiricalFeatures[i];
   }
   regularizer *= lambda;
   
-  // compute dot product with feature map
-  double dotproduct = 0.0;
-  int xl,yl,xh,yh;
-
   // compute log Z (normalizing constant)
   double logZ = 0.0;
   Dvector logZ_F (4);
@@ -54,37 +52,15 @@ double PiecewiseLogLikelihood::evaluate(Weights &w, bool normalized) {
     // extract image index
     imageNumber = searchIx[i];
 
-    // only compute integral image when needed
+    // only work on images that actually contain the object
     if (bboxes[imageNumber].numObject > 0) {
     
       // compute integral image
       computeIntegralImage(imageNumber, w);   
-      integralImage = crf->getIntegralImage();
   
-      // compute log Z_F
+      // compute log Z_F (once for every object)
       crf->slidingWindowLogSumExp(logZ_F);
-
-      // only work on images that actually contain the object
-      for (int numObj = 0; numObj < bboxes[imageNumber].numObject; numObj++) {
-        
-        // calculate score on ground truth bounding box
-        // fit to quantized integralImage space
-        xl = min(bboxes[imageNumber].ltrb[4*numObj+0]/stepSize, iiWidth-2);
-        yl = min(bboxes[imageNumber].ltrb[4*numObj+1]/stepSize, iiHeight-2);
-        xh = min(bboxes[imageNumber].ltrb[4*numObj+2]/stepSize, iiWidth-2);
-        yh = min(bboxes[imageNumber].ltrb[4*numObj+3]/stepSize, iiHeight-2);
-        
-        dotproduct += (*integralImage)[crf->iiOffset(xl,yl)];
-        dotproduct -= (*integralImage)[crf->iiOffset(xl,yh+1)];
-        dotproduct -= (*integralImage)[crf->iiOffset(xh+1,yl)];
-        dotproduct += (*integralImage)[crf->iiOffset(xh+1,yh+1)];
-        
-        logZ += logZ_F[0];
-        logZ += logZ_F[1];
-        logZ += logZ_F[2];
-        logZ += logZ_F[3];
-
-      }
+      logZ += bboxes[imageNumber].numObject*(logZ_F[0] + logZ_F[1] + logZ_F[2] + logZ_F[3]);
     }
   }
   
@@ -102,3 +78,35 @@ double PiecewiseLogLikelihood::evaluate(Weights &w, bool normalized) {
 }
 
 
+
+// normalization of a single image in the piecewise log-likelihood and its gradient
+// the integral image and log Z_F are computed only once
+double PiecewiseLogLikelihood::evaluateImage(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, Dvector &gradient, bool normalized) {
+
+  // each thread has its own copy of the piecewise CRF
+  PiecewiseConditionalRandomField *pcrf = static_cast<PiecewiseConditionalRandomField *>(imageCRF);
+
+  Bbox &bbox = dataManager->getBboxes()[imageNumber];
+  Image &img = dataManager->getImages()[imageNumber];
+
+  // compute integral image
+  pcrf->computeIntegralImage(imageNumber, w);
+
+  // compute log Z_F and expectation
+  // (indexed by the visual words present in the image)
+  Dvector logZ_F (4);
+  gradient.assign(img.numClusters, 0.0);
+  pcrf->slidingWindowLogSumExp(logZ_F);
+  pcrf->slidingWindowExpectation(gradient, logZ_F, imageNumber);
+
+  // every object adds log Z_F and the expectation
+  for (int i=0; i<img.numClusters; i++) {
+    gradient[i] *= bbox.numObject;
+  }
+  double fval = bbox.numObject*(logZ_F[0] + logZ_F[1] + logZ_F[2] + logZ_F[3]);
+
+  if (isnan(fval)) {
+    throw NOT_A_NUMBER;
+  }
+  return fval;
+}
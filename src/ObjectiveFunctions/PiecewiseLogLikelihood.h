@@ -25,6 +25,11 @@ class PiecewiseLogLikelihood : public ObjectiveFunction {
     
     PiecewiseConditionalRandomField *crf;
 
+  protected:
+
+    // contribution of a single image to the objective function and its gradient
+    virtual double evaluateImage(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, Dvector &gradient, bool normalized);
+
   public:
   
     // constructor
@@ -23,6 +23,8 @@ using namespace std;
 PseudoLikelihood::PseudoLikelihood(DataManager *dm, ConditionalRandomField *crfield, SearchIx si)
   : ObjectiveFunction::ObjectiveFunction(dm, crfield, si)
 {
+  // the ground truth score enters each of the four conditionals
+  groundTruthWeight = 4;
 }
 
 // evaluate pseudolikelihood
@@ -36,15 +38,17 @@ double PseudoLikelihood::evaluate(Weights &w, bool normalized) {
   int stepSize = getStepSize();  
 
   // compute regularizer
+  // compute dot product with the ground truth feature vectors
+  const Dvector &empiricalFeatures = getEmpiricalFeatures(searchIx, weightDim);
   regularizer = 0.0;
+  dotproduct = 0.0;
   for (int i=0; i<weightDim; i++) {
     regularizer += w[i]*w[i];
+    dotproduct += w[i]*empiricalFeatures[i];
   }
   regularizer *= lambda;
 
-  // compute dot product with feature map
   // compute log Z (normalizing constant)
-  dotproduct = 0.0;
   logZs = 0.0;
   
   Bbox scaledBbox;
@@ -71,12 +75,6 @@ double PseudoLikelihood::evaluate(Weights &w, bool normalized) {
       scaledBbox.ltrb[RIGHT]  = min(bboxes[imageNumber].ltrb[4*numObj+2]/stepSize, iiWidth-2);
       scaledBbox.ltrb[BOTTOM] = min(bboxes[imageNumber].ltrb[4*numObj+3]/stepSize, iiHeight-2);
 
-      // calculate score on ground truth bounding box  
-      dotproduct += computeBboxScore(scaledBbox.ltrb[LEFT],
-                                     scaledBbox.ltrb[TOP],
-                                     scaledBbox.ltrb[RIGHT],
-                                     scaledBbox.ltrb[BOTTOM]);
-      
       // Vary one of (left, top, right, bottom), keep all other constant
       for (int s=0; s<4; s++) {
         logZs += crf->slidingWindowLogSumExpCond(s, scaledBbox);
@@ -93,3 +91,43 @@ double PseudoLikelihood::evaluate(Weights &w, bool normalized) {
   return regularizer - 4*dotproduct + logZs;
 }
 
+
+// normalization of a single image in the pseudolikelihood and its gradient
+// the conditional scores of each ground truth box are computed only once
+double PseudoLikelihood::evaluateImage(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, Dvector &gradient, bool normalized) {
+
+  double fval;
+
+  int stepSize = imageCRF->getStepSize();
+  Bbox &bbox = dataManager->getBboxes()[imageNumber];
+  Image &img = dataManager->getImages()[imageNumber];
+
+  // compute integral image
+  imageCRF->computeIntegralImage(imageNumber, w);
+  int iiWidth  = imageCRF->getIntegralImageWidth();
+  int iiHeight = imageCRF->getIntegralImageHeight();
+
+  // indexed by the visual words present in the image
+  gradient.assign(img.numClusters, 0.0);
+  fval = 0.0;
+
+  Bbox scaledBbox;
+  scaledBbox.ltrb = new short[4];
+
+  for (int numObj = 0; numObj < bbox.numObject; numObj++) {
+
+    // scale true bbox
+    scaledBbox.ltrb[LEFT]   = min(bbox.ltrb[4*numObj+0]/stepSize, iiWidth-2);
+    scaledBbox.ltrb[TOP]    = min(bbox.ltrb[4*numObj+1]/stepSize, iiHeight-2);
+    scaledBbox.ltrb[RIGHT]  = min(bbox.ltrb[4*numObj+2]/stepSize, iiWidth-2);
+    scaledBbox.ltrb[BOTTOM] = min(bbox.ltrb[4*numObj+3]/stepSize, iiHeight-2);
+
+    // vary one of (left, top, right, bottom), keep all other constant
+    // (the expectations are added to the gradient)
+    fval += imageCRF->slidingWindowPseudoLikelihood(gradient, scaledBbox, imageNumber);
+  }
+
+  delete[] scaledBbox.ltrb;
+
+  return fval;
+}
@@ -6,6 +6,11 @@
 // Pseudo-likelihood derived from the objective function class
 class PseudoLikelihood : public ObjectiveFunction {
 
+  protected:
+
+    // contribution of a single image to the objective function and its gradient
+    virtual double evaluateImage(ConditionalRandomField *imageCRF, int imageNumber, Weights &w, Dvector &gradient, bool normalized);
+
   public:
   
     // constructor
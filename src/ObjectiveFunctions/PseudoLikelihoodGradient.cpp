@@ -29,29 +29,28 @@ void PseudoLikelihoodGradient::evaluate(Dvector &gradient, Weights &w, bool norm
   scaledBbox.ltrb = new short[4];
 
   // create temporary Dvector
-  Ivector featureMap      = Ivector(w.size(), 0);
-  Ivector tempFeatureMap  = Ivector(w.size(), 0);
-  Dvector expectation     = Dvector(w.size(), 0.0);
+  Dvector expectation;
   
-  // compute gradient regularizer
+  // compute gradient regularizer and ground truth feature maps
+  // (the ground truth score enters each of the four conditionals)
   // (no need to reset gradient before computation, just overwrite!)
+  const Dvector &empiricalFeatures = getEmpiricalFeatures(searchIx, weightDim);
   for (int i=0; i<weightDim; i++) {
-    gradient[i] = 2*lambda*w[i];
+    gradient[i] = 2*lambda*w[i] - 4*empiricalFeatures[i];
   }
 
-  // compute feature map and expectation
+  // compute expectation
   for (size_t j=0; j<searchIx.size(); j++) {
 
     // extract image index
     imageNumber = searchIx[j];
+    Image &img = dataManager->getImages()[imageNumber];
     
+    // only compute integral image when necessary
     if (bboxes[imageNumber].numObject > 0) {
   
       // compute integral image
       computeIntegralImage(imageNumber, w);
-      
-      // compute integral histogram
-      computeIntegralHistogram(imageNumber);
     }
 
     // only work on images that actually contain the object
@@ -63,29 +62,13 @@ void PseudoLikelihoodGradient::evaluate(Dvector &gradient, Weights &w, bool norm
       scaledBbox.ltrb[RIGHT]  = min(bboxes[imageNumber].ltrb[4*numObj+2]/stepSize, iiWidth-2);
       scaledBbox.ltrb[BOTTOM] = min(bboxes[imageNumber].ltrb[4*numObj+3]/stepSize, iiHeight-2);
 
-      // compute feature map
-      // divide and multiply by stepSize to discritize same way as integralImage is discretized
-      computeFeatureMap(featureMap, 
-                        scaledBbox.ltrb[LEFT],
-                        scaledBbox.ltrb[TOP],
-                        scaledBbox.ltrb[RIGHT],
-                        scaledBbox.ltrb[BOTTOM]);
-      
-      // update gradient
-      for (int i=0; i<weightDim; i++) {
-        gradient[i] -= 4*featureMap[i];
-      }
-      
       // Vary one of (left, top, right, bottom), keep all other constant
-      for (int s=0; s<4; s++) {
-  
-        // compute expectation
-        slidingWindowExpectation(expectation, tempFeatureMap, imageNumber, scaledBbox, s);
+      // (the four expectations are computed together)
+      slidingWindowExpectation(expectation, imageNumber, scaledBbox);
         
-        // update gradient
-        for (int i=0; i<weightDim; i++) {
-          gradient[i] += expectation[i];
-        }
+      // update gradient
+      for (int i=0; i<img.numClusters; i++) {
+        gradient[img.clusters[i]] += expectation[i];
       }
     }
   }
@@ -97,58 +80,13 @@ void PseudoLikelihoodGradient::evaluate(Dvector &gradient, Weights &w, bool norm
 // SLIDING WINDOW FUNCTIONS
 
 // sliding window using expectation
-void PseudoLikelihoodGradient::slidingWindowExpectation(Dvector &expectation, Ivector &featureMap, int imageNumber, Bbox &scaledBbox, int s)
+// sum of the expected feature maps when each of the four coordinates varies
+void PseudoLikelihoodGradient::slidingWindowExpectation(Dvector &expectation, int imageNumber, Bbox &scaledBbox)
 {
-  double logZs, p;
-  int weightDim = expectation.size();
-
   // clear and reset expectation
-  expectation.clear();
-  expectation.resize(weightDim, 0.0);
-  
-  // select the boundaries for the given variable
-  short start, stop;
-  switch (s) {
-    case LEFT:
-      // left goes from left edge to y_r
-      start = 0;
-      stop = scaledBbox.ltrb[RIGHT];
-      break;
-    case TOP:
-      // top goes from top edge to y_b
-      start = 0;
-      stop = scaledBbox.ltrb[BOTTOM];
-      break;
-    case RIGHT:
-      // right goes from y_r to right edge
-      start = scaledBbox.ltrb[LEFT];
-      stop  = iiWidth-2;
-      break;
-    case BOTTOM:
-      // bottom goes from y_t to bottom edge
-      start = scaledBbox.ltrb[TOP];
-      stop  = iiHeight-2;
-      break;
-  }
-  
-  // store original value
-  int val = scaledBbox.ltrb[s];
-
-  // compute normalization constant from CRF
-  logZs = crf->slidingWindowLogSumExpCond(s, scaledBbox);
-  
-  // compute expectation
-  for (short i = start; i <= stop; i++) {
-    scaledBbox.ltrb[s] = i;
-    p = exp(computeBboxScore(scaledBbox.ltrb[LEFT], scaledBbox.ltrb[TOP], scaledBbox.ltrb[RIGHT], scaledBbox.ltrb[BOTTOM]) - logZs);
-    computeFeatureMap(featureMap, scaledBbox.ltrb[LEFT], scaledBbox.ltrb[TOP], scaledBbox.ltrb[RIGHT], scaledBbox.ltrb[BOTTOM]);
-    for (int j=0; j<weightDim; j++) {
-      expectation[j] += p*featureMap[j];
-    }
-  }
-  
-  // reinsert original value  
-  scaledBbox.ltrb[s] = val;
+  // (indexed by the visual words present in the image)
+  expectation.assign(dataManager->getImages()[imageNumber].numClusters, 0.0);
 
+  // compute expectation from the conditional scores
+  crf->slidingWindowPseudoLikelihood(expectation, scaledBbox, imageNumber);
 }
-
@@ -9,7 +9,7 @@ class PseudoLikelihoodGradient : public Gradient {
   private:
     
     // sliding window for expectation computation
-    void slidingWindowExpectation(Dvector &expectation, Ivector &featureMap, int imageNumber, Bbox &scaledBbox, int s);
+    void slidingWindowExpectation(Dvector &expectation, int imageNumber, Bbox &scaledBbox);
   
 
   public:
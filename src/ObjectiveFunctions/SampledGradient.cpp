@@ -9,10 +9,25 @@ using namespace std;
 
 // constructor
 SampledGradient::SampledGradient(DataManager *dm, ConditionalRandomField *crfield, GibbsSampler *gibbs, SearchIx si, int numSamples_, int skip_)
-  : StochasticGradient::StochasticGradient(dm, crfield, si), sampler(gibbs), numSamples(numSamples_), skip(skip_)
+  : StochasticGradient::StochasticGradient(dm, crfield, si), sampler(gibbs), ownsSampler(false), numSamples(numSamples_), skip(skip_)
 {
 }
 
+SampledGradient::~SampledGradient() {
+  if (ownsSampler) {
+    delete sampler;
+  }
+}
+
+// copy using another CRF with its own sampler
+StochasticGradient *SampledGradient::clone(ConditionalRandomField *crfield) {
+  SampledGradient *copy = new SampledGradient(dataManager, crfield, new GibbsSampler(crfield), searchIx, numSamples, skip);
+  copy->sampler->sharePersistentChains(sampler);
+  copy->ownsSampler = true;
+  copy->setLambda(lambda);
+  return copy;
+}
+
 // get and set sampler
 GibbsSampler *SampledGradient::getSampler() {
   return sampler;
@@ -27,6 +42,7 @@ int SampledGradient::getNumSamples() {
 
 void SampledGradient::setNumSamples(int n) {
   numSamples = n;
+  clearBatchWorkspace();
 }
 
 int SampledGradient::getSkip() {
@@ -35,6 +51,16 @@ int SampledGradient::getSkip() {
 
 void SampledGradient::setSkip(int s) {
   skip = s;
+  clearBatchWorkspace();
+}
+
+int SampledGradient::getNumChains() {
+  return sampler->getNumChains();
+}
+
+void SampledGradient::setNumChains(int n) {
+  sampler->setPersistentChains(n);
+  clearBatchWorkspace();
 }
 
 // gradient evaluated for a single image
@@ -65,21 +91,22 @@ void SampledGradient::evaluate(Dvector &gradient, Weights &w, bool normalized) {
   scaledBbox.ltrb = new short[4];
 
   // create temporary Dvector
-  Ivector featureMap      = Ivector(weightDim, 0);
   Ivector tempFeatureMap  = Ivector(weightDim, 0);
   Dvector sampleMean      = Dvector(weightDim, 0.0);
   
-  // compute gradient regularizer
+  // compute gradient regularizer and ground truth feature maps
   // (no need to reset gradient before computation, just overwrite!)
+  const Dvector &empiricalFeatures = getEmpiricalFeatures(searchIx, weightDim);
   for (int i=0; i<weightDim; i++) {
-    gradient[i] = 2*lambda*w[i];
+    gradient[i] = 2*lambda*w[i] - empiricalFeatures[i];
   }
 
-  // compute feature map and sample mean
-  for (size_t j=0; j<searchIx.size(); j++) {
+  // compute sample mean
+  for (size_t j=0; normalized && j<searchIx.size(); j++) {
 
     // extract image index
     imageNumber = searchIx[j];
+    Image &img = dataManager->getImages()[imageNumber];
 
     // only compute integral image and integral histogram when necessary
     if (bboxes[imageNumber].numObject > 0) {
@@ -94,28 +121,19 @@ void SampledGradient::evaluate(Dvector &gradient, Weights &w, bool normalized) {
     // only work on images that actually contain the object
     for (int numObj = 0; numObj < bboxes[imageNumber].numObject; numObj++) {
     
-      // compute feature map
-      // fit to quantized integralImage space
-   
+      // fit ground truth box to quantized integralImage space
+      // (the sampler starts from it)
       scaledBbox.ltrb[LEFT]    = min(bboxes[imageNumber].ltrb[4*numObj+0]/stepSize, iiWidth-2);
       scaledBbox.ltrb[TOP]     = min(bboxes[imageNumber].ltrb[4*numObj+1]/stepSize, iiHeight-2);
       scaledBbox.ltrb[RIGHT]   = min(bboxes[imageNumber].ltrb[4*numObj+2]/stepSize, iiWidth-2);
       scaledBbox.ltrb[BOTTOM]  = min(bboxes[imageNumber].ltrb[4*numObj+3]/stepSize, iiHeight-2);
 
-      computeFeatureMap(featureMap, scaledBbox.ltrb[LEFT], 
-                                    scaledBbox.ltrb[TOP],
-                                    scaledBbox.ltrb[RIGHT],
-                                    scaledBbox.ltrb[BOTTOM]);
-      
       // compute sample mean
-      if (normalized) {
-        computeSampleMean(sampleMean, w, tempFeatureMap, imageNumber, scaledBbox);
-      }
+      computeSampleMean(sampleMean, w, tempFeatureMap, imageNumber, scaledBbox);
       
-      
-      // update gradient
-      for (int i=0; i<weightDim; i++) {
-        gradient[i] -= featureMap[i] - sampleMean[i];
+      // update gradient (only visual words present in the image contribute)
+      for (int i=0; i<img.numClusters; i++) {
+        gradient[img.clusters[i]] += sampleMean[i];
       }
     }
   }
@@ -126,34 +144,86 @@ void SampledGradient::evaluate(Dvector &gradient, Weights &w, bool normalized) {
 
 
 
+// sparse sampled gradient for w = scale*v (without the regularizer)
+void SampledGradient::evaluateSparse(SparseVector &gradient, Weights &v, double scale, int imageNumber, bool normalized) {
+
+  int stepSize = getStepSize();
+  Bboxes &bboxes = dataManager->getBboxes();
+
+  initializeSparse(gradient, imageNumber);
+  if (!normalized || bboxes[imageNumber].numObject == 0) {
+    return;
+  }
+
+  computeIntegralImage(imageNumber, v, scale);
+  computeIntegralHistogram(imageNumber);
+
+  short ltrb[4];
+  Bbox scaledBbox;
+  scaledBbox.ltrb = ltrb;
+  if (sparseFeatureMap.size() < v.size()) {
+    sparseFeatureMap.resize(v.size());
+  }
+
+  for (int numObj = 0; numObj < bboxes[imageNumber].numObject; numObj++) {
+
+    // start the chain from the (scaled) ground truth box as above
+    scaledBbox.ltrb[LEFT]    = min(bboxes[imageNumber].ltrb[4*numObj+0]/stepSize, iiWidth-2);
+    scaledBbox.ltrb[TOP]     = min(bboxes[imageNumber].ltrb[4*numObj+1]/stepSize, iiHeight-2);
+    scaledBbox.ltrb[RIGHT]   = min(bboxes[imageNumber].ltrb[4*numObj+2]/stepSize, iiWidth-2);
+    scaledBbox.ltrb[BOTTOM]  = min(bboxes[imageNumber].ltrb[4*numObj+3]/stepSize, iiHeight-2);
+
+    computeSampleMean(sparseSampleMean, v, sparseFeatureMap, imageNumber, scaledBbox);
+
+    for (size_t i=0; i<sparseSampleMean.size(); i++) {
+      gradient.value[i] += sparseSampleMean[i];
+    }
+  }
+}
+
+
 // approximate expectation by sample mean
 void SampledGradient::computeSampleMean(Dvector &sampleMean, Weights &w, Ivector &featureMap, int imageNumber, Bbox &bbox)
 {
-  int weightDim = sampleMean.size();
+  // sample mean is indexed by the visual words present in the image
+  int numClusters = dataManager->getImages()[imageNumber].numClusters;
 
   // clear and reset sample mean
-  sampleMean.clear();
-  sampleMean.resize(weightDim, 0.0);
+  sampleMean.assign(numClusters, 0.0);
 
   Bbox *sample;
 
-  // initialize Gibbs chain to ground truth bbox (scaled)
-  sampler->initializeCurrent(imageNumber, bbox);
+  // CD-k starts the Gibbs chain at the ground truth bbox (scaled), persistent
+  // CD continues each chain of the image from where it was left
+  bool persistent = sampler->getNumChains() > 0;
+  int numChains = persistent ? sampler->getNumChains() : 1;
+
+  for (int c=0; c<numChains; c++) {
+    if (persistent) {
+      sampler->loadChain(imageNumber, c, bbox);
+    } else {
+      sampler->initializeCurrent(imageNumber, bbox);
+    }
+
+    // take number of samples
+    for (int i=0; i<numSamples; i++) {
+      sampler->sample(skip, w, imageNumber, false);   // don't recompute integral image
+      sample = sampler->getCurrentSample(imageNumber);
+      computeFeatureMap(featureMap, sample->ltrb[LEFT], sample->ltrb[TOP], sample->ltrb[RIGHT], sample->ltrb[BOTTOM]);
 
-  // take number of samples
-  for (int i=0; i<numSamples; i++) {
-    sampler->sample(skip, w, imageNumber, false);   // don't recompute integral image
-    sample = sampler->getCurrentSample(imageNumber);
-    computeFeatureMap(featureMap, sample->ltrb[LEFT], sample->ltrb[TOP], sample->ltrb[RIGHT], sample->ltrb[BOTTOM]);
+      // sum up feature maps   
+      for (int j=0; j<numClusters; j++) {
+        sampleMean[j] += featureMap[j];
+      }
+    }
 
-    // sum up feature maps   
-    for (int j=0; j<weightDim; j++) {
-      sampleMean[j] += featureMap[j];
+    if (persistent) {
+      sampler->storeChain(imageNumber, c);
     }
   }
 
   // divide by number of samples (compute sample mean)
-  for (int j=0; j<weightDim; j++) {
-    sampleMean[j] /= numSamples;
+  for (int j=0; j<numClusters; j++) {
+    sampleMean[j] /= numChains*numSamples;
   }
 }
@@ -11,19 +11,33 @@ class SampledGradient : public StochasticGradient {
     
     // sampler for sampling the sample mean
     GibbsSampler *sampler;
+    bool ownsSampler;
 
     // number of samples, number of skips
     // number of skips corresponds to k in CD-k
     int numSamples;
     int skip;
 
+    // workspace of evaluateSparse
+    Ivector sparseFeatureMap;
+    Dvector sparseSampleMean;
+
     // computing the sample mean instead of expectation
     void computeSampleMean(Dvector &sampleMean, Weights &w, Ivector &featureMap, int imageNumber, Bbox &bbox);
 
+    // not copyable (may own the sampler)
+    SampledGradient(const SampledGradient &);
+    SampledGradient &operator=(const SampledGradient &);
+
   public:
   
     // constructor
     SampledGradient(DataManager *dm=NULL, ConditionalRandomField *crfield=NULL, GibbsSampler *sampler=NULL, SearchIx si=SearchIx(), int numSamples=10, int skip=10);
+    ~SampledGradient();
+
+    // copy using another CRF with its own sampler (owned by the copy, which
+    // shares the persistent chains)
+    virtual StochasticGradient *clone(ConditionalRandomField *crfield);
 
     GibbsSampler *getSampler();
     void setSampler(GibbsSampler *gibbs);
@@ -34,12 +48,23 @@ class SampledGradient : public StochasticGradient {
     int getSkip();
     void setSkip(int s);
 
+    // persistent contrastive divergence: keep n Gibbs chains per image in the
+    // sampler, which continue where the last gradient of the image left them
+    // instead of starting at the ground truth (0 for CD-k). Every chain gives
+    // numSamples samples, taken skip steps apart
+    int getNumChains();
+    void setNumChains(int n);
+
     // evaluate for a single training example
     virtual void evaluate(Dvector &gradient, Weights &w, int imageNumber, bool normalized = true);
 
     // evaluate sampled gradient
     virtual void evaluate(Dvector &gradient, Weights &w, bool normalized = true);
 
+    // sparse sampled gradient at w = scale*v for a single training example
+    // (without the regularizer)
+    virtual void evaluateSparse(SparseVector &gradient, Weights &v, double scale, int imageNumber, bool normalized = true);
+
 
 };
 
@@ -1,14 +1,30 @@
 // implementation of stochatic gradient
+#include <algorithm>
+
 #include "StochasticGradient.h"
 
 using namespace std;
 
 // constructor
 StochasticGradient::StochasticGradient(DataManager *dm, ConditionalRandomField *crfield, SearchIx si)
-  : LogLikelihoodGradient::LogLikelihoodGradient(dm, crfield, si)
+  : LogLikelihoodGradient::LogLikelihoodGradient(dm, crfield, si),
+    numThreads(getNumProcessors()), threadPool(NULL), batchCRF(NULL)
 {
 }
 
+// destructor
+StochasticGradient::~StochasticGradient() {
+  clearBatchWorkspace();
+  delete threadPool;
+}
+
+// copy using another CRF
+StochasticGradient *StochasticGradient::clone(ConditionalRandomField *crfield) {
+  StochasticGradient *copy = new StochasticGradient(dataManager, crfield, searchIx);
+  copy->setLambda(lambda);
+  return copy;
+}
+
 // stochastic gradient
 // use log-likelihood gradient by simply setting the search index
 void StochasticGradient::evaluate(Dvector &gradient, Weights &w, int imageNumber, bool normalized) {
@@ -16,3 +32,172 @@ void StochasticGradient::evaluate(Dvector &gradient, Weights &w, int imageNumber
   LogLikelihoodGradient::evaluate(gradient, w, normalized);
 }
 
+
+
+// sparse gradient over the visual words present in an image
+// minus the ground truth feature vectors (zero for images without the object)
+void StochasticGradient::initializeSparse(SparseVector &gradient, int imageNumber) {
+
+  Image &img = dataManager->getImages()[imageNumber];
+
+  gradient.index.clear();
+  gradient.value.clear();
+  if (dataManager->getBboxes()[imageNumber].numObject == 0) {
+    return;
+  }
+
+  gradient.index.assign(img.clusters, img.clusters + img.numClusters);
+  gradient.value.assign(img.numClusters, 0.0);
+
+  // the ground truth visual words are present in the image (clusters are sorted)
+  const vector<SparseFeatures> &objects = dataManager->getGroundTruthFeatures(imageNumber, getStepSize());
+  short *local;
+  for (size_t n=0; n<objects.size(); n++) {
+    for (size_t i=0; i<objects[n].words.size(); i++) {
+      local = lower_bound(img.clusters, img.clusters + img.numClusters, objects[n].words[i]);
+      gradient.value[local - img.clusters] -= objects[n].counts[i];
+    }
+  }
+}
+
+// sparse stochastic gradient for w = scale*v (without the regularizer)
+void StochasticGradient::evaluateSparse(SparseVector &gradient, Weights &v, double scale, int imageNumber, bool normalized) {
+
+  int numObject = dataManager->getBboxes()[imageNumber].numObject;
+
+  initializeSparse(gradient, imageNumber);
+  if (!normalized || numObject == 0) {
+    return;
+  }
+
+  // expectation (indexed by the visual words present in the image)
+  computeIntegralImage(imageNumber, v, scale);
+  slidingWindowExpectation(expectation, coverage, imageNumber);
+
+  // once for every object
+  for (size_t i=0; i<expectation.size(); i++) {
+    gradient.value[i] += numObject*expectation[i];
+  }
+}
+
+
+
+// MINI-BATCHES
+
+// evaluates the images of a mini-batch on the thread pool
+// every image has its own result slot, so no locking is needed
+class StochasticGradient::BatchTask : public ParallelTask {
+
+  public:
+
+    StochasticGradient *gradient;
+    Weights *v;
+    double scale;
+    const SearchIx *batch;
+    bool normalized;
+
+    void run(int job, int thread) {
+      gradient->threadGradients[thread]->evaluateSparse(gradient->batchGradients[job], *v, scale,
+                                                        (*batch)[job], normalized);
+    }
+
+};
+
+int StochasticGradient::getNumThreads() {
+  return numThreads;
+}
+
+void StochasticGradient::setNumThreads(int n) {
+  numThreads = n > 0 ? n : 1;
+
+  // thread pool and copies are made again on next use
+  delete threadPool;
+  threadPool = NULL;
+  clearBatchWorkspace();
+}
+
+void StochasticGradient::clearBatchWorkspace() {
+  for (size_t t=0; t<threadGradients.size(); t++) {
+    delete threadGradients[t];
+    delete batchCRFs[t];
+  }
+  threadGradients.clear();
+  batchCRFs.clear();
+  batchCRF = NULL;
+}
+
+// sum of the sparse gradients of a mini-batch
+void StochasticGradient::evaluateBatch(SparseVector &gradient, Weights &v, double scale, const SearchIx &batch, bool normalized) {
+
+  int numImages = batch.size();
+  batchGradients.resize(numImages);
+
+  if (numThreads <= 1 || numImages <= 1) {
+
+    // serial evaluation using the CRF of the gradient
+    for (int k=0; k<numImages; k++) {
+      evaluateSparse(batchGradients[k], v, scale, batch[k], normalized);
+    }
+
+  } else {
+
+    // copies of the gradient, each with its own CRF (and sampler), made again
+    // when a setting of the CRF has changed (e.g. the step size between the
+    // stages of a coarse-to-fine schedule)
+    if ((int) threadGradients.size() != numThreads || batchCRF != crf ||
+        batchCRFs[0]->getSettingsVersion() != crf->getSettingsVersion()) {
+      clearBatchWorkspace();
+      batchCRF = crf;
+      batchCRFs.resize(numThreads);
+      threadGradients.resize(numThreads);
+      for (int t=0; t<numThreads; t++) {
+        batchCRFs[t] = crf->clone();
+        threadGradients[t] = clone(batchCRFs[t]);
+      }
+    }
+    if (threadPool == NULL) {
+      threadPool = new ThreadPool(numThreads);
+    }
+
+    // the ground truth features are computed on first use, so not by the threads
+    dataManager->getGroundTruthFeatures(batch[0], getStepSize());
+
+    SearchIx jobs(numImages);
+    for (int k=0; k<numImages; k++) {
+      jobs[k] = k;
+    }
+
+    BatchTask task;
+    task.gradient = this;
+    task.v = &v;
+    task.scale = scale;
+    task.batch = &batch;
+    task.normalized = normalized;
+    threadPool->run(task, jobs);
+  }
+
+  // sum up in the order of the batch (the visual words of an image are sorted)
+  if (batchSum.size() != v.size()) {
+    batchSum.assign(v.size(), 0.0);
+    batchMark.assign(v.size(), 0);
+  }
+  gradient.index.clear();
+  for (int k=0; k<numImages; k++) {
+    const SparseVector &g = batchGradients[k];
+    for (size_t i=0; i<g.index.size(); i++) {
+      if (!batchMark[g.index[i]]) {
+        batchMark[g.index[i]] = 1;
+        gradient.index.push_back(g.index[i]);
+      }
+      batchSum[g.index[i]] += g.value[i];
+    }
+  }
+  sort(gradient.index.begin(), gradient.index.end());
+
+  gradient.value.resize(gradient.index.size());
+  for (size_t i=0; i<gradient.index.size(); i++) {
+    gradient.value[i] = batchSum[gradient.index[i]];
+    batchSum[gradient.index[i]] = 0.0;
+    batchMark[gradient.index[i]] = 0;
+  }
+}
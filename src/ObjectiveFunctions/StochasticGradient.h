@@ -1,19 +1,82 @@
 #ifndef _STOCHASTIC_GRADIENT_H_
 #define _STOCHASTIC_GRADIENT_H_
 
+#include <vector>
+
 #include "LogLikelihoodGradient.h"
+#include "Parallel/ThreadPool.h"
 
 // stochastic gradient derived from the loglikelihood gradient class
 class StochasticGradient : public LogLikelihoodGradient {
 
+  protected:
+
+    // set up a sparse gradient over the visual words present in an image
+    // and subtract the ground truth feature vectors of its objects
+    void initializeSparse(SparseVector &gradient, int imageNumber);
+
+  private:
+
+    // workspace of evaluateSparse (kept between images, so a step does not
+    // allocate vectors of the size of the integral image or the weights)
+    Dvector coverage;
+    Dvector expectation;
+
+    // threads used by evaluateBatch
+    int numThreads;
+    ThreadPool *threadPool;
+
+    // evaluates the images of a mini-batch on the thread pool
+    class BatchTask;
+
+    // copies of the gradient used by evaluateBatch, one for each thread
+    // (made from the CRF batchCRF, each with its own copy of it)
+    std::vector<StochasticGradient *> threadGradients;
+    std::vector<ConditionalRandomField *> batchCRFs;
+    ConditionalRandomField *batchCRF;
+
+    // gradients of the images of the last mini-batch and dense workspace
+    // for summing them up
+    std::vector<SparseVector> batchGradients;
+    Dvector batchSum;
+    Ivector batchMark;
+
+    // not copyable (owns the thread pool)
+    StochasticGradient(const StochasticGradient &);
+    StochasticGradient &operator=(const StochasticGradient &);
+
   public:
   
-    // constructor
+    // constructor and destructor
     StochasticGradient(DataManager *dm=NULL, ConditionalRandomField *crfield=NULL, SearchIx si=SearchIx());
+    virtual ~StochasticGradient();
+
+    // copy using another CRF (used as workspace by parallel learners)
+    virtual StochasticGradient *clone(ConditionalRandomField *crfield);
 
     // evaluate stochastic
     virtual void evaluate(Dvector &gradient, Weights &w, int imageNumber, bool normalized = true);
 
+    // sparse stochastic gradient at w = scale*v without the regularizer
+    // (the full gradient is 2*lambda*w plus the returned sparse vector,
+    // which only holds the visual words present in the image)
+    virtual void evaluateSparse(SparseVector &gradient, Weights &v, double scale, int imageNumber, bool normalized = true);
+
+    // number of threads used by evaluateBatch
+    // (defaults to the number of processors, 1 evaluates serially)
+    int getNumThreads();
+    void setNumThreads(int n);
+
+    // sum of the sparse stochastic gradients of a mini-batch of images at
+    // w = scale*v without the regularizer (sorted by visual word). The images
+    // are evaluated in parallel (getNumThreads) and summed in the order of the
+    // batch, so the result does not depend on the number of threads
+    void evaluateBatch(SparseVector &gradient, Weights &v, double scale, const SearchIx &batch, bool normalized = true);
+
+    // forget the copies used by evaluateBatch (made again on the next call,
+    // e.g. after the settings of the gradient changed)
+    void clearBatchWorkspace();
+
 };
 
 #endif // _STOCHASTIC_GRADIENT_H_
@@ -0,0 +1,188 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <unistd.h>
+#include <new>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+// argument passed to a worker thread
+struct WorkerArg {
+  ThreadPool *pool;
+  int thread;
+};
+
+// number of processors available
+int getNumProcessors() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+}
+
+
+// constructor (starts the threads)
+ThreadPool::ThreadPool(int numThreads_) :
+  numThreads(numThreads_ > 0 ? numThreads_ : 1),
+  task(NULL),
+  jobs(NULL),
+  nextJob(0),
+  generation(0),
+  busy(0),
+  failure(NO_FAILURE),
+  error(0),
+  stop(false)
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&workCond, NULL);
+  pthread_cond_init(&doneCond, NULL);
+
+  threads.resize(numThreads);
+  for (int t=0; t<numThreads; t++) {
+    WorkerArg *arg = new WorkerArg;
+    arg->pool = this;
+    arg->thread = t;
+    pthread_create(&threads[t], NULL, worker, arg);
+  }
+}
+
+// destructor (stops and joins the threads)
+ThreadPool::~ThreadPool() {
+  pthread_mutex_lock(&mutex);
+  stop = true;
+  pthread_cond_broadcast(&workCond);
+  pthread_mutex_unlock(&mutex);
+
+  for (int t=0; t<numThreads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  pthread_cond_destroy(&doneCond);
+  pthread_cond_destroy(&workCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+int ThreadPool::getNumThreads() {
+  return numThreads;
+}
+
+
+// run task on all jobs and wait until they are done
+void ThreadPool::run(ParallelTask &task_, const vector<int> &jobs_) {
+
+  pthread_mutex_lock(&mutex);
+  task = &task_;
+  jobs = &jobs_;
+  nextJob = 0;
+  failure = NO_FAILURE;
+  error = 0;
+  message.clear();
+  busy = numThreads;
+  generation++;
+  pthread_cond_broadcast(&workCond);
+
+  // wait for all threads to finish
+  while (busy > 0) {
+    pthread_cond_wait(&doneCond, &mutex);
+  }
+  int runFailure = failure;
+  int runError = error;
+  string runMessage = message;
+  task = NULL;
+  jobs = NULL;
+  pthread_mutex_unlock(&mutex);
+
+  if (runFailure == ERROR_CODE) {
+    throw runError;
+  } else if (runFailure == OUT_OF_MEMORY) {
+    throw bad_alloc();
+  } else if (runFailure == EXCEPTION) {
+    throw runtime_error(runMessage);
+  }
+}
+
+
+// main loop of the worker threads
+void *ThreadPool::worker(void *arg) {
+  WorkerArg *workerArg = (WorkerArg *) arg;
+  ThreadPool *pool = workerArg->pool;
+  int thread = workerArg->thread;
+  delete workerArg;
+
+  pool->work(thread);
+  return NULL;
+}
+
+void ThreadPool::work(int thread) {
+
+  int seen = 0;
+  int job;
+
+  pthread_mutex_lock(&mutex);
+  while (true) {
+
+    // wait for the next run
+    while (!stop && generation == seen) {
+      pthread_cond_wait(&workCond, &mutex);
+    }
+    if (stop) {
+      break;
+    }
+    seen = generation;
+
+    // take jobs one at a time until none are left
+    // (after a failure the remaining jobs are skipped)
+    while (failure == NO_FAILURE && nextJob < jobs->size()) {
+      job = (*jobs)[nextJob++];
+      pthread_mutex_unlock(&mutex);
+
+      int jobFailure = NO_FAILURE;
+      int jobError = 0;
+      string jobMessage;
+      try {
+        task->run(job, thread);
+      }
+      catch (int e) {
+        jobFailure = ERROR_CODE;
+        jobError = e;
+      }
+      catch (bad_alloc &) {
+        jobFailure = OUT_OF_MEMORY;
+      }
+      catch (exception &e) {
+        jobFailure = EXCEPTION;
+        jobMessage = e.what();
+      }
+      catch (...) {
+        jobFailure = EXCEPTION;
+        jobMessage = "unknown exception in a thread pool job";
+      }
+
+      pthread_mutex_lock(&mutex);
+      if (jobFailure != NO_FAILURE && failure == NO_FAILURE) {
+        failure = jobFailure;
+        error = jobError;
+        message = jobMessage;
+      }
+    }
+
+    // last thread to finish wakes up the caller
+    busy--;
+    if (busy == 0) {
+      pthread_cond_signal(&doneCond);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
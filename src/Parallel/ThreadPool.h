@@ -0,0 +1,93 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <string>
+#include <pthread.h>
+
+
+// task executed by the thread pool
+// run is called once for every job with the index of the thread running it
+class ParallelTask {
+
+  public:
+
+    virtual ~ParallelTask() {}
+
+    virtual void run(int job, int thread) = 0;
+
+};
+
+
+// fixed set of worker threads (pthreads)
+// jobs are handed out one at a time in the given order, so threads that finish
+// early pick up the next job. Ordering the jobs from longest to shortest gives
+// longest-job-first scheduling
+class ThreadPool {
+
+  private:
+
+    int numThreads;
+    std::vector<pthread_t> threads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t workCond;    // signalled when a new run starts or the pool stops
+    pthread_cond_t doneCond;    // signalled when the last thread finishes a run
+
+    // current run
+    ParallelTask *task;
+    const std::vector<int> *jobs;
+    size_t nextJob;
+    int generation;             // incremented for every run
+    int busy;                   // number of threads still working on the run
+    int failure;                // what the first failing job threw (NO_FAILURE if none)
+    int error;                  // its error code
+    std::string message;        // or the message of its exception
+    bool stop;
+
+    // kinds of failures of a job
+    enum { NO_FAILURE, ERROR_CODE, OUT_OF_MEMORY, EXCEPTION };
+
+    // main loop of the worker threads
+    static void *worker(void *arg);
+    void work(int thread);
+
+    // not copyable
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+
+  public:
+
+    // constructor and destructor (starts and joins the threads)
+    ThreadPool(int numThreads);
+    ~ThreadPool();
+
+    int getNumThreads();
+
+    // run task on all jobs and wait until they are done
+    // an error code thrown by a job is rethrown here once all threads are idle,
+    // as is std::bad_alloc, and other exceptions as std::runtime_error with
+    // their message (exceptions can not be copied between threads in C++98)
+    void run(ParallelTask &task, const std::vector<int> &jobs);
+
+};
+
+// number of processors available
+int getNumProcessors();
+
+
+#endif // _THREAD_POOL_H_
@@ -13,6 +13,11 @@
  */
 
 #include <cmath>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
 #include "PiecewiseConditionalRandomField.h"
 
 // implementation of piecewise conditional random field
@@ -22,6 +27,11 @@ using namespace std;
 PiecewiseConditionalRandomField::PiecewiseConditionalRandomField(DataManager *dataman) : 
   ConditionalRandomField(dataman) { }
 
+// copy of the CRF
+ConditionalRandomField *PiecewiseConditionalRandomField::clone() const {
+  return new PiecewiseConditionalRandomField(*this);
+}
+
 // sliding window using log of sum of exponentials
 void PiecewiseConditionalRandomField::slidingWindowLogSumExp(Dvector &logZ_F)
 {
@@ -150,6 +160,90 @@ void PiecewiseConditionalRandomField::slidingWindowLogSumExp(Dvector &logZ_F)
 }
 
 
+// KERNELS
+
+// row[x] = c_plus*p_plus[x] - c_minus*p_minus[x] + row[x]
+// (same operations in the same order with and without SSE2)
+static void addFactorRow(double *row, const double *p_plus, const double *p_minus,
+                         double c_plus, double c_minus, int n) {
+  int x = 0;
+#ifdef __SSE2__
+  __m128d cp = _mm_set1_pd(c_plus);
+  __m128d cm = _mm_set1_pd(c_minus);
+  for (; x+2 <= n; x += 2) {
+    __m128d v = _mm_sub_pd(_mm_mul_pd(cp, _mm_loadu_pd(p_plus+x)), _mm_mul_pd(cm, _mm_loadu_pd(p_minus+x)));
+    _mm_storeu_pd(row+x, _mm_add_pd(v, _mm_loadu_pd(row+x)));
+  }
+#endif
+  for (; x < n; x++) {
+    row[x] = (c_plus*p_plus[x] - c_minus*p_minus[x]) + row[x];
+  }
+}
+
+
+// expected feature map summed over the four factors
+// the expectation is a weighted sum of the integral histogram over all cells,
+// sum_(x,y) f(x,y)*H(x,y), where the weight f(x,y) depends on which factors 
+// the cell belongs to. Since H(x,y) counts the features up and to the left of
+// (x,y), this equals sum_features F(x,y)*e_c where F is f summed down and to the
+// right of the feature's cell. F is computed in one pass from the bottom row up,
+// keeping the column sums of the rows below
+void PiecewiseConditionalRandomField::slidingWindowExpectation(Dvector &expectation, const Dvector &logZ_F, int imageNumber)
+{
+  int W = iiWidth;
+  int H = iiHeight;
+
+  // scaling of the factors (xh,yl) and (xh,yh)
+  // expectation = expectation_xlyl + expectation_xlyh + 
+  //               expectation_xhyl + expectation_xhyh
+  double xlyh2xhyl = exp(logZ_F[1] - logZ_F[2]);
+  double xlyl2xhyh = exp(logZ_F[0] - logZ_F[3]);
+
+  // workspace (reused between images)
+  featureField.resize(W*H);
+  pPlus.resize(W);
+  pMinus.resize(W);
+  columnSum.assign(W, 0.0);
+
+  for (int y = H-1; y >= 0; y--) {
+
+    // factor probabilities of the cells in the row
+    for (int x = 0; x < W; x++) {
+      pPlus[x]  = exp(integralImage[iiOffset(x,y)] - logZ_F[0]);
+      pMinus[x] = exp(-integralImage[iiOffset(x,y)] - logZ_F[1]);
+    }
+
+    // weights of the cells added to the column sums
+    // interior of the row first, then the west and east cells
+    if (y == H-1) {
+      // south
+      addFactorRow(&columnSum[1], &pPlus[1], &pMinus[1], xlyl2xhyh, 1.0, W-2);
+      columnSum[0]   = -pMinus[0] + columnSum[0];
+      columnSum[W-1] = xlyl2xhyh*pPlus[W-1] + columnSum[W-1];
+    } else if (y == 0) {
+      // north
+      addFactorRow(&columnSum[1], &pPlus[1], &pMinus[1], 1.0, xlyh2xhyl, W-2);
+      columnSum[0]   = pPlus[0] + columnSum[0];
+      columnSum[W-1] = -xlyh2xhyl*pMinus[W-1] + columnSum[W-1];
+    } else {
+      // base
+      addFactorRow(&columnSum[1], &pPlus[1], &pMinus[1], 1 + xlyl2xhyh, 1 + xlyh2xhyl, W-2);
+      columnSum[0]   = (pPlus[0] - pMinus[0]) + columnSum[0];
+      columnSum[W-1] = (xlyl2xhyh*pPlus[W-1] - xlyh2xhyl*pMinus[W-1]) + columnSum[W-1];
+    }
+
+    // sum to the right
+    featureField[iiOffset(W-1,y)] = columnSum[W-1];
+    for (int x = W-2; x >= 0; x--) {
+      featureField[iiOffset(x,y)] = columnSum[x] + featureField[iiOffset(x+1,y)];
+    }
+  }
+
+  // scatter onto the features of the image
+  accumulateFeatureField(expectation, featureField, imageNumber);
+}
+
+
 // marginal probability of one corner (that is two connected sides) of the bbox
 double PiecewiseConditionalRandomField::cornerP(int xvar, int yvar, const Bbox &bbox, int imageNumber, const Weights &w, bool computeIIlogZ, Dvector logZ_F, double maxScore) {
   
@@ -23,13 +23,26 @@
 // for computing probabilities of bounding boxes
 // as well as conditional probabilities of the individual box coordinates
 class PiecewiseConditionalRandomField : public ConditionalRandomField {
+
+  private:
+
+    // workspace for the expectation
+    Dvector featureField;
+    Dvector pPlus, pMinus;
+    Dvector columnSum;
   
   public:
     
     PiecewiseConditionalRandomField(DataManager *dataman);  
+
+    // copy of the CRF
+    virtual ConditionalRandomField *clone() const;
     
     // only difference is the normalization
     void slidingWindowLogSumExp(Dvector &logZ_F); 
+
+    // expected feature map summed over the four factors (added to expectation)
+    void slidingWindowExpectation(Dvector &expectation, const Dvector &logZ_F, int imageNumber);
     
     // marginal probability of one corner (that is two connected sides) of the bbox
     double cornerP(int xvar, int yvar, const Bbox &bbox, int imageNumber, const Weights &w, bool computeIIlogZ = true, Dvector logZ_F = Dvector(4,0.0), double maxScore = 0.0);
@@ -0,0 +1,108 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#ifndef _SYNTHETIC_DATA_H_
+#define _SYNTHETIC_DATA_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "DataManager.h"
+#include "Types.h"
+
+// small synthetic dataset for the tests that check the learners without the
+// real data: numImages images of 90-160 x 70-130 pixels with 100-400
+// features of numWords visual words and 0-2 objects each (odd images only use
+// the first half of the words, image 5 has no object). The same seed gives
+// the same dataset on every platform
+
+// random number in [lo, hi] of a linear congruential generator
+inline int syntheticRandom(unsigned &state, int lo, int hi) {
+  state = state*1103515245u + 12345u;
+  return lo + (int) ((state >> 16) % (unsigned) (hi - lo + 1));
+}
+
+// write the dataset to a temporary directory, load it and remove the files
+// (throws FILE_NOT_FOUND if the directory can not be created)
+inline void loadSyntheticSet(DataManager &dataman, int numImages = 12, int numWords = 50, unsigned seed = 3) {
+
+  char dir[] = "/tmp/crfSyntheticXXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    throw FILE_NOT_FOUND;
+  }
+  std::string path(dir);
+  std::string subsetPath = path + "/subset.txt";
+  std::string bboxPath = path + "/boxes.ess";
+  std::vector<std::string> files;
+
+  std::ofstream subset(subsetPath.c_str());
+  std::ofstream boxes(bboxPath.c_str());
+  unsigned state = seed;
+  for (int n=0; n<numImages; n++) {
+    int width = syntheticRandom(state, 90, 160);
+    int height = syntheticRandom(state, 70, 130);
+    int numFeatures = syntheticRandom(state, 100, 400);
+    int maxWord = (n % 2) ? numWords/2 : numWords-1;
+
+    // features stored as shorts x_0 ... x_n y_0 ... y_n c_0 ... c_n
+    std::vector<short> xyc(3*numFeatures);
+    for (int i=0; i<numFeatures; i++) {
+      xyc[i] = syntheticRandom(state, 0, width-1);
+      xyc[numFeatures+i] = syntheticRandom(state, 0, height-1);
+      xyc[2*numFeatures+i] = syntheticRandom(state, 0, maxWord);
+    }
+    std::ostringstream name;
+    name << "img" << n;
+    files.push_back(path + "/" + name.str() + ".xyc");
+    std::ofstream fs(files.back().c_str(), std::ios::binary);
+    fs.write((const char *) &xyc[0], sizeof(short)*xyc.size());
+    fs.close();
+    subset << name.str() << " " << width << " " << height << "\n";
+
+    int numObject = (n == 5) ? 0 : ((n % 4 == 0) ? 2 : 1);
+    boxes << name.str() << " " << numObject;
+    for (int k=0; k<numObject; k++) {
+      int left = syntheticRandom(state, 0, width/2);
+      int top = syntheticRandom(state, 0, height/2);
+      boxes << " " << left << " " << top << " " << syntheticRandom(state, left+5, width-1);
+      boxes << " " << syntheticRandom(state, top+5, height-1);
+    }
+    boxes << "\n";
+  }
+  subset.close();
+  boxes.close();
+
+  // the data is kept in memory
+  try {
+    dataman.loadImages(path, subsetPath);
+    dataman.loadBboxes(bboxPath);
+  }
+  catch (int e) {
+    fprintf(stderr, "Could not load the synthetic dataset in %s\n", dir);
+    throw;
+  }
+  for (size_t i=0; i<files.size(); i++) {
+    unlink(files[i].c_str());
+  }
+  unlink(subsetPath.c_str());
+  unlink(bboxPath.c_str());
+  rmdir(dir);
+}
+
+#endif // _SYNTHETIC_DATA_H_
@@ -0,0 +1,306 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "DataManager.h"
+#include "ConditionalRandomField.h"
+#include "ObjectiveFunctions/LogLikelihood.h"
+#include "ObjectiveFunctions/LogLikelihoodGradient.h"
+#include "ObjectiveFunctions/HessianVectorProduct.h"
+#include "ObjectiveFunctions/StochasticGradient.h"
+#include "ObjectiveFunctions/SampledGradient.h"
+#include "Inference/GibbsSampler.h"
+#include "Learning/LBFGS.h"
+#include "Learning/NewtonCG.h"
+#include "Learning/StochasticGradientDescent.h"
+#include "Learning/SVRG.h"
+#include "Learning/SAGA.h"
+#include "Learning/ContrastiveDivergence.h"
+#include "Measures/LossMeasures.h"
+#include "Types.h"
+
+using namespace std;
+
+// benchmarks of the learners on the real datasets (the behavior of each
+// learner is checked on a synthetic dataset by its own test program)
+//
+// usage: benchmarkLearners [newton] [variance] [hogwild] [max threads]
+
+struct Dataset {
+  const char *name;
+  const char *imagePath;
+  const char *subsetPath;
+  const char *bboxPath;
+  const char *valImagePath;
+  const char *valSubsetPath;
+  const char *valBboxPath;
+};
+
+static const Dataset datasets[] = {
+  {"tucow", "../cows-train/EUCSURF-3000/", "../subsets/cows_train10_width_height.txt",
+   "../cows-train/Annotations/TUcow_train10.ess", "../cows-test/EUCSURF-3000/",
+   "../subsets/cows_test_width_height_sorted.txt", "../cows-test/Annotations/TUcow_test_sorted.ess"},
+  {"cat", "../pascal/USURF3K/", "../subsets/train_width_height.txt",
+   "../pascal/Annotations/ess/cat_train.ess", "../pascal/USURF3K/",
+   "../subsets/val_width_height.txt", "../pascal/Annotations/ess/cat_val.ess"}
+};
+static const int numDatasets = sizeof(datasets)/sizeof(datasets[0]);
+
+// load the training or validation images of a dataset
+// (returns false if its files are missing, other errors are thrown)
+bool loadDataset(DataManager &dataman, const Dataset &set, bool validation = false) {
+  try {
+    if (validation) {
+      dataman.loadImages(set.valImagePath, set.valSubsetPath);
+      dataman.loadBboxes(set.valBboxPath);
+    } else {
+      dataman.loadImages(set.imagePath, set.subsetPath);
+      dataman.loadBboxes(set.bboxPath);
+    }
+  }
+  catch (int e) {
+    if (e == FILE_NOT_FOUND) {
+      fprintf(stderr, "%s: could not open the dataset, skipping\n", set.name);
+      return false;
+    }
+    throw;
+  }
+  return true;
+}
+
+// compare Newton-CG with LBFGS on the log-likelihood
+// (iterations, objective evaluations and wall time)
+void benchmarkNewton(const Dataset &set) {
+
+  DataManager dataman;
+  if (!loadDataset(dataman, set)) return;
+
+  ConditionalRandomField crf(&dataman);
+  int numWeights = 3000;
+  Weights w(numWeights, 0.0);
+  crf.setStepSize(32);
+
+  // use one thread so the timings compare the learners
+  LogLikelihood loglik(&dataman, &crf);
+  loglik.setLambda(2.0);
+  loglik.setNumThreads(1);
+
+  LogLikelihoodGradient loglikgrad(&dataman, &crf);
+  loglikgrad.setLambda(2.0);
+
+  HessianVectorProduct hvp(&dataman, &crf);
+  hvp.setLambda(2.0);
+
+  // LBFGS
+  LBFGS lbfgs(&loglik, &loglikgrad);
+  double start = getwalltime();
+  Weights wLBFGS = lbfgs.learnWeights(w);
+  double timeLBFGS = getwalltime() - start;
+  double objLBFGS = loglik.evaluate(wLBFGS);
+
+  // Newton-CG
+  NewtonCG newton(&loglik, &loglikgrad, &hvp);
+  start = getwalltime();
+  Weights wNewton = newton.learnWeights(w);
+  double timeNewton = getwalltime() - start;
+  double objNewton = loglik.evaluate(wNewton);
+
+  printf("%s:\n", set.name);
+  printf("  LBFGS:     %4d iterations, objective %f, %.1f s\n",
+         lbfgs.getIterations(), objLBFGS, timeLBFGS);
+  printf("  Newton-CG: %4d iterations, %d evaluations, %d Hessian-vector products, objective %f, %.1f s\n",
+         newton.getIterations(), newton.getFunctionEvaluations(), newton.getHessianEvaluations(),
+         objNewton, timeNewton);
+}
+
+// print objective value against learning time
+void printTrace(const char *name, GradientDescent &learner, double offset = 0.0) {
+  const Dvector &times = learner.getTraceTimes();
+  const Dvector &objectives = learner.getTraceObjectives();
+  printf("%s:\n", name);
+  for (size_t i=0; i<times.size(); i++) {
+    printf("  %8.2f s  %f\n", offset + times[i], objectives[i]);
+  }
+}
+
+// compare SVRG and SAGA with SGD and LBFGS on the log-likelihood
+void benchmarkVarianceReduction(const Dataset &set, double lambda, double eta, int epochs) {
+
+  DataManager dataman;
+  if (!loadDataset(dataman, set)) return;
+
+  ConditionalRandomField crf(&dataman);
+  int numWeights = 3000;
+  Weights w(numWeights, 0.0);
+  crf.setStepSize(32);
+
+  LogLikelihood loglik(&dataman, &crf);
+  loglik.setLambda(lambda);
+
+  LogLikelihoodGradient loglikgrad(&dataman, &crf);
+  loglikgrad.setLambda(lambda);
+
+  StochasticGradient stochgrad(&dataman, &crf);
+  stochgrad.setLambda(lambda);
+
+  printf("%s (lambda = %g)\n", set.name, lambda);
+
+  // LBFGS
+  LBFGS lbfgs(&loglik, &loglikgrad);
+  lbfgs.learnWeights(w);
+
+  // SGD (the learning rate search is counted as learning time)
+  StochasticGradientDescent sgd(&loglik, &stochgrad);
+  sgd.setMaxEpochs(epochs);
+  sgd.setAlpha(lambda);
+  double start = getwalltime();
+  sgd.initializeLearningRate(w, 1e-3, 0, true);
+  double initTime = getwalltime() - start;
+  sgd.learnWeights(w);
+
+  // SVRG and SAGA with a constant learning rate
+  SVRG svrg(&loglik, &loglikgrad, &stochgrad);
+  svrg.setEta(eta);
+  svrg.setMaxEpochs(epochs);
+  svrg.learnWeights(w);
+
+  SAGA saga(&loglik, &loglikgrad, &stochgrad);
+  saga.setEta(eta);
+  saga.setMaxEpochs(epochs);
+  saga.learnWeights(w);
+
+  printf("\n%s: objective against learning time\n", set.name);
+  printTrace("LBFGS", lbfgs);
+  printTrace("SGD (including learning rate search)", sgd, initTime);
+  printTrace("SVRG", svrg);
+  printTrace("SAGA", saga);
+  printf("\n");
+}
+
+// train with 1, 2, 4, ..., maxThreads threads and print the time per epoch,
+// the speedup, the final objective and the AUC on the validation images
+// (contrastive divergence when sampledgrad is given, SGD otherwise)
+void scaling(const char *name, LogLikelihood &loglik, StochasticGradient *stochgrad, SampledGradient *sampledgrad,
+             double alpha, double t0, DataManager &valData, int stepSize, int epochs, int maxThreads) {
+
+  int numWeights = 3000;
+  Weights w(numWeights, 0.0);
+  Weights result;
+  StochasticGradientDescent *learner;
+  double start, epochTime, serialTime = 0.0;
+  RecallOverlap recallOverlap;
+
+  printf("%s:\n", name);
+  printf("  threads  s/epoch  speedup  objective      AUC\n");
+  for (int threads=1; threads<=maxThreads; threads*=2) {
+
+    // a new learner, so every run starts at the same learning rate
+    if (sampledgrad != NULL) {
+      learner = new ContrastiveDivergence(&loglik, sampledgrad);
+    } else {
+      learner = new StochasticGradientDescent(&loglik, stochgrad);
+    }
+    learner->setAlpha(alpha);
+    learner->setT0(t0);
+    learner->setMaxEpochs(epochs);
+    learner->setNumThreads(threads);
+
+    start = getwalltime();
+    result = learner->learnWeights(w);
+    epochTime = (getwalltime() - start)/epochs;
+    if (threads == 1) {
+      serialTime = epochTime;
+    }
+    delete learner;
+
+    valData.setWeights(result);
+    recallOverlap = computeRecallOverlap(valData, SearchIx(), stepSize, true);
+
+    printf("  %7d  %7.2f  %7.2f  %9.4f  %7.4f\n", threads, epochTime, serialTime/epochTime,
+           loglik.evaluate(result), recallOverlap.AUC);
+  }
+}
+
+// scaling of Hogwild SGD and contrastive divergence
+void benchmarkHogwild(const Dataset &set, double lambda, int epochs, int maxThreads) {
+
+  DataManager dataman, valData;
+  if (!loadDataset(dataman, set) || !loadDataset(valData, set, true)) return;
+
+  ConditionalRandomField crf(&dataman);
+  int stepSize = 32;
+  int numWeights = 3000;
+  Weights w(numWeights, 0.0);
+  crf.setStepSize(stepSize);
+
+  LogLikelihood loglik(&dataman, &crf);
+  loglik.setLambda(lambda);
+
+  StochasticGradient stochgrad(&dataman, &crf);
+  stochgrad.setLambda(lambda);
+
+  GibbsSampler gibbs(&crf);
+  SampledGradient sampledgrad(&dataman, &crf, &gibbs);
+  sampledgrad.setLambda(lambda);
+
+  printf("%s (lambda = %g)\n", set.name, lambda);
+
+  // the same learning rate for all numbers of threads
+  StochasticGradientDescent sgd(&loglik, &stochgrad);
+  sgd.setAlpha(lambda);
+  sgd.initializeLearningRate(w, 1e-3, 0, true);
+
+  scaling("Hogwild SGD", loglik, &stochgrad, NULL, lambda, sgd.getT0(), valData, stepSize, epochs, maxThreads);
+  scaling("Hogwild contrastive divergence", loglik, &stochgrad, &sampledgrad, lambda, sgd.getT0(),
+          valData, stepSize, epochs, maxThreads);
+  printf("\n");
+}
+
+// run the benchmark if it was selected (all are run when none is)
+bool selected(int argc, char **argv, const char *benchmark) {
+  bool any = false;
+  for (int i=1; i<argc; i++) {
+    if (strcmp(argv[i], benchmark) == 0) return true;
+    any = any || atoi(argv[i]) == 0;
+  }
+  return !any;
+}
+
+int main(int argc, char **argv) {
+
+  // the last argument is the maximum number of threads if it is a number
+  int maxThreads = (argc > 1 && atoi(argv[argc-1]) > 0) ? atoi(argv[argc-1]) : 32;
+
+  try {
+    for (int d=0; d<numDatasets; d++) {
+      if (selected(argc, argv, "newton")) benchmarkNewton(datasets[d]);
+      if (selected(argc, argv, "variance")) benchmarkVarianceReduction(datasets[d], 1.0, 1e-3, 20);
+      if (selected(argc, argv, "hogwild")) benchmarkHogwild(datasets[d], 1.0, 10, maxThreads);
+    }
+  }
+  catch (int e) {
+    fprintf(stderr, "Benchmark threw exception %d\n", e);
+    return e;
+  }
+
+  // peak memory of the benchmarks run (e.g. for the integral histogram layouts)
+  printf("Peak memory: %.1f MB\n", getpeakmemory());
+  cout << "Done!" << endl;
+
+  return 0;
+}
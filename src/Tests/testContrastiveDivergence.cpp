@@ -16,6 +16,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 #include "Types.h"
 #include "DataManager.h"
@@ -23,11 +24,90 @@
 #include "ObjectiveFunctions/SampledGradient.h"
 #include "Learning/ContrastiveDivergence.h"
 #include "Learning/LBFGS.h"
+#include "Inference/GibbsSampler.h"
+#include "Tests/SyntheticData.h"
 
 using namespace std;
 
+// checks the persistent chains of the Gibbs sampler on the synthetic dataset:
+// a chain starts at the given box, continues from the box stored in it, the
+// other chain of the image is not moved, and the mixing statistics are rates
+// (returns the number of failed checks)
+int checkPersistentChains() {
+
+  DataManager dataman;
+  loadSyntheticSet(dataman);
+
+  ConditionalRandomField crf(&dataman);
+  crf.setStepSize(8);
+  int numWeights = 50;
+  Weights w(numWeights);
+  for (int i=0; i<numWeights; i++) {
+    w[i] = 0.1*((i % 5) - 2);
+  }
+
+  GibbsSampler gibbs(&crf);
+  gibbs.setPersistentChains(2);
+
+  // boxes on the grid of every synthetic image
+  short startBox[4] = {1, 1, 4, 4};
+  short otherBox[4] = {0, 0, 2, 2};
+  Bbox start, other;
+  start.numObject = other.numObject = 1;
+  start.ltrb = startBox;
+  other.ltrb = otherBox;
+
+  int failed = 0;
+  int numImages = crf.getNumImages();
+  short stored[4];
+  for (int n=0; n<numImages; n++) {
+    Bbox *current = gibbs.getCurrentSample(n);
+
+    gibbs.loadChain(n, 0, start);
+    bool started = equal(startBox, startBox+4, current->ltrb);
+
+    gibbs.sample(10, w, n);
+    copy(current->ltrb, current->ltrb+4, stored);
+    gibbs.storeChain(n, 0);
+
+    gibbs.loadChain(n, 0, other);
+    bool continued = equal(stored, stored+4, current->ltrb);
+
+    gibbs.loadChain(n, 1, other);
+    bool untouched = equal(startBox, startBox+4, current->ltrb);
+
+    if (!(started && continued && untouched)) {
+      printf("Persistent chains of image %d: started %d, continued %d, other chain untouched %d FAILED\n",
+             n, started, continued, untouched);
+      failed++;
+    }
+  }
+  printf("Persistent chains: loadChain returns the stored box for %d of %d images\n",
+         numImages - failed, numImages);
+
+  double moveRate = gibbs.getMoveRate();
+  double overlap = gibbs.getChainOverlap();
+  bool ok = moveRate > 0.0 && moveRate <= 1.0 && overlap >= 0.0 && overlap <= 1.0;
+  failed += !ok;
+  printf("Mixing statistics: move rate %f, chain overlap %f %s\n", moveRate, overlap, ok ? "OK" : "FAILED");
+
+  return failed;
+}
+
 //int testStochasticGradient() {
 int main(int argc, char **argv) {
+
+  try {
+    int failed = checkPersistentChains();
+    if (failed > 0) {
+      cout << failed << " checks failed!" << endl;
+      return 1;
+    }
+  }
+  catch (int e) {
+    fprintf(stderr, "The persistent chain checks threw exception %d\n", e);
+    return e;
+  }
   
   // initialize data manager
   DataManager dataman;
@@ -38,9 +118,11 @@ int main(int argc, char **argv) {
   }
   catch (int e) {
     if (e == FILE_NOT_FOUND) {
-      fprintf(stderr, "There was a problem opening a file!\n");
-      return -1;
+      fprintf(stderr, "Could not open the cows dataset, skipping the training\n");
+      return 0;
     }
+    fprintf(stderr, "Loading the cows dataset threw exception %d\n", e);
+    return e;
   }
   
   // create conditional random field
@@ -69,7 +151,11 @@ int main(int argc, char **argv) {
   GibbsSampler gibbs(&crf);
   SampledGradient samplgrad(&dataman, &crf, &gibbs);
   samplgrad.setLambda(2.0);
-  
+
+  // persistent contrastive divergence with the given number of chains per image
+  // (usage: testContrastiveDivergence [numChains])
+  int numChains = argc > 1 ? atoi(argv[1]) : 0;
+
   
   // test evaluate
   printf("Computing log-likelihood...\n");
@@ -88,6 +174,7 @@ int main(int argc, char **argv) {
   double alpha  = 1;
   double t0     = 0; 
   ContrastiveDivergence cd(&loglik, &samplgrad, k, alpha, t0);
+  samplgrad.setNumChains(numChains);
   LBFGS lbfgs(&loglik, &loglikgrad);
   Weights w_new(numWeights, 0.0);
 
@@ -137,6 +224,7 @@ int main(int argc, char **argv) {
     cdTimeFile << "CD:             " <<   cdtime << endl;
     cdTimeFile << "LBFGS:          " <<   lbfgstime << endl;
     cdTimeFile << "Total:          " <<   totaltime << endl << endl;
+    cdTimeFile << "Chains per image: " << numChains << endl;
     cdTimeFile << "CD objective:    " << cdval << endl;
     cdTimeFile << "Final objective: " << fval << endl;
     
@@ -0,0 +1,106 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "DataManager.h"
+#include "ConditionalRandomField.h"
+#include "ObjectiveFunctions/LogLikelihood.h"
+#include "ObjectiveFunctions/StochasticGradient.h"
+#include "Learning/StochasticGradientDescent.h"
+#include "Tests/SyntheticData.h"
+#include "Types.h"
+
+using namespace std;
+
+// runs the Hogwild learner with any number of threads
+class HogwildSGD : public StochasticGradientDescent {
+  public:
+    HogwildSGD(ObjectiveFunction *obj, StochasticGradient *grad) : StochasticGradientDescent(obj, grad) {}
+    Weights learnHogwild(const Weights &w) { return learnWeightsHogwild(w); }
+};
+
+// checks on the synthetic dataset that Hogwild with one thread takes the
+// same steps as the serial learner and that these lower the objective (the
+// scaling with more threads on the real data is in benchmarkLearners)
+int main(int argc, char **argv) {
+
+  DataManager dataman;
+  try {
+    loadSyntheticSet(dataman);
+  }
+  catch (int e) {
+    fprintf(stderr, "There was an error with error code %d\n", e);
+    return e;
+  }
+
+  int numWeights = 50;
+  double lambda = 0.01;
+  int epochs = 5;
+  ConditionalRandomField crf(&dataman);
+  crf.setStepSize(8);
+
+  LogLikelihood loglik(&dataman, &crf);
+  loglik.setLambda(lambda);
+  StochasticGradient stochgrad(&dataman, &crf);
+  stochgrad.setLambda(lambda);
+
+  // the same learning rate (about 1e-2, which lowers the objective in every
+  // epoch), the same order of the images and no averaging (which differs
+  // between the two)
+  Weights w0(numWeights, 0.0);
+  double objZero = loglik.evaluate(w0);
+  StochasticGradientDescent serial(&loglik, &stochgrad);
+  HogwildSGD hogwild(&loglik, &stochgrad);
+  StochasticGradientDescent *learners[] = {&serial, &hogwild};
+  for (int i=0; i<2; i++) {
+    learners[i]->setAlpha(lambda);
+    learners[i]->setT0(1e4);
+    learners[i]->setSeed(1);
+    learners[i]->setMaxEpochs(epochs);
+    learners[i]->setAverageStartEpoch(epochs+1);
+    learners[i]->setNumThreads(1);
+    learners[i]->setTempWeightsPath("/dev/null");
+  }
+  Weights wSerial = serial.learnWeights(w0);
+  Weights wHogwild = hogwild.learnHogwild(w0);
+
+  double maxDiff = 0.0, maxWeight = 0.0;
+  for (int i=0; i<numWeights; i++) {
+    maxDiff = max(maxDiff, fabs(wSerial[i] - wHogwild[i]));
+    maxWeight = max(maxWeight, fabs(wSerial[i]));
+  }
+  int failed = 0;
+  bool ok = maxWeight > 0.0 && maxDiff <= 1e-8*maxWeight;
+  failed += !ok;
+  printf("Hogwild with one thread: max |w - w serial| = %g (max |w serial| = %g) %s\n",
+         maxDiff, maxWeight, ok ? "OK" : "FAILED");
+
+  double objSerial = loglik.evaluate(wSerial);
+  ok = objSerial < objZero;
+  failed += !ok;
+  printf("Objective after %d epochs: %f (zero weights %f) %s\n",
+         epochs, objSerial, objZero, ok ? "OK" : "FAILED");
+
+  if (failed > 0) {
+    cout << failed << " checks failed!" << endl;
+    return 1;
+  }
+  cout << "Done!" << endl;
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "DataManager.h"
+#include "ConditionalRandomField.h"
+#include "ObjectiveFunctions/LogLikelihood.h"
+#include "ObjectiveFunctions/StochasticGradient.h"
+#include "Learning/StochasticGradientDescent.h"
+#include "Learning/AdaGrad.h"
+#include "Learning/Adam.h"
+#include "Tests/SyntheticData.h"
+#include "Types.h"
+
+using namespace std;
+
+// largest change of a weight in one epoch from zero weights with the given
+// batch size (one step when the batch holds all images)
+double firstStep(StochasticGradientDescent &learner, int numWeights, int batchSize) {
+  learner.setMaxEpochs(1);
+  learner.setAverageStartEpoch(2);
+  learner.setBatchSize(batchSize);
+  learner.setSeed(1);
+  learner.setTempWeightsPath("/dev/null");
+
+  Weights w0(numWeights, 0.0);
+  Weights w = learner.learnWeights(w0);
+  double step = 0.0;
+  for (int i=0; i<numWeights; i++) {
+    step = max(step, fabs(w[i]));
+  }
+  return step;
+}
+
+// check that a step along the mean gradient of all images has the same size
+// as a step along the gradient of one image
+bool check(const char *name, StochasticGradientDescent &batchLearner, StochasticGradientDescent &imageLearner,
+           int numWeights, int numImages) {
+  double batchStep = firstStep(batchLearner, numWeights, numImages);
+  double imageStep = firstStep(imageLearner, numWeights, 1);
+  bool ok = imageStep > 0.0 && fabs(batchStep - imageStep) <= 1e-6*imageStep;
+  printf("%s: step of a mini-batch of %d images %g, of one image %g %s\n",
+         name, numImages, batchStep, imageStep, ok ? "OK" : "FAILED");
+  return ok;
+}
+
+// checks on the synthetic dataset that the adaptive learners do not scale
+// their steps by the batch size (their directions are normalized per visual
+// word, so the first step moves every visual word by the base learning rate)
+int main(int argc, char **argv) {
+
+  // all images for the mini-batch and the first one alone
+  DataManager dataman, single;
+  try {
+    loadSyntheticSet(dataman);
+    loadSyntheticSet(single, 1);
+  }
+  catch (int e) {
+    fprintf(stderr, "There was an error with error code %d\n", e);
+    return e;
+  }
+
+  int numWeights = 50;
+  double lambda = 0.01;
+  int numImages = dataman.getNonEmpty().size();
+
+  ConditionalRandomField crf(&dataman), crfSingle(&single);
+  crf.setStepSize(8);
+  crfSingle.setStepSize(8);
+
+  LogLikelihood loglik(&dataman, &crf), loglikSingle(&single, &crfSingle);
+  loglik.setLambda(lambda);
+  loglikSingle.setLambda(lambda);
+  StochasticGradient stochgrad(&dataman, &crf), stochgradSingle(&single, &crfSingle);
+  stochgrad.setLambda(lambda);
+  stochgradSingle.setLambda(lambda);
+
+  int failed = 0;
+
+  AdaGrad adagrad(&loglik, &stochgrad), adagradSingle(&loglikSingle, &stochgradSingle);
+  failed += !check("AdaGrad", adagrad, adagradSingle, numWeights, numImages);
+
+  Adam adam(&loglik, &stochgrad), adamSingle(&loglikSingle, &stochgradSingle);
+  failed += !check("Adam", adam, adamSingle, numWeights, numImages);
+
+  if (failed > 0) {
+    cout << failed << " checks failed!" << endl;
+    return 1;
+  }
+  cout << "Done!" << endl;
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "DataManager.h"
+#include "ConditionalRandomField.h"
+#include "ObjectiveFunctions/LogLikelihood.h"
+#include "ObjectiveFunctions/LogLikelihoodGradient.h"
+#include "ObjectiveFunctions/HessianVectorProduct.h"
+#include "Learning/LBFGS.h"
+#include "Learning/NewtonCG.h"
+#include "Learning/ValidationHook.h"
+#include "Tests/SyntheticData.h"
+#include "Types.h"
+
+using namespace std;
+
+// stops the learner after a given number of validations and keeps the weights
+// of the first one as the best
+class StopAfter : public ValidationHook {
+  public:
+    int steps, validations;
+    Weights first;
+    StopAfter(int steps_) : steps(steps_), validations(0) { }
+    void start() { validations = 0; }
+    bool validate(const Weights &w, int step) {
+      if (++validations == 1) first = w;
+      return validations >= steps;
+    }
+    bool finish(Weights &best) { best = first; return validations > 0; }
+};
+
+// checks Newton-CG on the synthetic dataset (the comparison with LBFGS on
+// the real data is in benchmarkLearners):
+// - the Hessian-vector product equals central differences of the gradient
+// - Newton-CG reaches the minimum found by LBFGS, with one objective and
+//   gradient evaluation per iteration when the full Newton step is accepted
+// - the validation hook stops it early, and a run resumed from a checkpoint
+//   ends at the same weights
+int main(int argc, char **argv) {
+
+  DataManager dataman;
+  try {
+    loadSyntheticSet(dataman);
+  }
+  catch (int e) {
+    fprintf(stderr, "There was an error with error code %d\n", e);
+    return e;
+  }
+
+  int numWeights = 50;
+  double lambda = 0.01;
+  ConditionalRandomField crf(&dataman);
+  crf.setStepSize(8);
+
+  LogLikelihood loglik(&dataman, &crf);
+  loglik.setLambda(lambda);
+  LogLikelihoodGradient loglikgrad(&dataman, &crf);
+  loglikgrad.setLambda(lambda);
+  HessianVectorProduct hvp(&dataman, &crf);
+  hvp.setLambda(lambda);
+
+  int failed = 0;
+
+  // Hessian-vector product against central differences of the gradient
+  Weights w(numWeights), wPlus(numWeights), wMinus(numWeights);
+  Dvector v(numWeights), hv(numWeights), gPlus(numWeights), gMinus(numWeights);
+  for (int i=0; i<numWeights; i++) {
+    w[i] = 0.02*((i % 5) - 2);
+    v[i] = (i % 7) - 3.0;
+  }
+  double h = 1e-5;
+  for (int i=0; i<numWeights; i++) {
+    wPlus[i] = w[i] + h*v[i];
+    wMinus[i] = w[i] - h*v[i];
+  }
+  hvp.evaluate(hv, w, v);
+  loglik.evaluateWithGradient(wPlus, gPlus);
+  loglik.evaluateWithGradient(wMinus, gMinus);
+
+  double maxDiff = 0.0, maxHv = 0.0;
+  for (int i=0; i<numWeights; i++) {
+    maxDiff = max(maxDiff, fabs((gPlus[i] - gMinus[i])/(2*h) - hv[i]));
+    maxHv = max(maxHv, fabs(hv[i]));
+  }
+  bool ok = maxDiff <= 1e-4*max(1.0, maxHv);
+  failed += !ok;
+  printf("Hessian-vector product: max |Hv - finite difference| = %g (max |Hv| = %g) %s\n",
+         maxDiff, maxHv, ok ? "OK" : "FAILED");
+
+  // the same minimum as LBFGS
+  Weights w0(numWeights, 0.0);
+  LBFGS lbfgs(&loglik, &loglikgrad);
+  lbfgs.setTempWeightsPath("/dev/null");
+  Weights wLBFGS = lbfgs.learnWeights(w0);
+  double objLBFGS = loglik.evaluate(wLBFGS);
+
+  NewtonCG newton(&loglik, &loglikgrad, &hvp);
+  newton.setTempWeightsPath("/dev/null");
+  Weights wNewton = newton.learnWeights(w0);
+  double objNewton = loglik.evaluate(wNewton);
+  int iterationsNewton = newton.getIterations();
+
+  ok = fabs(objNewton - objLBFGS) <= 1e-5*max(1.0, fabs(objLBFGS));
+  failed += !ok;
+  printf("Newton-CG: objective %f after %d iterations, LBFGS %f %s\n",
+         objNewton, newton.getIterations(), objLBFGS, ok ? "OK" : "FAILED");
+
+  // the initial evaluation and one per trial step
+  ok = newton.getFunctionEvaluations() < 2*newton.getIterations();
+  failed += !ok;
+  printf("Newton-CG: %d evaluations in %d iterations %s\n",
+         newton.getFunctionEvaluations(), newton.getIterations(), ok ? "OK" : "FAILED");
+
+  // early stopping returns the best weights of the hook
+  StopAfter hook(2);
+  newton.setValidationHook(&hook);
+  Weights wStopped = newton.learnWeights(w0);
+  newton.setValidationHook(NULL);
+  ok = newton.getIterations() == 2 && wStopped == hook.first;
+  failed += !ok;
+  printf("Newton-CG: stopped by validation after %d iterations %s\n",
+         newton.getIterations(), ok ? "OK" : "FAILED");
+
+  // resuming after the second iteration
+  char checkpointPath[] = "/tmp/crfNewtonCheckpointXXXXXX";
+  int fd = mkstemp(checkpointPath);
+  if (fd >= 0) {
+    close(fd);
+    NewtonCG first(&loglik, &loglikgrad, &hvp);
+    first.setTempWeightsPath("/dev/null");
+    first.setMaxIterations(2);
+    first.setCheckpointPath(checkpointPath);
+    first.learnWeights(w0);
+
+    NewtonCG resumed(&loglik, &loglikgrad, &hvp);
+    resumed.setTempWeightsPath("/dev/null");
+    resumed.resume(checkpointPath);
+    Weights wResumed = resumed.learnWeights(w0);
+    unlink(checkpointPath);
+
+    double maxDiff = 0.0;
+    for (int i=0; i<numWeights; i++) {
+      maxDiff = max(maxDiff, fabs(wResumed[i] - wNewton[i]));
+    }
+    ok = resumed.getIterations() == iterationsNewton && maxDiff <= 1e-10;
+    failed += !ok;
+    printf("Newton-CG: resumed run ends after %d iterations, max |w - w uninterrupted| = %g %s\n",
+           resumed.getIterations(), maxDiff, ok ? "OK" : "FAILED");
+  }
+
+  if (failed > 0) {
+    cout << failed << " checks failed!" << endl;
+    return 1;
+  }
+  cout << "Done!" << endl;
+
+  return 0;
+}
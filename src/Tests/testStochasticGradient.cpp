@@ -14,6 +14,8 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 
@@ -74,6 +76,31 @@ int main(int argc, char **argv) {
   double fval   = loglik.evaluate(w);
   printf("Loglikelihood = %.6f\n", fval);
 
+  // mini-batch gradient must equal the sum of the gradients of its images
+  // and must not depend on the number of threads
+  printf("Computing mini-batch gradient...\n");
+  SearchIx batch = dataman.getNonEmpty();
+  batch.resize(min((int) batch.size(), 16));
+  SparseVector batchSerial, batchParallel, imageGrad;
+  Dvector sum(numWeights, 0.0);
+  for (size_t k=0; k<batch.size(); k++) {
+    stochgrad.evaluateSparse(imageGrad, w, 1.0, batch[k]);
+    for (size_t i=0; i<imageGrad.index.size(); i++) {
+      sum[imageGrad.index[i]] += imageGrad.value[i];
+    }
+  }
+  stochgrad.setNumThreads(1);
+  stochgrad.evaluateBatch(batchSerial, w, 1.0, batch);
+  stochgrad.setNumThreads(4);
+  stochgrad.evaluateBatch(batchParallel, w, 1.0, batch);
+  double maxDiff = 0.0;
+  bool same = (batchSerial.index == batchParallel.index && batchSerial.value == batchParallel.value);
+  for (size_t i=0; i<batchSerial.index.size(); i++) {
+    maxDiff = max(maxDiff, fabs(batchSerial.value[i] - sum[batchSerial.index[i]]));
+  }
+  printf("Mini-batch of %d images: max difference to sum = %g, 1 and 4 threads identical: %s\n",
+         (int) batch.size(), maxDiff, same ? "yes" : "no");
+
   //printf("Computing gradient...\n");
   //Dvector grad(numWeights);
   //stochgrad.evaluate(grad, w, 0);
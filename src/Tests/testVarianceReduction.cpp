@@ -0,0 +1,110 @@
+/* Conditional Random Fields for Object Localization
+ * Master thesis source code
+ *
+ * Authors:
+ * Andreas Christian Eilschou (jwb226@alumni.ku.dk)
+ * Andreas Hjortgaard Danielsen (gxn961@alumni.ku.dk)
+ *
+ * Department of Computer Science
+ * University of Copenhagen
+ * Denmark
+ *
+ * Date: 27-08-2012
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "DataManager.h"
+#include "ConditionalRandomField.h"
+#include "ObjectiveFunctions/LogLikelihood.h"
+#include "ObjectiveFunctions/LogLikelihoodGradient.h"
+#include "ObjectiveFunctions/StochasticGradient.h"
+#include "Learning/LBFGS.h"
+#include "Learning/SVRG.h"
+#include "Learning/SAGA.h"
+#include "Tests/SyntheticData.h"
+#include "Types.h"
+
+using namespace std;
+
+// check that a learner converges to the minimum found by LBFGS (within a
+// relative tolerance of 1e-4, about 0.01 on the synthetic dataset)
+bool check(const char *name, double objective, double objZero, double objMin) {
+  bool ok = fabs(objective - objMin) <= 1e-4*max(1.0, fabs(objMin));
+  printf("%s: objective %f (zero weights %f, minimum %f) %s\n",
+         name, objective, objZero, objMin, ok ? "OK" : "FAILED");
+  return ok;
+}
+
+// checks SVRG and SAGA on the synthetic dataset (the comparison with SGD
+// and LBFGS on the real data is in benchmarkLearners): with a constant
+// learning rate of 1e-2 they converge linearly but slowly on it (the gap to
+// the minimum shrinks about 5 times per 100 epochs), so they are run for
+// 400 epochs
+//
+// usage: testVarianceReduction [eta] [epochs]
+int main(int argc, char **argv) {
+
+  double eta = argc > 1 ? atof(argv[1]) : 1e-2;
+  int epochs = argc > 2 ? atoi(argv[2]) : 400;
+
+  DataManager dataman;
+  try {
+    loadSyntheticSet(dataman);
+  }
+  catch (int e) {
+    fprintf(stderr, "There was an error with error code %d\n", e);
+    return e;
+  }
+
+  int numWeights = 50;
+  double lambda = 0.01;
+  ConditionalRandomField crf(&dataman);
+  crf.setStepSize(8);
+
+  LogLikelihood loglik(&dataman, &crf);
+  loglik.setLambda(lambda);
+  LogLikelihoodGradient loglikgrad(&dataman, &crf);
+  loglikgrad.setLambda(lambda);
+  StochasticGradient stochgrad(&dataman, &crf);
+  stochgrad.setLambda(lambda);
+
+  Weights w0(numWeights, 0.0);
+  double objZero = loglik.evaluate(w0);
+
+  LBFGS lbfgs(&loglik, &loglikgrad);
+  lbfgs.setTempWeightsPath("/dev/null");
+  Weights wMin = lbfgs.learnWeights(w0);
+  double objMin = loglik.evaluate(wMin);
+
+  // SVRG and SAGA with a constant learning rate
+  SVRG svrg(&loglik, &loglikgrad, &stochgrad);
+  svrg.setEta(eta);
+  svrg.setMaxEpochs(epochs);
+  svrg.setTempWeightsPath("/dev/null");
+  Weights wSVRG = svrg.learnWeights(w0);
+  double objSVRG = loglik.evaluate(wSVRG);
+
+  SAGA saga(&loglik, &loglikgrad, &stochgrad);
+  saga.setEta(eta);
+  saga.setMaxEpochs(epochs);
+  saga.setTempWeightsPath("/dev/null");
+  Weights wSAGA = saga.learnWeights(w0);
+  double objSAGA = loglik.evaluate(wSAGA);
+
+  int failed = 0;
+  failed += !check("SVRG", objSVRG, objZero, objMin);
+  failed += !check("SAGA", objSAGA, objZero, objMin);
+
+  if (failed > 0) {
+    cout << failed << " checks failed!" << endl;
+    return 1;
+  }
+  cout << "Done!" << endl;
+
+  return 0;
+}
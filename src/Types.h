@@ -26,12 +26,15 @@
 #define WRONG_BBOX -6
 #define GRADIENT_SIZE_ERROR -7
 #define STEP_SIZE_TOO_LARGE -8
+#define CACHE_WRITE_ERROR -9
+#define CHECKPOINT_ERROR -10
 
 // BFGS errors
 #define LINESEARCH_ETA_TOO_SMALL -1000
 #define LINESEARCH_MAX_STEP -999
 #define LINESEARCH_POSITIVE_SLOPE -998
 #define BFGS_ALREADY_MINIMIZED -997
+#define LBFGS_SSE_ERROR -996
 
 #include <vector>
 #include <string>
@@ -48,10 +51,15 @@ const int RIGHT   = 2;
 const int BOTTOM  = 3;
 
 // visual word tuple (x,y,c) represented as individual vectors
+// the visual words present in the image are also numbered locally,
+// clusters[localC[k]] == c[k], so that histograms only span those words
 struct Image {  
   int height, width;  // height and width of the image
   int numFeatures;   // number of features
   short *x, *y, *c;   // descriptor position and visual word
+  int numClusters;    // number of distinct visual words in the image
+  short *clusters;    // local to global visual word (sorted)
+  short *localC;      // local visual word of each descriptor
 };
 
 // bounding box (object, left, top, right, bottom)
@@ -61,6 +69,19 @@ struct Bbox {
   double score;
 };
 
+// sparse feature vector of a box: the visual words inside it and their counts
+struct SparseFeatures {
+  std::vector<short> words;
+  std::vector<int> counts;
+};
+
+// sparse vector over visual words (e.g. the gradient of a single image,
+// which is zero outside the visual words present in the image)
+struct SparseVector {
+  std::vector<short> index;
+  std::vector<double> value;
+};
+
 // the features type
 typedef std::vector<Image> Images;
 
@@ -85,9 +106,6 @@ typedef std::vector<int> SearchIx;
 // integral image
 typedef std::vector<double> IntegralImage;
 
-// integral histogram
-typedef std::vector<Ivector> IntegralHistogram;
-
 // recall overlap
 struct RecallOverlap {
   double AUC;         // Area under the recall-overlap curve
@@ -106,5 +124,20 @@ inline double gettime() {
   return t; 
 }
 
+// wall clock time in seconds (gettime only counts user time of this process,
+// which includes all threads)
+inline double getwalltime() {
+  struct timeval curTime;
+  gettimeofday(&curTime, NULL);
+  return curTime.tv_sec*1.0 + (curTime.tv_usec/1000./1000.);
+}
+
+// peak resident memory of the process in megabytes
+inline double getpeakmemory() {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss/1024.;
+}
+
 
 #endif // _TYPES_H_